@@ -0,0 +1,79 @@
+/*
+ * Shell spawn latency: fork+exec against posix_spawn, as the agent's
+ * resident size grows. The numbers behind tool_shell.c's use of
+ * posix_spawn (docs/TOOLS.md, "shell").
+ *
+ *   make bench-spawn
+ *
+ * For each size the parent touches that much heap, then starts /bin/true
+ * RUNS times each way and reports the mean time to exit.
+ */
+
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RUNS 40
+
+extern char **environ;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static char *const g_argv[] = { "/bin/true", NULL };
+
+static void run_fork(void) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        execve(g_argv[0], g_argv, environ);
+        _exit(127);
+    }
+    if (pid > 0) waitpid(pid, NULL, 0);
+}
+
+static void run_spawn(void) {
+    pid_t pid;
+    if (posix_spawn(&pid, g_argv[0], NULL, NULL, g_argv, environ) == 0)
+        waitpid(pid, NULL, 0);
+}
+
+static double mean_us(void (*fn)(void)) {
+    fn(); /* Warm up */
+    double t0 = now_us();
+    for (int i = 0; i < RUNS; i++) fn();
+    return (now_us() - t0) / RUNS;
+}
+
+int main(int argc, char **argv) {
+    static const size_t sizes_mb[] = { 10, 100, 500, 1000, 2000 };
+    size_t max_mb = argc > 1 ? (size_t)atol(argv[1]) : 2000;
+
+    printf("%8s %12s %12s\n", "RSS (MB)", "fork+exec", "posix_spawn");
+    char *heap = NULL;
+    size_t have = 0;
+    for (size_t i = 0; i < sizeof(sizes_mb) / sizeof(sizes_mb[0]); i++) {
+        size_t want = sizes_mb[i] << 20;
+        if (sizes_mb[i] > max_mb) break;
+        char *grown = realloc(heap, want);
+        if (!grown) {
+            fprintf(stderr, "cannot allocate %zu MB\n", sizes_mb[i]);
+            break;
+        }
+        heap = grown;
+        memset(heap + have, 1, want - have); /* Make the pages resident */
+        have = want;
+
+        double f = mean_us(run_fork);
+        double s = mean_us(run_spawn);
+        printf("%8zu %9.0f us %9.0f us\n", sizes_mb[i], f, s);
+    }
+    free(heap);
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * Timer wheel benchmark: the numbers in docs/CRON.md ("One-shot Timers").
+ *
+ *   make bench-timer [BENCH_TIMERS=1000000]
+ *
+ * Inserts N timers with random expiries over 3 days, cancels N/10, ticks
+ * second by second through the 3 days firing the rest, then times loading
+ * N/2 timers back from a SQLite store.
+ */
+
+#include "timer.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SPAN (3 * 24 * 3600)
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static long g_fired;
+
+static void on_fire(uint64_t id, const char *payload, void *userdata) {
+    (void)id; (void)payload; (void)userdata;
+    g_fired++;
+}
+
+int main(int argc, char **argv) {
+    long n = argc > 1 ? atol(argv[1]) : 1000000;
+    if (n < 10) n = 10;
+    log_set_level(LOG_WARN);
+    srand(42);
+
+    TimerWheel *tw = timer_wheel_new();
+    timer_register(tw, "bench", on_fire, NULL);
+    time_t start = time(NULL);
+    uint64_t *ids = malloc((size_t)n * sizeof(uint64_t));
+
+    double t0 = now_s();
+    for (long i = 0; i < n; i++)
+        ids[i] = timer_add(tw, "bench", start + 1 + rand() % SPAN, "Stand up and stretch.");
+    double t1 = now_s();
+    printf("Insert %ld timers: %.2f s (%.0f ns/op)\n", n, t1 - t0, (t1 - t0) * 1e9 / (double)n);
+
+    long ncancel = n / 10;
+    t0 = now_s();
+    for (long i = 0; i < ncancel; i++) timer_cancel(tw, ids[(size_t)rand() % (size_t)n]);
+    t1 = now_s();
+    printf("Cancel %ld: %.2f s (%.0f ns/op), %zu pending\n", ncancel, t1 - t0,
+           (t1 - t0) * 1e9 / (double)ncancel, timer_pending(tw));
+
+    t0 = now_s();
+    for (time_t t = start + 1; t <= start + SPAN + 1; t++) timer_advance(tw, t);
+    t1 = now_s();
+    printf("Tick through 3 days, firing %ld: %.2f s\n", g_fired, t1 - t0);
+    timer_wheel_free(tw);
+    free(ids);
+
+    /* Store: write N/2 timers in one batch, then time a cold load */
+    char db[] = "/tmp/cclaw-timer-bench-XXXXXX";
+    int fd = mkstemp(db);
+    if (fd < 0) { perror("mkstemp"); return 1; }
+    close(fd);
+
+    long nstore = n / 2;
+    tw = timer_wheel_new();
+    timer_register(tw, "bench", on_fire, NULL);
+    if (!timer_open_store(tw, db)) return 1;
+    for (long i = 0; i < nstore; i++)
+        timer_add(tw, "bench", start + 3600 + rand() % SPAN, "Stand up and stretch.");
+    timer_wheel_free(tw);  /* Flushes the queued inserts */
+
+    tw = timer_wheel_new();
+    timer_register(tw, "bench", on_fire, NULL);
+    t0 = now_s();
+    timer_open_store(tw, db);
+    t1 = now_s();
+    printf("Reload %zu from SQLite: %.2f s\n", timer_pending(tw), t1 - t0);
+    timer_wheel_free(tw);
+
+    unlink(db);
+    char side[sizeof(db) + 8];
+    snprintf(side, sizeof(side), "%s-wal", db);
+    unlink(side);
+    snprintf(side, sizeof(side), "%s-shm", db);
+    unlink(side);
+    return 0;
+}
@@ -1,33 +1,117 @@
 #include "arena.h"
+#include "pool.h"
+#include <cJSON.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+
+#define MEM_TAG MEM_ARENA
+#include "mem.h"
+
+struct ArenaChunk {
+    ArenaChunk *next;  /* Older chunk */
+    size_t      cap;
+    size_t      pos;
+    char        data[];
+};
 
 Arena arena_new(size_t cap) {
     Arena a = {0};
-    a.buf = malloc(cap);
-    a.cap = cap;
-    a.pos = 0;
+    a.chunk = cap;
     return a;
 }
 
+/* Totals for arena_stats(), over every arena and thread */
+static atomic_size_t g_chunks, g_chunk_bytes, g_peak_bytes;
+static atomic_ullong g_chunk_allocs, g_chunk_reuses, g_allocs, g_alloc_bytes;
+static atomic_ullong g_hist[MEM_HIST];
+
+/* A chunk of at least `size` bytes, header included, from the buffer
+ * pool. It's given all of the pool buffer. */
+static ArenaChunk *chunk_new(size_t size) {
+    size_t got;
+    ArenaChunk *c = pool_get(size, &got);
+    if (!c) return NULL;
+    c->cap = got - sizeof(*c);
+    atomic_fetch_add_explicit(&g_chunks, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_chunk_allocs, 1, memory_order_relaxed);
+    size_t now = atomic_fetch_add_explicit(&g_chunk_bytes, got, memory_order_relaxed) + got;
+    size_t peak = atomic_load_explicit(&g_peak_bytes, memory_order_relaxed);
+    while (now > peak &&
+           !atomic_compare_exchange_weak_explicit(&g_peak_bytes, &peak, now,
+                                                  memory_order_relaxed, memory_order_relaxed)) {}
+    return c;
+}
+
+static void chunk_free(ArenaChunk *c) {
+    if (!c) return;
+    size_t size = sizeof(*c) + c->cap;
+    atomic_fetch_sub_explicit(&g_chunks, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&g_chunk_bytes, size, memory_order_relaxed);
+    pool_put(c, size);
+}
+
+/* Put a chunk back: keep the largest as the spare, return the rest to
+ * the pool. */
+static void chunk_release(Arena *a, ArenaChunk *c) {
+    if (a->spare && a->spare->cap >= c->cap) {
+        chunk_free(c);
+        return;
+    }
+    chunk_free(a->spare);
+    a->spare = c;
+}
+
+/* Start a new chunk that fits `size`. Each chunk is twice the last, up to
+ * ARENA_CHUNK_MAX; larger requests get a chunk of their own size. Sizes
+ * include the header, so chunks fill pool buffers exactly. */
+static ArenaChunk *chunk_push(Arena *a, size_t size) {
+    size_t first = a->chunk ? a->chunk : ARENA_CHUNK;
+    size_t total = a->head ? (sizeof(ArenaChunk) + a->head->cap) * 2 : first;
+    if (total > ARENA_CHUNK_MAX) total = ARENA_CHUNK_MAX;
+    if (total < first) total = first;
+    if (total < sizeof(ArenaChunk) + size) total = sizeof(ArenaChunk) + size;
+
+    ArenaChunk *c;
+    if (a->spare && sizeof(ArenaChunk) + a->spare->cap >= total) {
+        c = a->spare;
+        a->spare = NULL;
+        atomic_fetch_add_explicit(&g_chunk_reuses, 1, memory_order_relaxed);
+    } else {
+        c = chunk_new(total);
+        if (!c) return NULL;
+    }
+    c->pos = 0;
+    c->next = a->head;
+    a->head = c;
+    return c;
+}
+
 void *arena_alloc(Arena *a, size_t size) {
+    if (!a) return malloc(size);
+    if (mem_tracking()) {
+        atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&g_alloc_bytes, size, memory_order_relaxed);
+        atomic_fetch_add_explicit(&g_hist[mem_size_class(size)], 1, memory_order_relaxed);
+    }
     /* Align to 8 bytes */
     size = (size + 7) & ~(size_t)7;
-    if (a->pos + size > a->cap) {
-        /* Double capacity */
-        size_t new_cap = a->cap * 2;
-        while (a->pos + size > new_cap) new_cap *= 2;
-        a->buf = realloc(a->buf, new_cap);
-        a->cap = new_cap;
-    }
-    void *ptr = a->buf + a->pos;
-    a->pos += size;
+    ArenaChunk *c = a->head;
+    if (!c || c->pos + size > c->cap) {
+        c = chunk_push(a, size);
+        if (!c) return NULL;
+    }
+    void *ptr = c->data + c->pos;
+    c->pos += size;
     return ptr;
 }
 
 char *arena_strdup(Arena *a, const char *s) {
+    if (!a) return strdup(s);
     size_t len = strlen(s) + 1;
     char *p = arena_alloc(a, len);
     memcpy(p, s, len);
@@ -46,11 +130,121 @@ char *arena_sprintf(Arena *a, const char *fmt, ...) {
     return p;
 }
 
-void arena_reset(Arena *a) { a->pos = 0; }
+void *arena_realloc(Arena *a, void *p, size_t old, size_t size) {
+    if (!a) return realloc(p, size);
+    ArenaChunk *c = a->head;
+    size_t used = (old + 7) & ~(size_t)7;
+    if (p && c && (char *)p + used == c->data + c->pos) {
+        size_t want = (size + 7) & ~(size_t)7;
+        if (c->pos - used + want <= c->cap) {
+            c->pos = c->pos - used + want;
+            return p;
+        }
+    }
+    void *q = arena_alloc(a, size);
+    if (q && p) memcpy(q, p, old < size ? old : size);
+    return q;
+}
+
+ArenaMark arena_save(const Arena *a) {
+    return (ArenaMark){ a->head, a->head ? a->head->pos : 0 };
+}
+
+void arena_restore(Arena *a, ArenaMark m) {
+    while (a->head && a->head != m.chunk) {
+        ArenaChunk *c = a->head;
+        a->head = c->next;
+        chunk_release(a, c);
+    }
+    if (a->head) a->head->pos = m.pos;
+}
+
+void arena_reset(Arena *a) {
+    ArenaChunk *first = a->head;
+    while (first && first->next) first = first->next;
+    arena_restore(a, (ArenaMark){ first, 0 });
+}
 
 void arena_free(Arena *a) {
-    free(a->buf);
-    a->buf = NULL;
-    a->cap = 0;
-    a->pos = 0;
+    while (a->head) {
+        ArenaChunk *c = a->head;
+        a->head = c->next;
+        chunk_free(c);
+    }
+    chunk_free(a->spare);
+    a->spare = NULL;
+}
+
+void arena_stats(ArenaStats *out) {
+    out->chunks = atomic_load_explicit(&g_chunks, memory_order_relaxed);
+    out->chunk_bytes = atomic_load_explicit(&g_chunk_bytes, memory_order_relaxed);
+    out->peak_bytes = atomic_load_explicit(&g_peak_bytes, memory_order_relaxed);
+    out->chunk_allocs = atomic_load_explicit(&g_chunk_allocs, memory_order_relaxed);
+    out->chunk_reuses = atomic_load_explicit(&g_chunk_reuses, memory_order_relaxed);
+    out->allocs = atomic_load_explicit(&g_allocs, memory_order_relaxed);
+    out->alloc_bytes = atomic_load_explicit(&g_alloc_bytes, memory_order_relaxed);
+    for (int i = 0; i < MEM_HIST; i++)
+        out->hist[i] = atomic_load_explicit(&g_hist[i], memory_order_relaxed);
+}
+
+/* ── Per-thread arenas ──────────────────────────────────────── */
+
+static pthread_key_t  g_thread_key;
+static pthread_once_t g_thread_once = PTHREAD_ONCE_INIT;
+static __thread Arena *t_arena;
+
+static void thread_arena_free(void *p) {
+    arena_free(p);
+    free(p);
+    t_arena = NULL;
+}
+
+static void thread_key_init(void) {
+    pthread_key_create(&g_thread_key, thread_arena_free);
+}
+
+void arena_thread_free(void) {
+    if (!t_arena) return;
+    pthread_setspecific(g_thread_key, NULL);
+    thread_arena_free(t_arena);
+}
+
+Arena *arena_thread(void) {
+    if (!t_arena) {
+        pthread_once(&g_thread_once, thread_key_init);
+        t_arena = calloc(1, sizeof(*t_arena));
+        pthread_setspecific(g_thread_key, t_arena);
+    }
+    return t_arena;
+}
+
+/* ── cJSON allocations ──────────────────────────────────────── */
+
+static __thread Arena *t_json;
+
+static bool arena_owns(const Arena *a, const void *p) {
+    for (const ArenaChunk *c = a->head; c; c = c->next) {
+        if ((const char *)p >= c->data && (const char *)p < c->data + c->cap) return true;
+    }
+    return false;
+}
+
+static void *json_malloc(size_t size) {
+    return t_json ? arena_alloc(t_json, size) : mem_malloc(MEM_JSON, size, __FILE__, __LINE__);
+}
+
+static void json_free(void *p) {
+    if (t_json && arena_owns(t_json, p)) return;
+    free(p);
+}
+
+void arena_json_hooks(void) {
+    cJSON_Hooks hooks = { json_malloc, json_free };
+    cJSON_InitHooks(&hooks);
+}
+
+Arena *arena_json_use(Arena *a) {
+    Arena *prev = t_json;
+    t_json = a;
+    return prev;
 }
@@ -1,22 +1,85 @@
 #ifndef CCLAW_ARENA_H
 #define CCLAW_ARENA_H
 
+#include "mem.h"
 #include <stddef.h>
+#include <stdint.h>
 
 /* Simple bump allocator for per-request allocations.
- * Avoids malloc/free churn in hot paths. */
+ * Avoids malloc/free churn in hot paths. Memory comes from a list of
+ * chunks that never move, so pointers stay valid until the arena is
+ * reset, restored to an earlier mark, or freed. Chunks are buffers from
+ * pool.h, handed back to it when released. A zeroed Arena is empty and
+ * ready to use. */
+
+typedef struct ArenaChunk ArenaChunk;
 
 typedef struct {
-    char  *buf;
-    size_t cap;
-    size_t pos;
+    ArenaChunk *head;   /* Chunk being filled; links to older ones */
+    ArenaChunk *spare;  /* Last chunk released by a restore, reused next */
+    size_t      chunk;  /* Size of the first chunk (0 = ARENA_CHUNK) */
 } Arena;
 
+#define ARENA_CHUNK     (64 * 1024)
+#define ARENA_CHUNK_MAX (1024 * 1024)  /* Chunks double up to this size */
+
+/* A position in an arena, to roll back scratch allocations. */
+typedef struct {
+    ArenaChunk *chunk;
+    size_t      pos;
+} ArenaMark;
+
+/* The allocators take a NULL arena to mean the heap: the result is then
+ * malloc'd and the caller frees it. Code can so build its results in an
+ * arena when it's given one and on the heap otherwise. */
 Arena arena_new(size_t cap);
 void *arena_alloc(Arena *a, size_t size);
 char *arena_strdup(Arena *a, const char *s);
 char *arena_sprintf(Arena *a, const char *fmt, ...);
+
+/* Resize an allocation of `old` bytes. The last allocation grows in
+ * place when its chunk has room; anything else is copied. */
+void *arena_realloc(Arena *a, void *p, size_t old, size_t size);
+
+/* Scratch scopes: everything allocated after arena_save() is released by
+ * arena_restore() with the same mark. Marks nest. */
+ArenaMark arena_save(const Arena *a);
+void      arena_restore(Arena *a, ArenaMark m);
+
+/* Release everything but the first chunk. */
 void  arena_reset(Arena *a);
 void  arena_free(Arena *a);
 
+/* This thread's scratch arena, created on first use and freed when the
+ * thread exits. Take a mark and restore it before returning. */
+Arena *arena_thread(void);
+
+/* Totals over all arenas. Chunk figures are always kept; allocation
+ * counts only while mem_tracking() is on. */
+typedef struct {
+    size_t   chunks;        /* Chunks held now, spares included */
+    size_t   chunk_bytes;
+    size_t   peak_bytes;
+    uint64_t chunk_allocs;  /* Chunks taken from the buffer pool */
+    uint64_t chunk_reuses;  /* Chunks taken from a spare instead */
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+    uint64_t hist[MEM_HIST];  /* Allocations by mem_size_class() */
+} ArenaStats;
+
+void arena_stats(ArenaStats *out);
+
+/* Free this thread's arena now rather than at thread exit: the main
+ * thread's is otherwise never freed. */
+void arena_thread_free(void);
+
+/* Point cJSON's allocator at the arenas: install once at startup. While
+ * an arena is selected with arena_json_use() on a thread, cJSON nodes and
+ * printed strings come from it and cJSON_Delete() of them is a no-op, so
+ * the tree needn't be deleted at all. Returns the previous selection
+ * (NULL = heap) to restore. Only parse and print in the scope: anything
+ * the caller will free() must be built outside it. */
+void   arena_json_hooks(void);
+Arena *arena_json_use(Arena *a);
+
 #endif
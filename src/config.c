@@ -4,6 +4,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MEM_TAG MEM_OTHER
+#include "mem.h"
 
 void config_defaults(CClawConfig *cfg) {
     memset(cfg, 0, sizeof(*cfg));
@@ -12,6 +24,13 @@ void config_defaults(CClawConfig *cfg) {
     cfg->temperature = 0.7f;
     cfg->gateway_port = 3578;
     cfg->log_level = 2; /* INFO */
+    cfg->cron_max_concurrent = 2;
+    cfg->timer_max_concurrent = 2;
+    cfg->shell_timeout = 30;
+    cfg->shell_pool_idle = 600;
+    cfg->shell_sandbox_network = true;
+    cfg->file_cache_mb = 32;
+    cfg->tool_result_cache = true;
     strncpy(cfg->memory_db, "memory.db", sizeof(cfg->memory_db) - 1);
 }
 
@@ -23,6 +42,13 @@ static char *trim(char *s) {
     return s;
 }
 
+/* "off", "stats" or "leaks" as a MemTrack. */
+static int parse_mem_track(const char *v) {
+    if (!strcmp(v, "stats") || !strcmp(v, "1")) return MEM_TRACK_STATS;
+    if (!strcmp(v, "leaks") || !strcmp(v, "2")) return MEM_TRACK_LEAKS;
+    return MEM_TRACK_OFF;
+}
+
 /* Simple key=value config parser (TOML-ish, no sections for now). */
 int config_load(CClawConfig *cfg, const char *path) {
     FILE *fp = fopen(path, "r");
@@ -59,7 +85,27 @@ int config_load(CClawConfig *cfg, const char *path) {
         else if (!strcmp(key, "gateway_port"))      cfg->gateway_port = atoi(val);
         else if (!strcmp(key, "gateway_token"))     strncpy(cfg->gateway_token, val, sizeof(cfg->gateway_token)-1);
         else if (!strcmp(key, "memory_db"))         strncpy(cfg->memory_db, val, sizeof(cfg->memory_db)-1);
+        else if (!strcmp(key, "cron_file"))         strncpy(cfg->cron_file, val, sizeof(cfg->cron_file)-1);
+        else if (!strcmp(key, "cron_db"))           strncpy(cfg->cron_db, val, sizeof(cfg->cron_db)-1);
+        else if (!strcmp(key, "cron_jitter"))       cfg->cron_jitter = atoi(val);
+        else if (!strcmp(key, "cron_max_concurrent")) cfg->cron_max_concurrent = atoi(val);
+        else if (!strcmp(key, "timer_max_concurrent")) cfg->timer_max_concurrent = atoi(val);
+        else if (!strcmp(key, "tools_dir"))         strncpy(cfg->tools_dir, val, sizeof(cfg->tools_dir)-1);
+        else if (!strcmp(key, "stream_tool_output")) cfg->stream_tool_output = (!strcmp(val, "true") || !strcmp(val, "1"));
+        else if (!strcmp(key, "shell_timeout"))     cfg->shell_timeout = atoi(val);
+        else if (!strcmp(key, "shell_cpu_limit"))   cfg->shell_cpu_limit = atoi(val);
+        else if (!strcmp(key, "shell_mem_limit"))   cfg->shell_mem_limit = atol(val);
+        else if (!strcmp(key, "shell_fsize_limit")) cfg->shell_fsize_limit = atol(val);
+        else if (!strcmp(key, "shell_cgroup"))      strncpy(cfg->shell_cgroup, val, sizeof(cfg->shell_cgroup)-1);
+        else if (!strcmp(key, "shell_pool"))        cfg->shell_pool = atoi(val);
+        else if (!strcmp(key, "shell_pool_idle"))   cfg->shell_pool_idle = atoi(val);
+        else if (!strcmp(key, "shell_sandbox"))     cfg->shell_sandbox = (!strcmp(val, "true") || !strcmp(val, "1"));
+        else if (!strcmp(key, "shell_sandbox_network")) cfg->shell_sandbox_network = (!strcmp(val, "true") || !strcmp(val, "1"));
+        else if (!strcmp(key, "file_fsync"))        cfg->file_fsync = (!strcmp(val, "true") || !strcmp(val, "1"));
+        else if (!strcmp(key, "file_cache_mb"))     cfg->file_cache_mb = atoi(val);
+        else if (!strcmp(key, "tool_result_cache")) cfg->tool_result_cache = (!strcmp(val, "true") || !strcmp(val, "1"));
         else if (!strcmp(key, "log_level"))         cfg->log_level = atoi(val);
+        else if (!strcmp(key, "mem_track"))         cfg->mem_track = parse_mem_track(val);
         else LOG_WARN("Unknown config key: %s", key);
     }
 
@@ -86,6 +132,7 @@ void config_load_env(CClawConfig *cfg) {
         cfg->telegram_enabled = true;
     }
     if ((v = getenv("CCLAW_LOG_LEVEL")))     cfg->log_level = atoi(v);
+    if ((v = getenv("CCLAW_MEM_TRACK")))     cfg->mem_track = parse_mem_track(v);
 }
 
 void config_dump(const CClawConfig *cfg) {
@@ -98,3 +145,326 @@ void config_dump(const CClawConfig *cfg) {
     LOG_INFO("  gateway:    port %d", cfg->gateway_port);
     LOG_INFO("  memory_db:  %s", cfg->memory_db);
 }
+
+/* ── Live config ────────────────────────────────────────────────
+ *
+ * Snapshots are published through an atomic pointer and reclaimed by
+ * epoch. A thread reading one records the global epoch in its own
+ * Reader before loading the pointer; a reload swaps the pointer, bumps
+ * the epoch and retires the old snapshot with the new epoch. Once no
+ * reader records an epoch older than that, nobody can still hold it.
+ * Retired snapshots are checked on every reload, and each second by the
+ * watcher while any remain. */
+
+typedef struct Snap {
+    CClawConfig  cfg;      /* Handed out; must be first */
+    unsigned long retired; /* Epoch it was replaced in */
+    struct Snap *next;
+} Snap;
+
+typedef struct Reader {
+    atomic_ulong   epoch;  /* When its outermost acquire began; 0 = none */
+    int            depth;
+    struct Reader *next;
+} Reader;
+
+static __thread Reader t_reader;
+static __thread bool   t_registered;
+static pthread_key_t   g_reader_key;
+static pthread_once_t  g_reader_once = PTHREAD_ONCE_INIT;
+
+static struct {
+    pthread_mutex_t lock;  /* Writers: reloads, reader registry, retired list */
+    _Atomic(Snap *) cur;
+    atomic_ulong    epoch;
+    Reader         *readers;
+    Snap           *retired;
+    CClawConfig     base;
+    char            path[512];
+    ConfigReloadFn  on_reload;
+    int             pipe[2];  /* Wakes the watcher: 'r' reload, 'q' quit */
+    int             ifd;      /* inotify on the file's directory, or -1 */
+    const char     *name;     /* The file's name in it (within path) */
+    pthread_t       thread;
+    bool            watching;
+} g_cf = { .lock = PTHREAD_MUTEX_INITIALIZER, .epoch = 1, .pipe = { -1, -1 }, .ifd = -1 };
+
+static void reader_exit(void *p) {
+    pthread_mutex_lock(&g_cf.lock);
+    for (Reader **rp = &g_cf.readers; *rp; rp = &(*rp)->next) {
+        if (*rp == p) {
+            *rp = (*rp)->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_cf.lock);
+}
+
+static void reader_key_init(void) {
+    pthread_key_create(&g_reader_key, reader_exit);
+}
+
+/* Free retired snapshots no reader can hold. Lock held. */
+static void reclaim(void) {
+    unsigned long oldest = ULONG_MAX;
+    for (Reader *r = g_cf.readers; r; r = r->next) {
+        unsigned long e = atomic_load(&r->epoch);
+        if (e && e < oldest) oldest = e;
+    }
+    for (Snap **sp = &g_cf.retired; *sp;) {
+        Snap *s = *sp;
+        if (s->retired <= oldest) {
+            *sp = s->next;
+            free(s);
+        } else {
+            sp = &s->next;
+        }
+    }
+}
+
+void config_init(const CClawConfig *cfg, const CClawConfig *base, const char *path) {
+    Snap *s = calloc(1, sizeof(*s));
+    if (!s) return;
+    memcpy(&s->cfg, cfg, sizeof(*cfg));
+    pthread_mutex_lock(&g_cf.lock);
+    memcpy(&g_cf.base, base, sizeof(*base));
+    snprintf(g_cf.path, sizeof(g_cf.path), "%s", path ? path : "");
+    atomic_store(&g_cf.cur, s);
+    pthread_mutex_unlock(&g_cf.lock);
+}
+
+const CClawConfig *config_acquire(void) {
+    Reader *r = &t_reader;
+    if (!t_registered) {
+        pthread_once(&g_reader_once, reader_key_init);
+        pthread_mutex_lock(&g_cf.lock);
+        r->next = g_cf.readers;
+        g_cf.readers = r;
+        pthread_mutex_unlock(&g_cf.lock);
+        pthread_setspecific(g_reader_key, r);
+        t_registered = true;
+    }
+    /* The epoch is published before the pointer is loaded, so a reload
+     * that doesn't see it has already swapped in what's loaded below. */
+    if (r->depth++ == 0) atomic_store(&r->epoch, atomic_load(&g_cf.epoch));
+    Snap *s = atomic_load(&g_cf.cur);
+    return s ? &s->cfg : NULL;
+}
+
+void config_release(const CClawConfig *cfg) {
+    if (!cfg) return;
+    if (--t_reader.depth == 0)
+        atomic_store_explicit(&t_reader.epoch, 0, memory_order_release);
+}
+
+void config_on_reload(ConfigReloadFn fn) {
+    g_cf.on_reload = fn;
+}
+
+/* Settings read once at startup: carry the running values over, and
+ * say that a changed one needs a restart. */
+static void keep_startup(CClawConfig *next, const CClawConfig *cur) {
+#define KEEP(f) \
+    if (memcmp(&next->f, &cur->f, sizeof(cur->f))) { \
+        LOG_WARN("config: %s takes effect on restart", #f); \
+        memcpy(&next->f, &cur->f, sizeof(cur->f)); \
+    }
+    KEEP(workspace);
+    KEEP(telegram_enabled);
+    KEEP(gateway_port);
+    KEEP(gateway_token);
+    KEEP(memory_db);
+    KEEP(cron_file);
+    KEEP(cron_db);
+    KEEP(cron_jitter);
+    KEEP(cron_max_concurrent);
+    KEEP(timer_max_concurrent);
+    KEEP(tools_dir);
+    KEEP(shell_timeout);
+    KEEP(shell_cpu_limit);
+    KEEP(shell_mem_limit);
+    KEEP(shell_fsize_limit);
+    KEEP(shell_cgroup);
+    KEEP(shell_pool);
+    KEEP(shell_pool_idle);
+    KEEP(shell_sandbox);
+    KEEP(shell_sandbox_network);
+    KEEP(file_fsync);
+    KEEP(file_cache_mb);
+    KEEP(tool_result_cache);
+    KEEP(mem_track);
+#undef KEEP
+}
+
+int config_reload(void) {
+    pthread_mutex_lock(&g_cf.lock);
+    Snap *cur = atomic_load(&g_cf.cur);
+    Snap *s = cur ? calloc(1, sizeof(*s)) : NULL;
+    if (!s) {
+        pthread_mutex_unlock(&g_cf.lock);
+        return -1;
+    }
+    /* An empty file is most likely being rewritten in place; its
+     * close brings another reload. */
+    struct stat st;
+    if (g_cf.path[0] && stat(g_cf.path, &st) == 0 && st.st_size == 0) {
+        LOG_DEBUG("config: %s is empty; keeping the current settings", g_cf.path);
+        pthread_mutex_unlock(&g_cf.lock);
+        free(s);
+        return 0;
+    }
+    memcpy(&s->cfg, &g_cf.base, sizeof(s->cfg));
+    if (g_cf.path[0] && config_load(&s->cfg, g_cf.path) < 0) {
+        LOG_WARN("config: cannot read %s (%s); keeping the current settings",
+                 g_cf.path, strerror(errno));
+        pthread_mutex_unlock(&g_cf.lock);
+        free(s);
+        return -1;
+    }
+    config_load_env(&s->cfg);
+    keep_startup(&s->cfg, &cur->cfg);
+
+    if (!memcmp(&s->cfg, &cur->cfg, sizeof(s->cfg))) {
+        LOG_DEBUG("config: %s unchanged", g_cf.path);
+        pthread_mutex_unlock(&g_cf.lock);
+        free(s);
+        return 0;
+    }
+
+    log_set_level((LogLevel)s->cfg.log_level);
+    atomic_store(&g_cf.cur, s);
+    cur->retired = atomic_fetch_add(&g_cf.epoch, 1) + 1;
+    cur->next = g_cf.retired;
+    g_cf.retired = cur;
+    LOG_INFO("config: reloaded %s (provider %s, model %s, temperature %.2f)",
+             g_cf.path[0] ? g_cf.path : "environment", s->cfg.provider, s->cfg.model,
+             s->cfg.temperature);
+    if (g_cf.on_reload) g_cf.on_reload(&cur->cfg, &s->cfg);
+    reclaim();
+    pthread_mutex_unlock(&g_cf.lock);
+    return 1;
+}
+
+/* True if pending events name the config file. */
+static bool file_changed(int ifd, const char *name) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool hit = false;
+    for (;;) {
+        ssize_t n = read(ifd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        for (char *p = buf; p < buf + n;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            p += sizeof(*ev) + ev->len;
+            if ((ev->mask & IN_Q_OVERFLOW) || (ev->len && !strcmp(ev->name, name))) hit = true;
+        }
+    }
+    return hit;
+}
+
+/* The file's directory is watched rather than the file, so that editors
+ * which save by renaming a new file over it are seen too. */
+static void watch_file(void) {
+    char dir[512];
+    const char *slash = strrchr(g_cf.path, '/');
+    if (slash) snprintf(dir, sizeof(dir), "%.*s", (int)(slash - g_cf.path + (slash == g_cf.path)), g_cf.path);
+    else snprintf(dir, sizeof(dir), ".");
+    g_cf.name = slash ? slash + 1 : g_cf.path;
+
+    g_cf.ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (g_cf.ifd >= 0 && inotify_add_watch(g_cf.ifd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(g_cf.ifd);
+        g_cf.ifd = -1;
+    }
+    if (g_cf.ifd < 0)
+        LOG_WARN("config: cannot watch %s (%s); reload with SIGHUP", dir, strerror(errno));
+}
+
+static void *watch_run(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&g_cf.lock);
+        int timeout = g_cf.retired ? 1000 : -1;
+        pthread_mutex_unlock(&g_cf.lock);
+
+        struct pollfd pf[2] = { { g_cf.pipe[0], POLLIN, 0 }, { g_cf.ifd, POLLIN, 0 } };
+        if (poll(pf, 2, timeout) < 0 && errno != EINTR) {
+            LOG_ERROR("config: watcher poll failed (%s)", strerror(errno));
+            break;
+        }
+
+        bool reload = false;
+        if (pf[0].revents & POLLIN) {
+            char cmd[16];
+            ssize_t n = read(g_cf.pipe[0], cmd, sizeof(cmd));
+            for (ssize_t i = 0; i < n; i++) {
+                if (cmd[i] == 'q') return NULL;
+                reload = true;
+            }
+        }
+        if ((pf[1].revents & POLLIN) && file_changed(g_cf.ifd, g_cf.name)) reload = true;
+
+        if (reload) {
+            config_reload();
+        } else {
+            pthread_mutex_lock(&g_cf.lock);
+            reclaim();
+            pthread_mutex_unlock(&g_cf.lock);
+        }
+    }
+    return NULL;
+}
+
+bool config_watch_start(void) {
+    if (g_cf.watching) return true;
+    if (pipe2(g_cf.pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+        LOG_WARN("config: no reload pipe (%s)", strerror(errno));
+        g_cf.pipe[0] = g_cf.pipe[1] = -1;
+        return false;
+    }
+    if (g_cf.path[0]) watch_file();  /* Before the thread, so no write is missed */
+    if (pthread_create(&g_cf.thread, NULL, watch_run, NULL) != 0) {
+        LOG_WARN("config: cannot start the watcher");
+        close(g_cf.pipe[0]);
+        close(g_cf.pipe[1]);
+        if (g_cf.ifd >= 0) close(g_cf.ifd);
+        g_cf.pipe[0] = g_cf.pipe[1] = g_cf.ifd = -1;
+        return false;
+    }
+    g_cf.watching = true;
+    return true;
+}
+
+void config_reload_request(void) {
+    int saved = errno;
+    if (g_cf.pipe[1] >= 0) {
+        char c = 'r';
+        ssize_t n = write(g_cf.pipe[1], &c, 1);  /* Full: a reload is pending anyway */
+        (void)n;
+    }
+    errno = saved;
+}
+
+void config_cleanup(void) {
+    if (g_cf.watching) {
+        char c = 'q';
+        while (write(g_cf.pipe[1], &c, 1) < 0 && errno == EINTR) {}
+        pthread_join(g_cf.thread, NULL);
+        g_cf.watching = false;
+    }
+    int wr = g_cf.pipe[1];
+    g_cf.pipe[1] = -1;
+    if (wr >= 0) close(wr);
+    if (g_cf.pipe[0] >= 0) close(g_cf.pipe[0]);
+    if (g_cf.ifd >= 0) close(g_cf.ifd);
+    g_cf.pipe[0] = g_cf.ifd = -1;
+
+    pthread_mutex_lock(&g_cf.lock);
+    free(atomic_exchange(&g_cf.cur, NULL));
+    while (g_cf.retired) {
+        Snap *s = g_cf.retired;
+        g_cf.retired = s->next;
+        free(s);
+    }
+    pthread_mutex_unlock(&g_cf.lock);
+}
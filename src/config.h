@@ -25,8 +25,32 @@ typedef struct {
     /* Memory */
     char memory_db[512];     /* SQLite path */
 
+    /* Cron */
+    char cron_file[512];     /* Job definitions; default <workspace>/.cclaw/cron */
+    char cron_db[512];       /* Last-run state; default <workspace>/.cclaw/cron.db */
+    int  cron_jitter;        /* Default per-job jitter window (seconds) */
+    int  cron_max_concurrent;/* Max cron agent turns (and provider calls) at once */
+    int  timer_max_concurrent;/* Max reminder (timer) agent turns at once */
+
+    /* Tools */
+    char tools_dir[512];     /* Plugin tool directory (*.so); empty = none */
+    bool stream_tool_output; /* Forward live tool output to WS/Telegram */
+    int  shell_timeout;      /* Seconds before a shell command is killed (0 = never) */
+    int  shell_cpu_limit;    /* RLIMIT_CPU seconds (0 = unlimited) */
+    long shell_mem_limit;    /* RLIMIT_AS in MB (0 = unlimited) */
+    long shell_fsize_limit;  /* RLIMIT_FSIZE in MB (0 = unlimited) */
+    char shell_cgroup[512];  /* cgroup v2 dir for shell commands; empty = none */
+    int  shell_pool;         /* Persistent shells kept (one per session; 0 = off) */
+    int  shell_pool_idle;    /* Seconds before an idle persistent shell is closed */
+    bool shell_sandbox;      /* Run shell commands in a namespace sandbox */
+    bool shell_sandbox_network; /* Sandbox shares the host network (false = none) */
+    bool file_fsync;         /* fsync file_write/file_edit results */
+    int  file_cache_mb;      /* File content cache budget (0 = off) */
+    bool tool_result_cache;  /* Reuse results of idempotent tool calls */
+
     /* Logging */
     int log_level;           /* 0=trace .. 5=fatal */
+    int mem_track;           /* Heap tracking: 0=off, 1=stats, 2=leaks (MemTrack) */
 } CClawConfig;
 
 /* Parse config from file. Returns 0 on success. */
@@ -41,4 +65,44 @@ void config_defaults(CClawConfig *cfg);
 /* Print config summary to stderr. */
 void config_dump(const CClawConfig *cfg);
 
+/* ── Live config ────────────────────────────────────────────────
+ *
+ * The running config is an immutable snapshot. A reload parses a new one
+ * and swaps it in; readers take no lock, and a replaced snapshot is freed
+ * once every thread that might still be reading it has released it.
+ * Provider, API key, model, temperature, the Telegram token and
+ * allowlist, stream_tool_output and log_level take effect on reload;
+ * the rest is read at startup and changes only on restart. */
+
+/* Publish `cfg` as the first snapshot. A reload starts again from `base`
+ * (defaults and command-line options), reads the file at `path` (NULL =
+ * none) and the environment over it. */
+void config_init(const CClawConfig *cfg, const CClawConfig *base, const char *path);
+
+/* The current snapshot, unchanged until released. Nests; a turn takes
+ * one at its start and keeps it to the end. NULL before config_init(). */
+const CClawConfig *config_acquire(void);
+
+void config_release(const CClawConfig *cfg);
+
+/* Called after each reload that changed something, with the previous
+ * and new snapshots. Set before config_watch_start(). */
+typedef void (*ConfigReloadFn)(const CClawConfig *old, const CClawConfig *cfg);
+void config_on_reload(ConfigReloadFn fn);
+
+/* Re-read the config now. Returns 1 if it changed, 0 if not, -1 if the
+ * file can't be read (the current snapshot stays). */
+int config_reload(void);
+
+/* Start a thread that reloads when the file is written or replaced, and
+ * on config_reload_request(). */
+bool config_watch_start(void);
+
+/* Ask the watcher to reload. Async-signal-safe: call it from a SIGHUP
+ * handler. Ignored before config_watch_start(). */
+void config_reload_request(void);
+
+/* Stop the watcher and free every snapshot. No reader may remain. */
+void config_cleanup(void);
+
 #endif
@@ -2,36 +2,79 @@
  * Built-in cron scheduler.
  *
  * Supports standard 5-field cron expressions (minute hour mday month wday).
- * Wildcards (*) and step values (*/N) are supported.
- * Runs in its own thread, checking every 30 seconds for due jobs.
+ * Wildcards (*) and step values (*\/N) are supported.
+ *
+ * Jobs are kept in a min-heap ordered by their next due minute; the scheduler
+ * thread sleeps on a condition variable until the heap top is due or the job
+ * table changes, so the cost per wakeup is O(log n) rather than a scan of
+ * every job.
+ *
+ * With a CronStore attached, each job's last run is persisted before the job
+ * fires; when a job is added, runs missed during downtime are skipped, fired
+ * once, or replayed according to the job's catch-up rule.
  */
 
 #include "cron.h"
 #include "log.h"
+#include "util.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
+#include <ctype.h>
+#include <stdint.h>
+
+#define MEM_TAG MEM_OTHER
+#include "mem.h"
 
 void cron_init(CronScheduler *sched) {
     memset(sched, 0, sizeof(*sched));
+    sched->free_head = -1;
+    pthread_mutex_init(&sched->lock, NULL);
+    pthread_cond_init(&sched->wake, NULL);
+    pthread_cond_init(&sched->work, NULL);
+}
+
+void cron_free(CronScheduler *sched) {
+    free(sched->jobs);
+    free(sched->heap);
+    free(sched->index);
+    free(sched->queue);
+    free(sched->worker_threads);
+    sched->queue = NULL;
+    sched->worker_threads = NULL;
+    pthread_cond_destroy(&sched->work);
+    pthread_cond_destroy(&sched->wake);
+    pthread_mutex_destroy(&sched->lock);
+    sched->jobs = NULL;
+    sched->heap = NULL;
+    sched->index = NULL;
+    sched->cap = sched->count = sched->used = sched->heap_len = 0;
+    sched->index_cap = sched->index_used = 0;
+    sched->free_head = -1;
+}
+
+void cron_set_store(CronScheduler *sched, CronStore *store) {
+    pthread_mutex_lock(&sched->lock);
+    sched->store = store;
+    pthread_mutex_unlock(&sched->lock);
 }
 
-/* Parse a single cron field. Supports: *, N, */N */
+/* Parse a single cron field. Supports: *, N, *\/N */
 static int parse_field(const char *field, int min, int max) {
-    (void)min; (void)max;
     if (!field) return -1;
     if (field[0] == '*') {
         if (field[1] == '/') {
             /* Step value — we store the step as a negative number minus 100
-             * to distinguish from wildcards. E.g., */5 = -105 */
+             * to distinguish from wildcards. E.g., *\/5 = -105 */
             int step = atoi(field + 2);
             if (step <= 0) return -1;
             return -(100 + step);
         }
         return -1; /* Wildcard */
     }
-    return atoi(field);
+    int v = atoi(field);
+    if (v < min || v > max) return -2; /* Out of range */
+    return v;
 }
 
 int cron_parse(const char *expr_str, CronExpr *expr) {
@@ -41,10 +84,11 @@ int cron_parse(const char *expr_str, CronExpr *expr) {
 
     char *fields[5];
     int nf = 0;
-    char *tok = strtok(buf, " \t");
+    char *save = NULL;
+    char *tok = strtok_r(buf, " \t", &save);
     while (tok && nf < 5) {
         fields[nf++] = tok;
-        tok = strtok(NULL, " \t");
+        tok = strtok_r(NULL, " \t", &save);
     }
 
     if (nf != 5) {
@@ -58,6 +102,12 @@ int cron_parse(const char *expr_str, CronExpr *expr) {
     expr->month  = parse_field(fields[3], 1, 12);
     expr->wday   = parse_field(fields[4], 0, 6);
 
+    if (expr->minute == -2 || expr->hour == -2 || expr->mday == -2 ||
+        expr->month == -2 || expr->wday == -2) {
+        LOG_ERROR("cron_parse: field out of range in '%s'", expr_str);
+        return -1;
+    }
+
     return 0;
 }
 
@@ -65,7 +115,7 @@ int cron_parse(const char *expr_str, CronExpr *expr) {
 static bool field_matches(int field_val, int time_val) {
     if (field_val == -1) return true;  /* Wildcard */
     if (field_val < -100) {
-        /* Step value: */N means time_val % N == 0 */
+        /* Step value: *\/N means time_val % N == 0 */
         int step = -(field_val + 100);
         return (time_val % step) == 0;
     }
@@ -80,73 +130,569 @@ bool cron_matches(const CronExpr *expr, const struct tm *tm) {
         && field_matches(expr->wday,   tm->tm_wday);
 }
 
+/* Skip whole months, days and hours that can't match instead of testing
+ * every minute, so even sparse expressions resolve in a few hundred steps. */
+time_t cron_next(const CronExpr *expr, time_t after) {
+    time_t t = after - (after % 60) + 60;
+    time_t limit = t + CRON_LOOKAHEAD;
+    struct tm tm;
+
+    while (t < limit) {
+        localtime_r(&t, &tm);
+        time_t next;
+
+        if (!field_matches(expr->month, tm.tm_mon + 1)) {
+            tm.tm_mon++;
+            tm.tm_mday = 1;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+        } else if (!field_matches(expr->mday, tm.tm_mday) ||
+                   !field_matches(expr->wday, tm.tm_wday)) {
+            tm.tm_mday++;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+        } else if (!field_matches(expr->hour, tm.tm_hour)) {
+            tm.tm_hour++;
+            tm.tm_min = 0;
+        } else if (!field_matches(expr->minute, tm.tm_min)) {
+            t += 60;
+            continue;
+        } else {
+            return t;
+        }
+
+        tm.tm_sec = 0;
+        tm.tm_isdst = -1;
+        next = mktime(&tm);
+        t = next > t ? next : t + 60; /* Always make progress across DST */
+    }
+    return 0;
+}
+
+/* --- Heap keyed by next_run ---------------------------------------------- */
+
+static bool heap_less(const CronScheduler *sched, int a, int b) {
+    const CronJob *ja = &sched->jobs[a], *jb = &sched->jobs[b];
+    if (ja->next_run != jb->next_run) return ja->next_run < jb->next_run;
+    return a < b;
+}
+
+static void heap_set(CronScheduler *sched, int pos, int slot) {
+    sched->heap[pos] = slot;
+    sched->jobs[slot].heap_pos = pos;
+}
+
+static void heap_up(CronScheduler *sched, int pos) {
+    int slot = sched->heap[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!heap_less(sched, slot, sched->heap[parent])) break;
+        heap_set(sched, pos, sched->heap[parent]);
+        pos = parent;
+    }
+    heap_set(sched, pos, slot);
+}
+
+static void heap_down(CronScheduler *sched, int pos) {
+    int slot = sched->heap[pos];
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= sched->heap_len) break;
+        if (child + 1 < sched->heap_len &&
+            heap_less(sched, sched->heap[child + 1], sched->heap[child])) child++;
+        if (!heap_less(sched, sched->heap[child], slot)) break;
+        heap_set(sched, pos, sched->heap[child]);
+        pos = child;
+    }
+    heap_set(sched, pos, slot);
+}
+
+static void heap_push(CronScheduler *sched, int slot) {
+    heap_set(sched, sched->heap_len++, slot);
+    heap_up(sched, sched->heap_len - 1);
+}
+
+static void heap_remove(CronScheduler *sched, int slot) {
+    int pos = sched->jobs[slot].heap_pos;
+    if (pos < 0) return;
+    sched->jobs[slot].heap_pos = -1;
+    int last = sched->heap[--sched->heap_len];
+    if (pos == sched->heap_len) return;
+    heap_set(sched, pos, last);
+    heap_up(sched, pos);
+    heap_down(sched, sched->jobs[last].heap_pos);
+}
+
+/* (Re)insert a job after its next_run changed; next_run 0 unschedules it. */
+static void heap_update(CronScheduler *sched, int slot) {
+    heap_remove(sched, slot);
+    if (sched->jobs[slot].next_run) heap_push(sched, slot);
+}
+
+/* --- Name index ----------------------------------------------------------- */
+
+/* Find the index position holding `name`, or -1. */
+static int index_find(const CronScheduler *sched, const char *name) {
+    if (!sched->index_cap) return -1;
+    uint32_t mask = (uint32_t)sched->index_cap - 1;
+    for (uint32_t i = fnv1a(name) & mask;; i = (i + 1) & mask) {
+        int e = sched->index[i];
+        if (e == 0) return -1;
+        if (e > 0 && !strcmp(sched->jobs[e - 1].name, name)) return (int)i;
+    }
+}
+
+static void index_insert(CronScheduler *sched, int slot);
+
+static void index_grow(CronScheduler *sched) {
+    int *old = sched->index;
+    int old_cap = sched->index_cap;
+
+    /* Size for the live jobs only; rehashing also drops tombstones */
+    sched->index_cap = 64;
+    while ((sched->count + 1) * 4 > sched->index_cap) sched->index_cap *= 2;
+    sched->index = calloc((size_t)sched->index_cap, sizeof(int));
+    sched->index_used = 0;
+
+    for (int i = 0; i < old_cap; i++) {
+        if (old[i] > 0) index_insert(sched, old[i] - 1);
+    }
+    free(old);
+}
+
+static void index_insert(CronScheduler *sched, int slot) {
+    if ((sched->index_used + 1) * 2 > sched->index_cap) index_grow(sched);
+    uint32_t mask = (uint32_t)sched->index_cap - 1;
+    uint32_t i = fnv1a(sched->jobs[slot].name) & mask;
+    while (sched->index[i] > 0) i = (i + 1) & mask;
+    if (sched->index[i] == 0) sched->index_used++;
+    sched->index[i] = slot + 1;
+}
+
+/* --- Job table ------------------------------------------------------------ */
+
+static int slot_alloc(CronScheduler *sched) {
+    if (sched->free_head >= 0) {
+        int slot = sched->free_head;
+        sched->free_head = sched->jobs[slot].next_free;
+        return slot;
+    }
+    if (sched->used >= sched->cap) {
+        int new_cap = sched->cap ? sched->cap * 2 : 64;
+        CronJob *jobs = realloc(sched->jobs, (size_t)new_cap * sizeof(CronJob));
+        int *heap = realloc(sched->heap, (size_t)new_cap * sizeof(int));
+        if (jobs) sched->jobs = jobs;
+        if (heap) sched->heap = heap;
+        if (!jobs || !heap) return -1;
+        sched->cap = new_cap;
+    }
+    return sched->used++;
+}
+
+static void slot_release(CronScheduler *sched, int slot) {
+    sched->jobs[slot].active = false;
+    sched->jobs[slot].next_free = sched->free_head;
+    sched->free_head = slot;
+}
+
+/* First run for a newly added job, honoring its catch-up rule for runs
+ * missed between the persisted last_run and the current minute. */
+static time_t plan_first_run(CronJob *job, time_t now) {
+    time_t current = now - (now % 60);
+    job->replay_end = 0;
+    time_t resume = job->last_run > current - 60 ? job->last_run : current - 60;
+    if (job->last_run == 0) return cron_next(&job->expr, resume); /* Never ran */
+
+    time_t from = job->last_run;
+    if (from < current - CRON_CATCHUP_WINDOW) from = current - CRON_CATCHUP_WINDOW;
+
+    /* Ring of the most recent CRON_CATCHUP_MAX missed slots */
+    time_t missed[CRON_CATCHUP_MAX];
+    int total = 0;
+    for (time_t t = cron_next(&job->expr, from); t && t < current;
+         t = cron_next(&job->expr, t)) {
+        missed[total % CRON_CATCHUP_MAX] = t;
+        total++;
+    }
+
+    if (total == 0) return cron_next(&job->expr, resume);
+    int nmissed = total < CRON_CATCHUP_MAX ? total : CRON_CATCHUP_MAX;
+    int oldest = total < CRON_CATCHUP_MAX ? 0 : total % CRON_CATCHUP_MAX;
+
+    switch (job->catchup) {
+    case CRON_CATCHUP_ONCE:
+        LOG_INFO("cron: job '%s' missed %d run(s), firing once", job->name, total);
+        return missed[(total - 1) % CRON_CATCHUP_MAX];
+    case CRON_CATCHUP_ALL:
+        /* Later missed slots follow via cron_next() once this one fires;
+         * cron_run() holds each until the one before it has finished */
+        LOG_INFO("cron: job '%s' missed %d run(s), replaying %d",
+                 job->name, total, nmissed);
+        job->replay_end = current;
+        return missed[oldest];
+    case CRON_CATCHUP_SKIP:
+    default:
+        LOG_INFO("cron: job '%s' missed %d run(s), skipping", job->name, total);
+        return cron_next(&job->expr, resume);
+    }
+}
+
 int cron_add(CronScheduler *sched, const char *name, const char *expr_str,
              CronJobFn fn, void *userdata) {
-    if (sched->count >= CRON_MAX_JOBS) {
-        LOG_ERROR("cron: max jobs (%d) reached", CRON_MAX_JOBS);
+    CronExpr expr;
+    if (cron_parse(expr_str, &expr) != 0) {
+        LOG_ERROR("cron: invalid expression '%s' for job '%s'", expr_str, name);
         return -1;
     }
 
-    CronJob *job = &sched->jobs[sched->count];
-    strncpy(job->name, name, sizeof(job->name) - 1);
+    pthread_mutex_lock(&sched->lock);
 
-    if (cron_parse(expr_str, &job->expr) != 0) {
-        LOG_ERROR("cron: invalid expression '%s' for job '%s'", expr_str, name);
-        return -1;
+    int slot;
+    int idx = index_find(sched, name);
+    if (idx >= 0) {
+        slot = sched->index[idx] - 1; /* Replace in place */
+    } else {
+        slot = slot_alloc(sched);
+        if (slot < 0) {
+            pthread_mutex_unlock(&sched->lock);
+            LOG_ERROR("cron: out of memory adding job '%s'", name);
+            return -1;
+        }
+        memset(&sched->jobs[slot], 0, sizeof(CronJob));
+        sched->jobs[slot].heap_pos = -1;
+        strncpy(sched->jobs[slot].name, name, sizeof(sched->jobs[slot].name) - 1);
+        index_insert(sched, slot);
+        sched->count++;
     }
 
+    CronJob *job = &sched->jobs[slot];
+    job->expr = expr;
     job->fn = fn;
     job->userdata = userdata;
-    job->last_run = 0;
+    job->last_run = sched->store ? cron_store_last_run(sched->store, job->name) : 0;
+    job->catchup = CRON_CATCHUP_SKIP;
+    job->jitter = job->offset = 0;
+    job->busy = job->waiting = false;
     job->active = true;
+    job->next_run = plan_first_run(job, time(NULL));
+    heap_update(sched, slot);
+
+    pthread_cond_signal(&sched->wake);
+    pthread_mutex_unlock(&sched->lock);
+
+    LOG_DEBUG("cron: added job '%s' [%s]", name, expr_str);
+    return slot;
+}
+
+bool cron_set_catchup(CronScheduler *sched, const char *name, CronCatchup mode) {
+    pthread_mutex_lock(&sched->lock);
+    int idx = index_find(sched, name);
+    if (idx >= 0) {
+        int slot = sched->index[idx] - 1;
+        CronJob *job = &sched->jobs[slot];
+        job->catchup = mode;
+        job->next_run = plan_first_run(job, time(NULL));
+        if (job->next_run) job->next_run += job->offset;
+        heap_update(sched, slot);
+        pthread_cond_signal(&sched->wake);
+    }
+    pthread_mutex_unlock(&sched->lock);
+    return idx >= 0;
+}
 
-    LOG_INFO("cron: added job '%s' [%s]", name, expr_str);
-    return sched->count++;
+bool cron_set_jitter(CronScheduler *sched, const char *name, int window) {
+    if (window < 0) window = 0;
+    if (window > CRON_MAX_JITTER) window = CRON_MAX_JITTER;
+
+    pthread_mutex_lock(&sched->lock);
+    int idx = index_find(sched, name);
+    if (idx >= 0) {
+        int slot = sched->index[idx] - 1;
+        CronJob *job = &sched->jobs[slot];
+        /* Re-base on the unjittered minute, then apply the new offset */
+        if (job->next_run) job->next_run -= job->offset;
+        job->jitter = window;
+        uint32_t h = fnv1a(job->name);
+        h ^= h >> 16; h *= 0x85ebca6bu; h ^= h >> 13; /* Spread similar names */
+        job->offset = window ? (int)(h % (uint32_t)window) : 0;
+        if (job->next_run) job->next_run += job->offset;
+        heap_update(sched, slot);
+        pthread_cond_signal(&sched->wake);
+    }
+    pthread_mutex_unlock(&sched->lock);
+    return idx >= 0;
+}
+
+void cron_set_concurrency(CronScheduler *sched, int max_jobs) {
+    pthread_mutex_lock(&sched->lock);
+    sched->workers = max_jobs > 0 ? max_jobs : 0;
+    pthread_mutex_unlock(&sched->lock);
 }
 
 bool cron_remove(CronScheduler *sched, const char *name) {
-    for (int i = 0; i < sched->count; i++) {
-        if (!strcmp(sched->jobs[i].name, name)) {
-            sched->jobs[i].active = false;
-            LOG_INFO("cron: removed job '%s'", name);
-            return true;
-        }
+    pthread_mutex_lock(&sched->lock);
+    int idx = index_find(sched, name);
+    if (idx >= 0) {
+        int slot = sched->index[idx] - 1;
+        sched->index[idx] = -1; /* Tombstone */
+        heap_remove(sched, slot);
+        slot_release(sched, slot);
+        sched->count--;
+    }
+    pthread_mutex_unlock(&sched->lock);
+
+    if (idx >= 0) LOG_DEBUG("cron: removed job '%s'", name);
+    return idx >= 0;
+}
+
+/* Clear a job's busy flag once its callback has finished, and put back a
+ * catch-up replay that was waiting for it. */
+static void job_done(CronScheduler *sched, const char *name) {
+    int idx = index_find(sched, name);
+    if (idx < 0) return;
+    int slot = sched->index[idx] - 1;
+    CronJob *job = &sched->jobs[slot];
+    job->busy = false;
+    if (job->waiting) {
+        job->waiting = false;
+        heap_update(sched, slot);
+        pthread_cond_signal(&sched->wake);
+    }
+}
+
+static void queue_push(CronScheduler *sched, const CronWork *w) {
+    if (sched->q_len >= sched->q_cap) {
+        int new_cap = sched->q_cap ? sched->q_cap * 2 : 16;
+        CronWork *q = malloc((size_t)new_cap * sizeof(CronWork));
+        for (int i = 0; i < sched->q_len; i++)
+            q[i] = sched->queue[(sched->q_head + i) % sched->q_cap];
+        free(sched->queue);
+        sched->queue = q;
+        sched->q_cap = new_cap;
+        sched->q_head = 0;
+    }
+    sched->queue[(sched->q_head + sched->q_len) % sched->q_cap] = *w;
+    sched->q_len++;
+}
+
+static void *worker_main(void *arg) {
+    CronScheduler *sched = arg;
+
+    pthread_mutex_lock(&sched->lock);
+    for (;;) {
+        while (sched->running && sched->q_len == 0)
+            pthread_cond_wait(&sched->work, &sched->lock);
+        if (!sched->running) break;
+
+        CronWork w = sched->queue[sched->q_head];
+        sched->q_head = (sched->q_head + 1) % sched->q_cap;
+        sched->q_len--;
+        CronStore *store = sched->store;
+        pthread_mutex_unlock(&sched->lock);
+
+        /* Recorded only now: a run still queued at shutdown is dropped
+         * unrecorded and counts as missed on the next start */
+        if (store) cron_store_mark(store, w.name, w.minute);
+        w.fn(w.userdata);
+
+        pthread_mutex_lock(&sched->lock);
+        job_done(sched, w.name);
     }
-    return false;
+    pthread_mutex_unlock(&sched->lock);
+    return NULL;
 }
 
 void cron_run(CronScheduler *sched) {
+    pthread_mutex_lock(&sched->lock);
     sched->running = true;
-    LOG_INFO("cron: scheduler started (%d jobs)", sched->count);
+    LOG_INFO("cron: scheduler started (%d jobs, %d workers)", sched->count, sched->workers);
+
+    int nworkers = sched->workers;
+    if (nworkers > 0) {
+        sched->worker_threads = calloc((size_t)nworkers, sizeof(pthread_t));
+        for (int i = 0; i < nworkers; i++)
+            pthread_create(&sched->worker_threads[i], NULL, worker_main, sched);
+    }
 
     while (sched->running) {
         time_t now = time(NULL);
-        struct tm *tm = localtime(&now);
 
-        for (int i = 0; i < sched->count; i++) {
-            CronJob *job = &sched->jobs[i];
-            if (!job->active) continue;
+        if (sched->heap_len > 0 && sched->jobs[sched->heap[0]].next_run <= now) {
+            int slot = sched->heap[0];
+            CronJob *job = &sched->jobs[slot];
+            time_t minute = job->next_run - job->offset;
+
+            if (job->busy && minute < job->replay_end) {
+                /* A missed run is replayed, not skipped: park the job
+                 * until job_done() re-queues it */
+                heap_remove(sched, slot);
+                job->waiting = true;
+                continue;
+            }
 
-            /* Only fire once per minute */
-            time_t minute_start = now - (now % 60);
-            if (job->last_run >= minute_start) continue;
+            job->last_run = minute;
+            job->next_run = cron_next(&job->expr, minute);
+            if (job->next_run) job->next_run += job->offset;
+            heap_update(sched, slot);
 
-            if (cron_matches(&job->expr, tm)) {
-                LOG_DEBUG("cron: firing job '%s'", job->name);
-                job->last_run = now;
-                job->fn(job->userdata);
+            if (job->busy) {
+                LOG_WARN("cron: job '%s' still running, skipping this run", job->name);
+                continue;
             }
-        }
 
-        /* Sleep 30 seconds between checks */
-        for (int i = 0; i < 30 && sched->running; i++) {
-            sleep(1);
+            /* Copy what the callback needs: the slot may be removed or
+             * reused while the lock is released. */
+            CronWork w;
+            memcpy(w.name, job->name, sizeof(w.name));
+            w.fn = job->fn;
+            w.userdata = job->userdata;
+            w.minute = minute;
+            job->busy = true;
+
+            LOG_DEBUG("cron: firing job '%s'", w.name);
+            if (nworkers > 0) {
+                queue_push(sched, &w);
+                pthread_cond_signal(&sched->work);
+            } else {
+                CronStore *store = sched->store;
+                pthread_mutex_unlock(&sched->lock);
+                /* State is written first so a crash mid-job can't double-fire */
+                if (store) cron_store_mark(store, w.name, minute);
+                w.fn(w.userdata);
+                pthread_mutex_lock(&sched->lock);
+                job_done(sched, w.name);
+            }
+            continue;
         }
+
+        /* Sleep until the earliest job is due (or a minute, if idle) */
+        struct timespec deadline = {
+            .tv_sec = sched->heap_len > 0 ? sched->jobs[sched->heap[0]].next_run
+                                          : now + 60,
+        };
+        pthread_cond_timedwait(&sched->wake, &sched->lock, &deadline);
     }
 
+    /* Let running callbacks finish. Anything still queued is dropped
+     * unrecorded, so the job's catch-up rule covers it on the next start */
+    if (sched->q_len > 0) LOG_WARN("cron: dropping %d queued job(s)", sched->q_len);
+    sched->q_len = 0;
+    pthread_cond_broadcast(&sched->work);
+    pthread_mutex_unlock(&sched->lock);
+
+    for (int i = 0; i < nworkers; i++) pthread_join(sched->worker_threads[i], NULL);
+
     LOG_INFO("cron: scheduler stopped");
 }
 
 void cron_stop(CronScheduler *sched) {
+    pthread_mutex_lock(&sched->lock);
     sched->running = false;
+    pthread_cond_signal(&sched->wake);
+    pthread_cond_broadcast(&sched->work);
+    pthread_mutex_unlock(&sched->lock);
+}
+
+/* Trim whitespace in-place. */
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *end = s + strlen(s) - 1;
+    while (end > s && isspace((unsigned char)*end)) *end-- = '\0';
+    return s;
+}
+
+/*
+ * Cron file format (same key=value style as the config file, one section
+ * per job):
+ *
+ *   [heartbeat]
+ *   schedule    = "*\/30 * * * *"
+ *   prompt_file = "HEARTBEAT.md"
+ *   session     = "heartbeat"
+ *   catchup     = "once"
+ *   jitter      = 120
+ */
+int cron_load_tasks(const char *path, CronTask **out) {
+    *out = NULL;
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+
+    CronTask *tasks = NULL;
+    int count = 0, cap = 0;
+    CronTask *cur = NULL;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), fp)) {
+        char *l = trim(line);
+        if (*l == '\0' || *l == '#') continue;
+
+        if (*l == '[') {
+            char *close = strchr(l, ']');
+            if (!close) continue;
+            *close = '\0';
+            if (count >= cap) {
+                cap = cap ? cap * 2 : 8;
+                tasks = realloc(tasks, (size_t)cap * sizeof(CronTask));
+            }
+            cur = &tasks[count++];
+            memset(cur, 0, sizeof(*cur));
+            cur->jitter = -1;
+            strncpy(cur->name, trim(l + 1), sizeof(cur->name) - 1);
+            continue;
+        }
+
+        if (!cur) continue;
+
+        char *eq = strchr(l, '=');
+        if (!eq) continue;
+        *eq = '\0';
+
+        char *key = trim(l);
+        char *val = trim(eq + 1);
+
+        /* Strip quotes */
+        size_t vlen = strlen(val);
+        if (vlen >= 2 && val[0] == '"' && val[vlen-1] == '"') {
+            val[vlen-1] = '\0';
+            val++;
+        }
+
+        if      (!strcmp(key, "schedule"))    strncpy(cur->schedule, val, sizeof(cur->schedule)-1);
+        else if (!strcmp(key, "session"))     strncpy(cur->session, val, sizeof(cur->session)-1);
+        else if (!strcmp(key, "prompt_file")) strncpy(cur->prompt_file, val, sizeof(cur->prompt_file)-1);
+        else if (!strcmp(key, "prompt"))      { free(cur->prompt); cur->prompt = strdup(val); }
+        else if (!strcmp(key, "jitter"))      cur->jitter = atoi(val);
+        else if (!strcmp(key, "catchup")) {
+            if      (!strcmp(val, "once")) cur->catchup = CRON_CATCHUP_ONCE;
+            else if (!strcmp(val, "all"))  cur->catchup = CRON_CATCHUP_ALL;
+            else                           cur->catchup = CRON_CATCHUP_SKIP;
+        }
+        else LOG_WARN("cron: unknown key '%s' in job '%s'", key, cur->name);
+    }
+    fclose(fp);
+
+    /* Fill defaults and drop incomplete entries */
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        CronTask *t = &tasks[i];
+        if (!t->schedule[0] || (!t->prompt && !t->prompt_file[0])) {
+            LOG_WARN("cron: job '%s' needs a schedule and a prompt, skipping", t->name);
+            free(t->prompt);
+            continue;
+        }
+        if (!t->session[0]) snprintf(t->session, sizeof(t->session), "cron_%.58s", t->name);
+        tasks[n++] = *t;
+    }
+
+    if (n == 0) {
+        free(tasks);  /* Every entry was dropped */
+        tasks = NULL;
+    }
+    *out = tasks;
+    return n;
+}
+
+void cron_tasks_free(CronTask *tasks, int count) {
+    for (int i = 0; i < count; i++) free(tasks[i].prompt);
+    free(tasks);
 }
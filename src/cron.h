@@ -1,10 +1,10 @@
 #ifndef CCLAW_CRON_H
 #define CCLAW_CRON_H
 
+#include "cron_store.h"
 #include <stdbool.h>
 #include <time.h>
-
-#define CRON_MAX_JOBS 64
+#include <pthread.h>
 
 /* Cron job callback. */
 typedef void (*CronJobFn)(void *userdata);
@@ -19,37 +19,131 @@ typedef struct {
     int wday;       /* 0-6 (Sun=0) or -1 */
 } CronExpr;
 
+/* What to do with runs missed while the process was down. */
+typedef enum {
+    CRON_CATCHUP_SKIP,   /* Drop missed runs (default) */
+    CRON_CATCHUP_ONCE,   /* Fire once if any run was missed */
+    CRON_CATCHUP_ALL,    /* Replay every missed run, up to CRON_CATCHUP_MAX */
+} CronCatchup;
+
+/* Catch-up never looks further back than this, nor replays more than
+ * CRON_CATCHUP_MAX runs per job. */
+#define CRON_CATCHUP_WINDOW (7 * 24 * 3600)
+#define CRON_CATCHUP_MAX    24
+
+/* How far ahead cron_next() searches for a matching minute. */
+#define CRON_LOOKAHEAD      (5 * 366 * 24 * 3600)
+
 typedef struct {
-    char       name[64];
-    CronExpr   expr;
-    CronJobFn  fn;
-    void      *userdata;
-    time_t     last_run;
-    bool       active;
+    char        name[64];
+    CronExpr    expr;
+    CronJobFn   fn;
+    void       *userdata;
+    time_t      last_run;   /* Start of the minute the job last fired for */
+    time_t      next_run;   /* Heap key: next due time (minute + offset) */
+    CronCatchup catchup;
+    int         jitter;     /* Jitter window in seconds, 0 = none */
+    int         offset;     /* Deterministic delay within the window */
+    int         heap_pos;   /* Index in sched->heap, -1 if not scheduled */
+    int         next_free;  /* Free-list link while the slot is unused */
+    time_t      replay_end; /* Runs before this minute are catch-up replays */
+    bool        busy;       /* Queued or running on a worker */
+    bool        waiting;    /* Replay due while busy: off the heap until done */
+    bool        active;
 } CronJob;
 
+/* Queued callback for a worker thread */
 typedef struct {
-    CronJob jobs[CRON_MAX_JOBS];
-    int     count;
-    bool    running;
+    char      name[64];
+    CronJobFn fn;
+    void     *userdata;
+    time_t    minute;   /* Recorded in the store when a worker picks it up */
+} CronWork;
+
+/* Jitter windows are capped so a job never drifts past the next hour. */
+#define CRON_MAX_JITTER 3600
+
+/*
+ * Jobs live in a growable slot array; removed slots go on a free list and
+ * are reused. Scheduled jobs sit in a binary min-heap keyed by next_run, and
+ * a name index (open addressing) maps names to slots, so add and remove are
+ * O(log n) and the scheduler thread sleeps until the earliest job is due.
+ * All fields are guarded by `lock`; callbacks run with the lock released.
+ */
+typedef struct {
+    CronJob        *jobs;
+    int             cap;
+    int             count;      /* Live jobs */
+    int             free_head;  /* First free slot, -1 if none */
+    int             used;       /* Slots ever handed out (high-water mark) */
+    int            *heap;       /* Slot indices ordered by next_run */
+    int             heap_len;
+    int            *index;      /* Name → slot + 1; 0 empty, -1 deleted */
+    int             index_cap;
+    int             index_used; /* Occupied + deleted entries */
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    bool            running;
+    CronStore      *store;      /* Optional: persists last_run across restarts */
+
+    /* Worker pool: at most `workers` callbacks run at once (0 = inline) */
+    int             workers;
+    pthread_t      *worker_threads;
+    CronWork       *queue;      /* Ring of due callbacks */
+    int             q_head, q_len, q_cap;
+    pthread_cond_t  work;
 } CronScheduler;
 
+/* A file-defined job that runs an agent turn. */
+typedef struct {
+    char        name[64];
+    char        schedule[128];
+    char        session[64];      /* Session id; defaults to "cron_<name>" */
+    char        prompt_file[256]; /* Workspace file read at fire time */
+    char       *prompt;           /* Inline prompt (used if no prompt_file) */
+    CronCatchup catchup;
+    int         jitter;           /* Seconds; -1 = use the global default */
+} CronTask;
+
 /* Initialize scheduler. */
 void cron_init(CronScheduler *sched);
 
-/* Parse a cron expression string ("*/5 * * * *" style).
+/* Release the job table. The scheduler must be stopped. */
+void cron_free(CronScheduler *sched);
+
+/* Attach a state store. Must be called before cron_add() so jobs pick up
+ * their persisted last_run. */
+void cron_set_store(CronScheduler *sched, CronStore *store);
+
+/* Parse a cron expression string ("*\/5 * * * *" style).
  * Returns 0 on success. */
 int cron_parse(const char *expr_str, CronExpr *expr);
 
-/* Add a job. Returns job index or -1 on failure. */
+/* Add a job. Thread-safe; a job with the same name is replaced.
+ * Returns the job's slot or -1 on failure. */
 int cron_add(CronScheduler *sched, const char *name, const char *expr_str,
              CronJobFn fn, void *userdata);
 
-/* Remove a job by name. */
+/* Set the catch-up rule for a job and re-plan its next run.
+ * Returns false if not found. */
+bool cron_set_catchup(CronScheduler *sched, const char *name, CronCatchup mode);
+
+/* Delay a job by a deterministic offset in [0, window) seconds derived
+ * from its name, so jobs sharing a schedule don't all fire in the same
+ * second. Returns false if not found. */
+bool cron_set_jitter(CronScheduler *sched, const char *name, int window);
+
+/* Run callbacks on `max_jobs` worker threads instead of the scheduler
+ * thread, capping how many run at once. Call before cron_run(). A job that
+ * is still queued or running when it comes due again is skipped, except
+ * for catch-up replays, which wait for the previous run to finish. */
+void cron_set_concurrency(CronScheduler *sched, int max_jobs);
+
+/* Remove a job by name; its slot is reused by later adds. */
 bool cron_remove(CronScheduler *sched, const char *name);
 
 /* Start the scheduler loop (blocking — run in a thread).
- * Checks every 30 seconds for due jobs. */
+ * Sleeps until the earliest job is due or the job table changes. */
 void cron_run(CronScheduler *sched);
 
 /* Stop the scheduler. */
@@ -58,4 +152,14 @@ void cron_stop(CronScheduler *sched);
 /* Check if a cron expression matches a given time. */
 bool cron_matches(const CronExpr *expr, const struct tm *tm);
 
+/* Start of the first matching minute strictly after `after`, or 0 if the
+ * expression never matches within CRON_LOOKAHEAD. */
+time_t cron_next(const CronExpr *expr, time_t after);
+
+/* Load [name] sections from a cron file into a malloc'd array.
+ * Returns the number of tasks, or -1 if the file can't be opened; *out
+ * is NULL unless tasks were loaded. */
+int  cron_load_tasks(const char *path, CronTask **out);
+void cron_tasks_free(CronTask *tasks, int count);
+
 #endif
@@ -0,0 +1,90 @@
+/*
+ * Persistent cron state.
+ *
+ * One row per job name holding the start of the minute it last fired for.
+ * The scheduler records a run *before* invoking the job, so a crash mid-turn
+ * never causes the same slot to fire twice after a restart.
+ */
+
+#include "cron_store.h"
+#include "log.h"
+#include <sqlite3.h>
+#include <stdlib.h>
+
+#define MEM_TAG MEM_OTHER
+#include "mem.h"
+
+struct CronStore {
+    sqlite3 *db;
+};
+
+CronStore *cron_store_open(const char *db_path) {
+    CronStore *s = calloc(1, sizeof(*s));
+    int rc = sqlite3_open(db_path, &s->db);
+    if (rc != SQLITE_OK) {
+        LOG_ERROR("Failed to open cron DB %s: %s", db_path, sqlite3_errmsg(s->db));
+        sqlite3_close(s->db);
+        free(s);
+        return NULL;
+    }
+
+    const char *sql =
+        "CREATE TABLE IF NOT EXISTS cron_state ("
+        "  name TEXT PRIMARY KEY,"
+        "  last_run INTEGER NOT NULL,"
+        "  updated_at INTEGER DEFAULT (strftime('%s','now'))"
+        ");";
+
+    char *err = NULL;
+    rc = sqlite3_exec(s->db, sql, NULL, NULL, &err);
+    if (rc != SQLITE_OK) {
+        LOG_ERROR("Failed to create cron_state table: %s", err);
+        sqlite3_free(err);
+        sqlite3_close(s->db);
+        free(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+void cron_store_close(CronStore *s) {
+    if (!s) return;
+    sqlite3_close(s->db);
+    free(s);
+}
+
+time_t cron_store_last_run(CronStore *s, const char *name) {
+    const char *sql = "SELECT last_run FROM cron_state WHERE name = ?;";
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(s->db, sql, -1, &stmt, NULL) != SQLITE_OK) return 0;
+
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+
+    time_t last = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        last = (time_t)sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return last;
+}
+
+bool cron_store_mark(CronStore *s, const char *name, time_t minute) {
+    const char *sql =
+        "INSERT OR REPLACE INTO cron_state (name, last_run, updated_at) "
+        "VALUES (?, ?, strftime('%s','now'));";
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(s->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        LOG_ERROR("cron_store_mark prepare: %s", sqlite3_errmsg(s->db));
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, (sqlite3_int64)minute);
+
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    if (!ok) LOG_ERROR("cron_store_mark step: %s", sqlite3_errmsg(s->db));
+    sqlite3_finalize(stmt);
+    return ok;
+}
@@ -0,0 +1,21 @@
+#ifndef CCLAW_CRON_STORE_H
+#define CCLAW_CRON_STORE_H
+
+#include <stdbool.h>
+#include <time.h>
+
+/* SQLite-backed last-run state for cron jobs, so restarts neither
+ * double-fire a job nor forget which runs were missed. */
+typedef struct CronStore CronStore;
+
+/* Open/create the cron state database. */
+CronStore *cron_store_open(const char *db_path);
+void       cron_store_close(CronStore *s);
+
+/* Last recorded run (minute start) for a job, or 0 if it never ran. */
+time_t cron_store_last_run(CronStore *s, const char *name);
+
+/* Record that a job ran for the minute starting at `minute`. */
+bool cron_store_mark(CronStore *s, const char *name, time_t minute);
+
+#endif
@@ -0,0 +1,291 @@
+/*
+ * Shared cache of small file contents (workspace identity files,
+ * configs, sources read by file_read and file_edit).
+ *
+ * Entries are keyed by path, kept in LRU order under a byte budget and
+ * refcounted, so eviction never frees data a caller still holds. Each
+ * cached inode has an inotify watch; pending events are drained at the
+ * start of every lookup, so a write that finished before the lookup is
+ * always seen. When a watch can't be added, the entry is checked against
+ * stat() (inode, size, mtime, ctime) instead.
+ */
+
+#include "file_cache.h"
+#include "log.h"
+#include "util.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#define MEM_TAG MEM_TOOLS
+#include "mem.h"
+
+#define BUCKETS    4096
+#define WATCH_MASK (IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)
+
+typedef struct Entry {
+    CachedFile    f;         /* Handed out to callers; must be first */
+    char         *path;
+    uint32_t      hash;
+    struct Entry *next;      /* Hash chain */
+    struct Entry *prev_lru, *next_lru;
+    struct Entry *next_wd;   /* Entries sharing a watch (same inode) */
+    int           wd;        /* -1 = validated by stat() */
+    int           refs;      /* Callers holding it */
+    bool          cached;    /* Still reachable from the table */
+} Entry;
+
+static struct {
+    pthread_mutex_t lock;
+    size_t          max_bytes, bytes;
+    Entry          *buckets[BUCKETS];
+    Entry          *lru_head, *lru_tail;  /* Head = most recent */
+    Entry         **by_wd;
+    size_t          wd_cap;
+    int             ifd;
+    bool            ifd_tried;
+    unsigned long   orphans;              /* Events on watches with no entry */
+    unsigned long   hits, misses;
+} g_fc = { .lock = PTHREAD_MUTEX_INITIALIZER, .ifd = -1 };
+
+void fcache_init(size_t max_bytes) {
+    pthread_mutex_lock(&g_fc.lock);
+    g_fc.max_bytes = max_bytes;
+    pthread_mutex_unlock(&g_fc.lock);
+}
+
+static void entry_free(Entry *e) {
+    free((char *)e->f.data);
+    free(e->path);
+    free(e);
+}
+
+/* ── Watches (lock held) ────────────────────────────────────── */
+
+static void wd_link(Entry *e) {
+    if ((size_t)e->wd >= g_fc.wd_cap) {
+        size_t cap = g_fc.wd_cap ? g_fc.wd_cap : 256;
+        while ((size_t)e->wd >= cap) cap *= 2;
+        g_fc.by_wd = realloc(g_fc.by_wd, cap * sizeof(Entry *));
+        memset(g_fc.by_wd + g_fc.wd_cap, 0, (cap - g_fc.wd_cap) * sizeof(Entry *));
+        g_fc.wd_cap = cap;
+    }
+    e->next_wd = g_fc.by_wd[e->wd];
+    g_fc.by_wd[e->wd] = e;
+}
+
+/* Unlink from its watch; the watch goes when its last entry does. */
+static void wd_unlink(Entry *e, bool rm_watch) {
+    if (e->wd < 0) return;
+    for (Entry **pp = &g_fc.by_wd[e->wd]; *pp; pp = &(*pp)->next_wd) {
+        if (*pp == e) { *pp = e->next_wd; break; }
+    }
+    if (rm_watch && !g_fc.by_wd[e->wd]) inotify_rm_watch(g_fc.ifd, e->wd);
+    e->wd = -1;
+}
+
+/* ── Table (lock held) ──────────────────────────────────────── */
+
+static void drop(Entry *e, bool rm_watch) {
+    for (Entry **pp = &g_fc.buckets[e->hash % BUCKETS]; *pp; pp = &(*pp)->next) {
+        if (*pp == e) { *pp = e->next; break; }
+    }
+    if (e->prev_lru) e->prev_lru->next_lru = e->next_lru;
+    else g_fc.lru_head = e->next_lru;
+    if (e->next_lru) e->next_lru->prev_lru = e->prev_lru;
+    else g_fc.lru_tail = e->prev_lru;
+
+    wd_unlink(e, rm_watch);
+    g_fc.bytes -= e->f.size;
+    e->cached = false;
+    if (e->refs == 0) entry_free(e);
+}
+
+static void lru_front(Entry *e) {
+    if (g_fc.lru_head == e) return;
+    if (e->prev_lru) e->prev_lru->next_lru = e->next_lru;
+    if (e->next_lru) e->next_lru->prev_lru = e->prev_lru;
+    else if (g_fc.lru_tail == e) g_fc.lru_tail = e->prev_lru;
+    e->prev_lru = NULL;
+    e->next_lru = g_fc.lru_head;
+    if (g_fc.lru_head) g_fc.lru_head->prev_lru = e;
+    g_fc.lru_head = e;
+    if (!g_fc.lru_tail) g_fc.lru_tail = e;
+}
+
+static Entry *lookup(const char *path, uint32_t hash) {
+    for (Entry *e = g_fc.buckets[hash % BUCKETS]; e; e = e->next)
+        if (e->hash == hash && !strcmp(e->path, path)) return e;
+    return NULL;
+}
+
+static void drop_all(void) {
+    while (g_fc.lru_head) drop(g_fc.lru_head, true);
+}
+
+/* Apply queued inotify events: any event on a watch invalidates every
+ * entry for that inode. */
+static void drain(void) {
+    if (g_fc.ifd < 0) return;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t n = read(g_fc.ifd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        for (char *p = buf; p < buf + n;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            p += sizeof(*ev) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                drop_all();
+                continue;
+            }
+            if (ev->wd < 0 || (size_t)ev->wd >= g_fc.wd_cap) continue;
+            bool gone = ev->mask & IN_IGNORED;  /* Kernel already removed the watch */
+            if (!g_fc.by_wd[ev->wd]) g_fc.orphans++;
+            while (g_fc.by_wd[ev->wd]) drop(g_fc.by_wd[ev->wd], !gone);
+        }
+    }
+}
+
+static bool same_file(const struct stat *a, const struct stat *b) {
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino && a->st_size == b->st_size &&
+           a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec &&
+           a->st_ctim.tv_sec == b->st_ctim.tv_sec && a->st_ctim.tv_nsec == b->st_ctim.tv_nsec;
+}
+
+/* ── API ────────────────────────────────────────────────────── */
+
+const CachedFile *fcache_get(const char *path) {
+    uint32_t hash = fnv1a(path);
+
+    pthread_mutex_lock(&g_fc.lock);
+    drain();
+    Entry *e = lookup(path, hash);
+    if (e && e->wd < 0) {  /* Unwatched: fall back to stat() */
+        struct stat st;
+        if (stat(path, &st) < 0 || !same_file(&st, &e->f.st)) {
+            drop(e, true);
+            e = NULL;
+        }
+    }
+    if (e) {
+        e->refs++;
+        lru_front(e);
+        g_fc.hits++;
+        pthread_mutex_unlock(&g_fc.lock);
+        return &e->f;
+    }
+    g_fc.misses++;
+    bool keep = g_fc.max_bytes > 0;
+    if (keep && !g_fc.ifd_tried) {
+        g_fc.ifd_tried = true;
+        g_fc.ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (g_fc.ifd < 0) LOG_WARN("fcache: inotify unavailable (%s); validating with stat()", strerror(errno));
+    }
+    int ifd = g_fc.ifd;
+    unsigned long orphans = g_fc.orphans;
+    pthread_mutex_unlock(&g_fc.lock);
+
+    /* Miss: read outside the lock. */
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0) { close(fd); return NULL; }
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        errno = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+        return NULL;
+    }
+    if (st.st_size > FCACHE_MAX_FILE) { close(fd); errno = EFBIG; return NULL; }
+    if (st.st_size == 0) { close(fd); errno = ENODATA; return NULL; }  /* Empty, or /proc */
+
+    /* Watch before reading, so a change during the read is reported. */
+    int wd = keep && ifd >= 0 ? inotify_add_watch(ifd, path, WATCH_MASK) : -1;
+
+    size_t size = (size_t)st.st_size, len = 0;
+    char *data = malloc(size + 1);
+    while (len < size) {
+        ssize_t n = read(fd, data + len, size - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        len += (size_t)n;
+    }
+    data[len] = '\0';
+    struct stat after;
+    bool stable = fstat(fd, &after) == 0 && same_file(&st, &after) && len == size;
+    close(fd);
+
+    e = calloc(1, sizeof(*e));
+    e->f.data = data;
+    e->f.size = len;
+    e->f.st = st;
+    e->path = strdup(path);
+    e->hash = hash;
+    e->wd = -1;
+    e->refs = 1;
+
+    /* Cache it unless it's too big for the budget or changed under us.
+     * An event on a watch with no entry may have been for this file,
+     * drained by another lookup while we read; then the copy isn't
+     * trusted either. */
+    pthread_mutex_lock(&g_fc.lock);
+    drain();
+    if (!keep || !stable || len > g_fc.max_bytes / 4 || g_fc.orphans != orphans) {
+        if (wd >= 0 && ((size_t)wd >= g_fc.wd_cap || !g_fc.by_wd[wd])) inotify_rm_watch(ifd, wd);
+        pthread_mutex_unlock(&g_fc.lock);
+        return &e->f;
+    }
+
+    e->wd = wd;
+    if (wd >= 0) wd_link(e);  /* Before dropping anything that may share the watch */
+    Entry *old = lookup(path, hash);  /* Another thread loaded it meanwhile */
+    if (old) drop(old, true);
+    while (g_fc.lru_tail && g_fc.bytes + len > g_fc.max_bytes) drop(g_fc.lru_tail, true);
+
+    e->next = g_fc.buckets[hash % BUCKETS];
+    g_fc.buckets[hash % BUCKETS] = e;
+    e->next_lru = g_fc.lru_head;
+    if (g_fc.lru_head) g_fc.lru_head->prev_lru = e;
+    g_fc.lru_head = e;
+    if (!g_fc.lru_tail) g_fc.lru_tail = e;
+    e->cached = true;
+    g_fc.bytes += len;
+    pthread_mutex_unlock(&g_fc.lock);
+    return &e->f;
+}
+
+void fcache_release(const CachedFile *f) {
+    if (!f) return;
+    Entry *e = (Entry *)f;
+    pthread_mutex_lock(&g_fc.lock);
+    bool last = --e->refs == 0 && !e->cached;
+    pthread_mutex_unlock(&g_fc.lock);
+    if (last) entry_free(e);
+}
+
+void fcache_invalidate(const char *path) {
+    pthread_mutex_lock(&g_fc.lock);
+    Entry *e = lookup(path, fnv1a(path));
+    if (e) drop(e, true);
+    pthread_mutex_unlock(&g_fc.lock);
+}
+
+void fcache_cleanup(void) {
+    pthread_mutex_lock(&g_fc.lock);
+    if (g_fc.hits + g_fc.misses)
+        LOG_DEBUG("fcache: %lu hits, %lu misses", g_fc.hits, g_fc.misses);
+    drop_all();
+    if (g_fc.ifd >= 0) close(g_fc.ifd);
+    g_fc.ifd = -1;
+    g_fc.ifd_tried = false;
+    free(g_fc.by_wd);
+    g_fc.by_wd = NULL;
+    g_fc.wd_cap = 0;
+    g_fc.hits = g_fc.misses = 0;
+    pthread_mutex_unlock(&g_fc.lock);
+}
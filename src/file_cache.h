@@ -0,0 +1,35 @@
+#ifndef CCLAW_FILE_CACHE_H
+#define CCLAW_FILE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+#define FCACHE_MAX_FILE (1024 * 1024)  /* Larger files are never cached */
+
+/* Contents of a regular file, NUL-terminated. Read-only and shared. */
+typedef struct {
+    const char *data;
+    size_t      size;
+    struct stat st;
+} CachedFile;
+
+/* Set the cache budget in bytes (0 = don't keep contents). Call once at
+ * startup; fcache_get() works either way. */
+void fcache_init(size_t max_bytes);
+
+/* The contents of `path`, from the cache if still valid or read now.
+ * Returns NULL with errno set if it can't be opened, isn't a regular
+ * file (EISDIR/EINVAL), reports size 0 like /proc files (ENODATA) or
+ * exceeds FCACHE_MAX_FILE (EFBIG). Release with fcache_release(). */
+const CachedFile *fcache_get(const char *path);
+
+void fcache_release(const CachedFile *f);
+
+/* Forget `path` (after writing it ourselves). */
+void fcache_invalidate(const char *path);
+
+/* Drop every entry and the inotify descriptor. */
+void fcache_cleanup(void);
+
+#endif
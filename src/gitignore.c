@@ -0,0 +1,99 @@
+#include "gitignore.h"
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEM_TAG MEM_TOOLS
+#include "mem.h"
+
+typedef struct {
+    char *pat;
+    bool  neg;        /* "!pattern" re-includes */
+    bool  dir_only;   /* "pattern/" */
+    bool  anchored;   /* Contains a slash: matched against the path */
+    int   flags;      /* fnmatch flags */
+} IgnoreRule;
+
+struct IgnoreSet {
+    IgnoreSet  *parent;
+    IgnoreSet  *next_all;  /* Owner's list of every set */
+    size_t      base_len;  /* Length of the directory's relative path */
+    IgnoreRule *rules;
+    size_t      nrules;
+};
+
+IgnoreSet *ignore_load(const char *dir, size_t base_len, IgnoreSet *parent, IgnoreSet **all) {
+    char path[4200];
+    snprintf(path, sizeof(path), "%s/.gitignore", dir);
+    FILE *fp = fopen(path, "r");
+    if (!fp) return NULL;
+
+    IgnoreSet *set = calloc(1, sizeof(*set));
+    set->parent = parent;
+    set->base_len = base_len;
+    size_t cap = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        size_t n = strcspn(line, "\r\n");
+        while (n && line[n - 1] == ' ' && (n < 2 || line[n - 2] != '\\')) n--;
+        line[n] = '\0';
+        if (!n || line[0] == '#') continue;
+
+        IgnoreRule r = { .flags = FNM_PATHNAME };
+        char *p = line;
+        if (*p == '!') { r.neg = true; p++; }
+        else if (*p == '\\') p++;
+        size_t len = strlen(p);
+        if (len && p[len - 1] == '/') { r.dir_only = true; p[--len] = '\0'; }
+        if (len > 3 && !strcmp(p + len - 3, "/**")) {
+            p[len -= 3] = '\0';               /* Everything inside */
+            r.flags |= FNM_LEADING_DIR;
+        }
+        if (!strncmp(p, "**/", 3) && !strchr(p + 3, '/')) p += 3;  /* Any depth */
+        r.anchored = *p == '/' || strchr(p, '/') != NULL;
+        if (*p == '/') p++;
+        if (strstr(p, "**")) r.flags &= ~FNM_PATHNAME;  /* Let '*' cross '/' */
+        if (!*p) continue;
+        r.pat = strdup(p);
+
+        if (set->nrules == cap) {
+            cap = cap ? cap * 2 : 16;
+            set->rules = realloc(set->rules, cap * sizeof(IgnoreRule));
+        }
+        set->rules[set->nrules++] = r;
+    }
+    fclose(fp);
+
+    set->next_all = *all;
+    *all = set;
+    return set;
+}
+
+/* gitignore semantics: the last matching rule wins, and rules in deeper
+ * .gitignore files override those above them. */
+bool ignore_match(const IgnoreSet *set, const char *rel, const char *name, bool is_dir) {
+    for (; set; set = set->parent) {
+        const char *sub = rel + set->base_len + (set->base_len ? 1 : 0);
+        for (size_t i = set->nrules; i-- > 0;) {
+            const IgnoreRule *r = &set->rules[i];
+            if (r->dir_only && !is_dir) continue;
+            if (fnmatch(r->pat, r->anchored ? sub : name, r->flags) == 0) return !r->neg;
+        }
+    }
+    return false;
+}
+
+bool ignore_always(const char *name) {
+    return !strcmp(name, ".") || !strcmp(name, "..") || !strcmp(name, ".git") || !strcmp(name, ".cclaw");
+}
+
+void ignore_free_all(IgnoreSet *all) {
+    while (all) {
+        IgnoreSet *next = all->next_all;
+        for (size_t i = 0; i < all->nrules; i++) free(all->rules[i].pat);
+        free(all->rules);
+        free(all);
+        all = next;
+    }
+}
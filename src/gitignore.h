@@ -0,0 +1,29 @@
+#ifndef CCLAW_GITIGNORE_H
+#define CCLAW_GITIGNORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Rules from one .gitignore, chained to those of enclosing directories.
+ * Supports the common subset: comments, "!" negation, trailing "/" for
+ * directories, anchored patterns and "**". */
+typedef struct IgnoreSet IgnoreSet;
+
+/* Load `dir`/.gitignore. `base_len` is the length of `dir`'s path
+ * relative to the walk root (0 for the root). The new set is chained to
+ * `parent` and linked into `*all` so the owner can free every set at
+ * once. NULL if `dir` has no .gitignore. */
+IgnoreSet *ignore_load(const char *dir, size_t base_len, IgnoreSet *parent, IgnoreSet **all);
+
+/* Is the entry ignored? `rel` is its path relative to the walk root and
+ * `name` its last component. `set` may be NULL. */
+bool ignore_match(const IgnoreSet *set, const char *rel, const char *name, bool is_dir);
+
+/* Entries every walk skips regardless of .gitignore: ".", "..", ".git"
+ * and ".cclaw" (sessions and scheduler state, rewritten every turn). */
+bool ignore_always(const char *name);
+
+/* Free every set linked through ignore_load(..., &all). */
+void ignore_free_all(IgnoreSet *all);
+
+#endif
@@ -1,5 +1,6 @@
 #include "http.h"
 #include "log.h"
+#include "pool.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -15,6 +16,12 @@
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/error.h"
 
+#define MEM_TAG MEM_HTTP
+#include "mem.h"
+
+#define READ_BUF    (16 * 1024)         /* First response / SSE buffer */
+#define SSE_LINE_MAX (8 * 1024 * 1024)  /* Longest SSE line accepted */
+
 struct HttpClient {
     mbedtls_entropy_context  entropy;
     mbedtls_ctr_drbg_context drbg;
@@ -112,50 +119,119 @@ static int tls_connect(HttpClient *c, const char *host, const char *port,
     return 0;
 }
 
-/* Build HTTP request string. */
-static char *build_request(const char *method, const char *host,
-                           const char *path, const char *body,
-                           const char **headers, int num_headers) {
-    size_t cap = 4096 + (body ? strlen(body) : 0);
-    char *req = malloc(cap);
-    int off = snprintf(req, cap, "%s %s HTTP/1.1\r\nHost: %s\r\n", method, path, host);
+/* Buffers small writes into full TLS records. Pieces at least a record
+ * long are passed to mbedtls as they are, without an extra copy. */
+typedef struct {
+    mbedtls_ssl_context *ssl;
+    unsigned char buf[MBEDTLS_SSL_OUT_CONTENT_LEN];
+    size_t len;
+    bool   ok;
+} TlsWriter;
+
+/* mbedtls_ssl_write() sends at most one record per call; loop for the rest. */
+static bool ssl_write_all(mbedtls_ssl_context *ssl, const unsigned char *p, size_t len) {
+    while (len) {
+        int n = mbedtls_ssl_write(ssl, p, len);
+        if (n == MBEDTLS_ERR_SSL_WANT_READ || n == MBEDTLS_ERR_SSL_WANT_WRITE) continue;
+        if (n < 0) {
+            char errbuf[128];
+            mbedtls_strerror(n, errbuf, sizeof(errbuf));
+            LOG_ERROR("TLS write failed: %s", errbuf);
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static void tw_flush(TlsWriter *w) {
+    if (w->ok && w->len) w->ok = ssl_write_all(w->ssl, w->buf, w->len);
+    w->len = 0;
+}
 
+static void tw_write(TlsWriter *w, const void *data, size_t len) {
+    const unsigned char *p = data;
+    size_t room = sizeof(w->buf) - w->len;
+    if (len < room) {
+        memcpy(w->buf + w->len, p, len);
+        w->len += len;
+        return;
+    }
+    memcpy(w->buf + w->len, p, room);  /* Top up the pending record */
+    w->len += room;
+    p += room;
+    len -= room;
+    tw_flush(w);
+    size_t direct = len - len % sizeof(w->buf);
+    if (w->ok && direct) w->ok = ssl_write_all(w->ssl, p, direct);
+    memcpy(w->buf, p + direct, len - direct);
+    w->len = len - direct;
+}
+
+/* Send the request head, then the body segments (NULL = no body) in order
+ * without joining them. */
+static bool send_request(mbedtls_ssl_context *ssl, const char *method,
+                         const char *host, const char *path,
+                         const struct iovec *body, int nbody,
+                         const char **headers, int num_headers) {
+    TlsWriter w;
+    w.ssl = ssl;
+    w.len = 0;
+    w.ok = true;
+
+    char line[2048];
+    int n = snprintf(line, sizeof(line), "%s %s HTTP/1.1\r\nHost: %s\r\n", method, path, host);
+    tw_write(&w, line, (size_t)n);
     for (int i = 0; i < num_headers * 2; i += 2) {
-        off += snprintf(req + off, cap - (size_t)off, "%s: %s\r\n", headers[i], headers[i+1]);
+        n = snprintf(line, sizeof(line), "%s: %s\r\n", headers[i], headers[i+1]);
+        tw_write(&w, line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
     }
 
     if (body) {
-        off += snprintf(req + off, cap - (size_t)off,
-                        "Content-Length: %zu\r\nContent-Type: application/json\r\n\r\n%s",
-                        strlen(body), body);
+        size_t len = 0;
+        for (int i = 0; i < nbody; i++) len += body[i].iov_len;
+        n = snprintf(line, sizeof(line),
+                     "Content-Length: %zu\r\nContent-Type: application/json\r\n\r\n", len);
+        tw_write(&w, line, (size_t)n);
+        for (int i = 0; i < nbody; i++) tw_write(&w, body[i].iov_base, body[i].iov_len);
     } else {
-        off += snprintf(req + off, cap - (size_t)off, "\r\n");
+        tw_write(&w, "\r\n", 2);
     }
-    (void)off;
-    return req;
+    tw_flush(&w);
+    return w.ok;
 }
 
-/* Read full HTTP response (non-streaming). */
-static HttpResponse read_response(mbedtls_ssl_context *ssl) {
+/* Read full HTTP response (non-streaming). It's read straight into one
+ * buffer from `a` (NULL = the buffer pool), and the body moved to its
+ * start. */
+static HttpResponse read_response(mbedtls_ssl_context *ssl, Arena *a) {
     HttpResponse resp = {0};
-    char buf[8192];
     char *raw = NULL;
     size_t raw_len = 0, raw_cap = 0;
 
     for (;;) {
-        int n = mbedtls_ssl_read(ssl, (unsigned char *)buf, sizeof(buf));
+        if (raw_cap - raw_len < 8192) {
+            size_t cap = raw_cap ? raw_cap * 2 : READ_BUF;
+            char *p;
+            if (a) {
+                p = arena_realloc(a, raw, raw_cap, cap);
+            } else if ((p = pool_get(cap, &cap))) {
+                if (raw) memcpy(p, raw, raw_len);
+                pool_put(raw, raw_cap);
+            }
+            if (!p) break;
+            raw = p;
+            raw_cap = cap;
+        }
+        int n = mbedtls_ssl_read(ssl, (unsigned char *)raw + raw_len, raw_cap - raw_len - 1);
         if (n == MBEDTLS_ERR_SSL_WANT_READ) continue;
         if (n <= 0) break;
-
-        if (raw_len + (size_t)n > raw_cap) {
-            raw_cap = (raw_cap + (size_t)n) * 2;
-            raw = realloc(raw, raw_cap);
-        }
-        memcpy(raw + raw_len, buf, (size_t)n);
         raw_len += (size_t)n;
     }
 
     if (!raw) return resp;
+    raw[raw_len] = '\0';
 
     /* Parse status line */
     char *body_start = strstr(raw, "\r\n\r\n");
@@ -166,17 +242,24 @@ static HttpResponse read_response(mbedtls_ssl_context *ssl) {
         if (sp) resp.status = atoi(sp + 1);
 
         resp.body_len = raw_len - (size_t)(body_start - raw);
-        resp.body = malloc(resp.body_len + 1);
-        memcpy(resp.body, body_start, resp.body_len);
-        resp.body[resp.body_len] = '\0';
+        memmove(raw, body_start, resp.body_len + 1);
+        resp.body = raw;
+        if (!a) resp.body_cap = raw_cap;
+    } else if (!a) {
+        pool_put(raw, raw_cap);
     }
-
-    free(raw);
     return resp;
 }
 
 HttpResponse http_post_json(HttpClient *c, const char *url, const char *body,
                             const char **headers, int num_headers) {
+    struct iovec iov = { (void *)body, strlen(body) };
+    return http_post_json_iov(c, NULL, url, &iov, 1, headers, num_headers);
+}
+
+HttpResponse http_post_json_iov(HttpClient *c, Arena *a, const char *url,
+                                const struct iovec *body, int nbody,
+                                const char **headers, int num_headers) {
     HttpResponse resp = {0};
     char host[256], port[8], path[1024];
     if (parse_url(url, host, sizeof(host), port, sizeof(port), path, sizeof(path))) {
@@ -188,11 +271,8 @@ HttpResponse http_post_json(HttpClient *c, const char *url, const char *body,
     mbedtls_ssl_context ssl;
     if (tls_connect(c, host, port, &net, &ssl)) return resp;
 
-    char *req = build_request("POST", host, path, body, headers, num_headers);
-    mbedtls_ssl_write(&ssl, (unsigned char *)req, strlen(req));
-    free(req);
-
-    resp = read_response(&ssl);
+    if (send_request(&ssl, "POST", host, path, body, nbody, headers, num_headers))
+        resp = read_response(&ssl, a);
 
     mbedtls_ssl_close_notify(&ssl);
     mbedtls_ssl_free(&ssl);
@@ -211,11 +291,8 @@ HttpResponse http_get(HttpClient *c, const char *url,
     mbedtls_ssl_context ssl;
     if (tls_connect(c, host, port, &net, &ssl)) return resp;
 
-    char *req = build_request("GET", host, path, NULL, headers, num_headers);
-    mbedtls_ssl_write(&ssl, (unsigned char *)req, strlen(req));
-    free(req);
-
-    resp = read_response(&ssl);
+    if (send_request(&ssl, "GET", host, path, NULL, 0, headers, num_headers))
+        resp = read_response(&ssl, NULL);
 
     mbedtls_ssl_close_notify(&ssl);
     mbedtls_ssl_free(&ssl);
@@ -227,6 +304,17 @@ HttpResponse http_get(HttpClient *c, const char *url,
 int http_post_stream(HttpClient *c, const char *url, const char *body,
                      const char **headers, int num_headers,
                      HttpStreamCb cb, void *userdata) {
+    struct iovec iov = { (void *)body, strlen(body) };
+    return http_post_stream_iov(c, url, &iov, 1, headers, num_headers, cb, userdata);
+}
+
+int http_post_stream_iov(HttpClient *c, const char *url,
+                         const struct iovec *body, int nbody,
+                         const char **headers, int num_headers,
+                         HttpStreamCb cb, void *userdata) {
+    int rc = 0;
+    char *buf = NULL;
+    size_t cap = 0;
     char host[256], port[8], path[1024];
     if (parse_url(url, host, sizeof(host), port, sizeof(port), path, sizeof(path))) return -1;
 
@@ -234,76 +322,89 @@ int http_post_stream(HttpClient *c, const char *url, const char *body,
     mbedtls_ssl_context ssl;
     if (tls_connect(c, host, port, &net, &ssl)) return -1;
 
-    char *req = build_request("POST", host, path, body, headers, num_headers);
-    mbedtls_ssl_write(&ssl, (unsigned char *)req, strlen(req));
-    free(req);
-
-    /* Read headers first */
-    char hdr_buf[4096];
-    size_t hdr_len = 0;
-    bool headers_done = false;
-
-    while (!headers_done) {
-        int n = mbedtls_ssl_read(&ssl, (unsigned char *)hdr_buf + hdr_len, sizeof(hdr_buf) - hdr_len);
-        if (n <= 0) break;
-        hdr_len += (size_t)n;
-        if (strstr(hdr_buf, "\r\n\r\n")) headers_done = true;
+    if (!send_request(&ssl, "POST", host, path, body, nbody, headers, num_headers)) {
+        rc = -1;
+        goto done;
     }
 
-    /* Stream SSE data: lines */
-    char line_buf[16384];
-    size_t line_len = 0;
-
-    /* Check if we have leftover data after headers */
-    char *body_start = strstr(hdr_buf, "\r\n\r\n");
-    if (body_start) {
-        body_start += 4;
-        size_t leftover = hdr_len - (size_t)(body_start - hdr_buf);
-        if (leftover > 0) {
-            memcpy(line_buf, body_start, leftover);
-            line_len = leftover;
-        }
+    /* Headers, then SSE lines, are read into one pooled buffer: buf[pos,
+     * len) is unprocessed. It's compacted once per read, and grows when a
+     * line doesn't fit. */
+    size_t len = 0, pos = 0;
+    bool in_body = false;
+    buf = pool_get(READ_BUF, &cap);
+    if (!buf) {
+        rc = -1;
+        goto done;
     }
 
     for (;;) {
+        if (!in_body) {
+            char *end = memmem(buf, len, "\r\n\r\n", 4);
+            if (end) {
+                in_body = true;
+                pos = (size_t)(end - buf) + 4;
+            }
+        }
+
         /* Process complete lines */
         char *nl;
-        while ((nl = memchr(line_buf, '\n', line_len)) != NULL) {
-            size_t llen = (size_t)(nl - line_buf);
+        while (in_body && (nl = memchr(buf + pos, '\n', len - pos)) != NULL) {
+            char *line = buf + pos;
+            size_t llen = (size_t)(nl - line);
+            pos += llen + 1;
             /* Remove \r if present */
-            if (llen > 0 && line_buf[llen-1] == '\r') llen--;
-            line_buf[llen] = '\0';
+            if (llen > 0 && line[llen-1] == '\r') llen--;
+            line[llen] = '\0';
 
             /* SSE: data: prefix */
-            if (strncmp(line_buf, "data: ", 6) == 0) {
-                if (!cb(line_buf + 6, llen - 6, userdata)) {
+            if (strncmp(line, "data: ", 6) == 0) {
+                if (!cb(line + 6, llen - 6, userdata)) {
                     goto done;
                 }
             }
+        }
 
-            /* Shift buffer */
-            size_t consumed = (size_t)(nl - line_buf) + 1;
-            memmove(line_buf, nl + 1, line_len - consumed);
-            line_len -= consumed;
+        if (pos) {
+            memmove(buf, buf + pos, len - pos);
+            len -= pos;
+            pos = 0;
+        }
+        if (cap - len < 2) {
+            if (cap >= SSE_LINE_MAX) {
+                LOG_ERROR("SSE line over %d bytes, dropping the stream", SSE_LINE_MAX);
+                rc = -1;
+                break;
+            }
+            size_t grown;
+            char *p = pool_get(cap * 2, &grown);
+            if (!p) {
+                rc = -1;
+                break;
+            }
+            memcpy(p, buf, len);
+            pool_put(buf, cap);
+            buf = p;
+            cap = grown;
         }
 
-        int n = mbedtls_ssl_read(&ssl, (unsigned char *)line_buf + line_len,
-                                  sizeof(line_buf) - line_len - 1);
+        int n = mbedtls_ssl_read(&ssl, (unsigned char *)buf + len, cap - len - 1);
         if (n == MBEDTLS_ERR_SSL_WANT_READ) continue;
         if (n <= 0) break;
-        line_len += (size_t)n;
+        len += (size_t)n;
     }
 
 done:
+    pool_put(buf, cap);
     mbedtls_ssl_close_notify(&ssl);
     mbedtls_ssl_free(&ssl);
     mbedtls_net_free(&net);
 
-    return 0;
+    return rc;
 }
 
 void http_response_free(HttpResponse *r) {
-    free(r->body);
+    pool_put(r->body, r->body_cap);
     free(r->headers);
     r->body = NULL;
     r->headers = NULL;
@@ -1,8 +1,10 @@
 #ifndef CCLAW_HTTP_H
 #define CCLAW_HTTP_H
 
+#include "arena.h"
 #include <stddef.h>
 #include <stdbool.h>
+#include <sys/uio.h>
 
 typedef struct HttpClient HttpClient;
 
@@ -10,6 +12,7 @@ typedef struct {
     int  status;
     char *body;
     size_t body_len;
+    size_t body_cap;  /* Size of body's pool buffer (0 = arena) */
     char *headers;
 } HttpResponse;
 
@@ -20,7 +23,7 @@ typedef bool (*HttpStreamCb)(const char *chunk, size_t len, void *userdata);
 HttpClient *http_client_new(void);
 void http_client_free(HttpClient *c);
 
-/* POST with JSON body. Caller must free response body. */
+/* POST with JSON body. Release the response with http_response_free(). */
 HttpResponse http_post_json(HttpClient *c,
                             const char *url,
                             const char *body,
@@ -36,6 +39,18 @@ int http_post_stream(HttpClient *c,
                      HttpStreamCb cb,
                      void *userdata);
 
+/* The same, with the body given as segments that are sent back to back
+ * without being joined first. The response body comes from `a` (NULL =
+ * heap); don't http_response_free() one from an arena. */
+HttpResponse http_post_json_iov(HttpClient *c, Arena *a, const char *url,
+                                const struct iovec *body, int nbody,
+                                const char **headers, int num_headers);
+
+int http_post_stream_iov(HttpClient *c, const char *url,
+                         const struct iovec *body, int nbody,
+                         const char **headers, int num_headers,
+                         HttpStreamCb cb, void *userdata);
+
 /* Simple GET. */
 HttpResponse http_get(HttpClient *c, const char *url,
                       const char **headers, int num_headers);
@@ -1,20 +1,24 @@
 #include "log.h"
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <time.h>
 #include <string.h>
 
-static LogLevel g_level = LOG_INFO;
+#define MEM_TAG MEM_OTHER
+#include "mem.h"
+
+static atomic_int g_level = LOG_INFO;  /* Changed by config reloads */
 static FILE    *g_fp    = NULL;
 
 static const char *level_names[] = {
     "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"
 };
 
-void log_set_level(LogLevel level) { g_level = level; }
+void log_set_level(LogLevel level) { atomic_store_explicit(&g_level, level, memory_order_relaxed); }
 void log_set_file(FILE *fp)       { g_fp = fp; }
 
 void cc_log(LogLevel level, const char *file, int line, const char *fmt, ...) {
-    if (level < g_level) return;
+    if ((int)level < atomic_load_explicit(&g_level, memory_order_relaxed)) return;
     FILE *out = g_fp ? g_fp : stderr;
 
     time_t now = time(NULL);
@@ -18,19 +18,31 @@
 #include "provider.h"
 #include "provider_openai.h"
 #include "tools.h"
+#include "tool_shell.h"
+#include "tool_file.h"
+#include "tool_timer.h"
+#include "file_cache.h"
+#include "sandbox.h"
 #include "session.h"
 #include "telegram.h"
 #include "memory.h"
 #include "ws.h"
 #include "cron.h"
+#include "timer.h"
 #include "log.h"
 #include "arena.h"
+#include "pool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#define MEM_TAG MEM_OTHER
+#include "mem.h"
 
 #define VERSION "0.1.0"
 
@@ -41,6 +53,11 @@ static void sigint_handler(int sig) {
     g_running = 0;
 }
 
+static void sighup_handler(int sig) {
+    (void)sig;
+    config_reload_request();
+}
+
 /* Print streaming text to stdout. */
 static bool print_stream(const char *delta, void *ud) {
     (void)ud;
@@ -49,55 +66,65 @@ static bool print_stream(const char *delta, void *ud) {
     return g_running != 0;
 }
 
-/* Agent context for message handling */
+/* Agent context for message handling. Settings that can be reloaded come
+ * from config_acquire() instead. */
 typedef struct {
-    CClawConfig *cfg;
+    const char  *workspace;
     HttpClient  *http;
-    char        *system_prompt;
     char        *tools_json;
 } AgentCtx;
 
-/* Run one agent turn: send message, handle tool calls, return final text. */
-static char *agent_turn(AgentCtx *ctx, Session *session, const char *user_msg, bool stream) {
+/* Run one agent turn: send message, handle tool calls, return final text.
+ * Tool output is forwarded live to `on_tool` (may be NULL). */
+static char *agent_turn(AgentCtx *ctx, Session *session, const char *user_msg, bool stream,
+                        ToolChunkFn on_tool, void *tool_ud) {
     session_add_user(session, user_msg);
 
     int max_turns = 10;
     char *final_text = NULL;
+    const CClawConfig *cfg = config_acquire();  /* The whole turn uses one model */
+
+    /* Each round's request, response and tool scratch live in this
+     * thread's arena and are dropped together when the round ends. */
+    Arena *scratch = arena_thread();
+    ArenaMark mark = arena_save(scratch);
 
     for (int turn = 0; turn < max_turns; turn++) {
-        char *msgs_json = session_messages_json(session);
+        char *msgs_json = session_messages_json(session, scratch);
+        const WsPrompt *prompt = ws_prompt_acquire();  /* Picks up edited identity files */
+        SystemPrompt system_prompt = { prompt ? prompt->json : NULL, prompt ? prompt->json_len : 0 };
 
         ChatResponse resp;
-        bool is_openai = !strcmp(ctx->cfg->provider, "openai");
+        bool is_openai = !strcmp(cfg->provider, "openai");
 
         if (is_openai) {
             if (stream) {
-                resp = openai_chat_stream(ctx->http, ctx->cfg->api_key,
-                                          ctx->cfg->model, ctx->system_prompt,
+                resp = openai_chat_stream(ctx->http, scratch, cfg->api_key,
+                                          cfg->model, system_prompt,
                                           msgs_json, ctx->tools_json,
-                                          ctx->cfg->temperature,
+                                          cfg->temperature,
                                           print_stream, NULL);
             } else {
-                resp = openai_chat(ctx->http, ctx->cfg->api_key,
-                                   ctx->cfg->model, ctx->system_prompt,
+                resp = openai_chat(ctx->http, scratch, cfg->api_key,
+                                   cfg->model, system_prompt,
                                    msgs_json, ctx->tools_json,
-                                   ctx->cfg->temperature);
+                                   cfg->temperature);
             }
         } else {
             if (stream) {
-                resp = provider_chat_stream(ctx->http, ctx->cfg->api_key,
-                                            ctx->cfg->model, ctx->system_prompt,
+                resp = provider_chat_stream(ctx->http, scratch, cfg->api_key,
+                                            cfg->model, system_prompt,
                                             msgs_json, ctx->tools_json,
-                                            ctx->cfg->temperature,
+                                            cfg->temperature,
                                             print_stream, NULL);
             } else {
-                resp = provider_chat(ctx->http, ctx->cfg->api_key,
-                                     ctx->cfg->model, ctx->system_prompt,
+                resp = provider_chat(ctx->http, scratch, cfg->api_key,
+                                     cfg->model, system_prompt,
                                      msgs_json, ctx->tools_json,
-                                     ctx->cfg->temperature);
+                                     cfg->temperature);
             }
         }
-        free(msgs_json);
+        ws_prompt_release(prompt);
 
         LOG_DEBUG("API: %d in, %d out tokens, stop=%s, tools=%d",
                   resp.input_tokens, resp.output_tokens,
@@ -113,9 +140,15 @@ static char *agent_turn(AgentCtx *ctx, Session *session, const char *user_msg, b
                                      resp.tool_calls[i].input_json);
 
                 /* Execute tool */
+                ToolCtx tctx = {
+                    .session = session->id,
+                    .on_chunk = on_tool,
+                    .userdata = tool_ud,
+                    .arena = scratch,
+                };
                 ToolExecResult tr = tool_execute(resp.tool_calls[i].name,
                                                  resp.tool_calls[i].input_json,
-                                                 ctx->cfg->workspace);
+                                                 ctx->workspace, &tctx);
 
                 LOG_DEBUG("Tool %s: %s (%zu bytes)",
                           resp.tool_calls[i].name,
@@ -133,7 +166,7 @@ static char *agent_turn(AgentCtx *ctx, Session *session, const char *user_msg, b
                 final_text = strdup(resp.text);
             }
 
-            chat_response_free(&resp);
+            arena_restore(scratch, mark);
             continue; /* Next turn — let LLM process tool results */
         }
 
@@ -144,14 +177,252 @@ static char *agent_turn(AgentCtx *ctx, Session *session, const char *user_msg, b
             final_text = strdup(resp.text);
         }
 
-        chat_response_free(&resp);
         break;
     }
 
+    arena_restore(scratch, mark);
+    config_release(cfg);
     session_save(session);
     return final_text;
 }
 
+/* Live tool output for the terminal: stdout dimmed, stderr in red.
+ * Ctrl-C cancels the running command. */
+static bool cli_tool_output(const char *tool, ToolStream stream,
+                            const char *data, size_t len, void *ud) {
+    (void)tool;
+    (void)ud;
+    if (stream == TOOL_DONE) return true;
+    FILE *out = stream == TOOL_STDERR ? stderr : stdout;
+    fputs(stream == TOOL_STDERR ? "\033[31m" : "\033[2m", out);
+    fwrite(data, 1, len, out);
+    fputs("\033[0m", out);
+    fflush(out);
+    return g_running != 0;
+}
+
+/* Copy `len` bytes as a string, replacing bytes that aren't valid UTF-8
+ * with '?' (WebSocket text frames and Telegram both require UTF-8). */
+static char *utf8_sanitize(const char *data, size_t len) {
+    char *s = malloc(len + 1);
+    const unsigned char *p = (const unsigned char *)data;
+    size_t i = 0;
+    while (i < len) {
+        size_t n = p[i] < 0x80 ? 1 : (p[i] & 0xE0) == 0xC0 ? 2 :
+                   (p[i] & 0xF0) == 0xE0 ? 3 : (p[i] & 0xF8) == 0xF0 ? 4 : 0;
+        bool ok = n > 0 && i + n <= len && !(n == 1 && p[i] == 0);
+        for (size_t k = 1; ok && k < n; k++) ok = (p[i + k] & 0xC0) == 0x80;
+        if (ok) {
+            memcpy(s + i, p + i, n);
+            i += n;
+        } else {
+            s[i++] = '?';
+        }
+    }
+    s[len] = '\0';
+    return s;
+}
+
+/* Bytes at the end of `data` that start a multibyte character the chunk
+ * cut short (0-3). */
+static size_t utf8_partial_tail(const char *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t k = 1; k <= 3 && k <= len; k++) {
+        unsigned char c = p[len - k];
+        if ((c & 0xC0) == 0x80) continue;
+        size_t n = (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 1;
+        return n > k ? k : 0;
+    }
+    return 0;
+}
+
+/* Tool output arrives in arbitrary chunks (4 KB pipe reads), which can end
+ * in the middle of a character. Rather than sanitize both halves into '?',
+ * each stream's cut-off tail is held back and prepended to its next chunk. */
+typedef struct {
+    char   tail[2][3];   /* [0] stdout, [1] stderr */
+    size_t len[2];
+} Utf8Carry;
+
+/* `data` with the carried bytes of `stream` in front and its own partial
+ * tail carried over instead. Caller frees; *out_len is the length. */
+static char *utf8_carry(Utf8Carry *c, ToolStream stream, const char *data, size_t len,
+                        size_t *out_len) {
+    int k = stream == TOOL_STDERR;
+    size_t n = c->len[k] + len;
+    char *buf = malloc(n + 1);
+    memcpy(buf, c->tail[k], c->len[k]);
+    memcpy(buf + c->len[k], data, len);
+    c->len[k] = utf8_partial_tail(buf, n);
+    memcpy(c->tail[k], buf + n - c->len[k], c->len[k]);
+    *out_len = n - c->len[k];
+    return buf;
+}
+
+/* Live tool output for a WebSocket client, as JSON frames:
+ *   {"type":"tool_output","tool":"shell","stream":"stdout","data":"..."}
+ *   {"type":"tool_done","tool":"shell"}
+ * The final reply still arrives as a plain text frame. */
+typedef struct {
+    int       client_fd;
+    Utf8Carry carry;
+} WsToolStream;
+
+static bool ws_send_frame(int client_fd, const char *tool, ToolStream stream,
+                          const char *data, size_t len) {
+    cJSON *msg = cJSON_CreateObject();
+    cJSON_AddStringToObject(msg, "type", stream == TOOL_DONE ? "tool_done" : "tool_output");
+    cJSON_AddStringToObject(msg, "tool", tool);
+    if (stream != TOOL_DONE) {
+        char *text = utf8_sanitize(data, len);
+        cJSON_AddStringToObject(msg, "stream", stream == TOOL_STDERR ? "stderr" : "stdout");
+        cJSON_AddStringToObject(msg, "data", text);
+        free(text);
+    }
+    char *json = cJSON_PrintUnformatted(msg);
+    cJSON_Delete(msg);
+    bool ok = json && ws_send_text(client_fd, json, strlen(json)) == 0;
+    free(json);
+    return ok;
+}
+
+static bool ws_tool_output(const char *tool, ToolStream stream,
+                           const char *data, size_t len, void *ud) {
+    WsToolStream *ws = ud;
+    if (stream == TOOL_DONE) {  /* A character still cut short is invalid: send it as '?' */
+        for (int k = 0; k < 2; k++) {
+            if (ws->carry.len[k])
+                ws_send_frame(ws->client_fd, tool, k ? TOOL_STDERR : TOOL_STDOUT,
+                              ws->carry.tail[k], ws->carry.len[k]);
+            ws->carry.len[k] = 0;
+        }
+        return ws_send_frame(ws->client_fd, tool, TOOL_DONE, NULL, 0);
+    }
+    size_t n;
+    char *text = utf8_carry(&ws->carry, stream, data, len, &n);
+    bool ok = !n || ws_send_frame(ws->client_fd, tool, stream, text, n);
+    free(text);
+    return ok;  /* Client gone — stop the command */
+}
+
+/* Live tool output for a Telegram chat. The Bot API allows about one
+ * message per second per chat, so output is batched and sent at most
+ * every TG_STREAM_SECS, or when a batch fills a message. Output that
+ * then goes quiet is sent by tg_flush_run() rather than waiting for the
+ * next chunk. */
+#define TG_STREAM_SECS 3
+#define TG_STREAM_MAX  3500  /* Under Telegram's 4096-character limit */
+
+typedef struct {
+    AgentCtx *agent;
+    long long chat_id;
+    char      buf[TG_STREAM_MAX + 1];
+    size_t    len;
+    time_t    last_sent;
+    bool      sending;   /* A batch is on its way; later ones wait */
+    Utf8Carry carry;
+} TgToolStream;
+
+/* The stream of the turn running now (Telegram messages are handled one
+ * at a time), shared with the flush thread. Guards the stream's fields;
+ * it is not held across a send. */
+static pthread_mutex_t g_tg_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  g_tg_cond = PTHREAD_COND_INITIALIZER;
+static TgToolStream   *g_tg_live;
+static bool            g_tg_stop;
+
+static HttpClient *worker_http(void);
+
+/* Send the batch. Caller holds g_tg_lock, which is released for the
+ * Bot API call so a slow send doesn't stall the other side; batches
+ * still go out one at a time, in order. */
+static void tg_stream_flush(TgToolStream *ts, HttpClient *http) {
+    while (ts->sending) pthread_cond_wait(&g_tg_cond, &g_tg_lock);
+    if (!ts->len) return;
+    char *text = utf8_sanitize(ts->buf, ts->len);
+    long long chat_id = ts->chat_id;
+    ts->len = 0;
+    ts->sending = true;
+    pthread_mutex_unlock(&g_tg_lock);
+
+    const CClawConfig *cfg = config_acquire();
+    telegram_send_plain(http, cfg->telegram_token, chat_id, text);
+    config_release(cfg);
+    free(text);
+
+    pthread_mutex_lock(&g_tg_lock);
+    ts->sending = false;
+    ts->last_sent = time(NULL);
+    pthread_cond_broadcast(&g_tg_cond);
+}
+
+/* Append complete characters to the batch, sending each full message.
+ * Caller holds g_tg_lock. */
+static void tg_stream_add(TgToolStream *ts, const char *data, size_t len) {
+    while (len > 0) {
+        size_t take = TG_STREAM_MAX - ts->len;
+        if (take >= len) take = len;
+        else for (int k = 0; k < 3 && take > 0 && (data[take] & 0xC0) == 0x80; k++) take--;
+        memcpy(ts->buf + ts->len, data, take);
+        ts->len += take;
+        data += take;
+        len -= take;
+        if (len > 0) tg_stream_flush(ts, ts->agent->http);
+    }
+}
+
+static bool tg_tool_output(const char *tool, ToolStream stream,
+                           const char *data, size_t len, void *ud) {
+    TgToolStream *ts = ud;
+    (void)tool;
+    pthread_mutex_lock(&g_tg_lock);
+    if (stream == TOOL_DONE) {
+        for (int k = 0; k < 2; k++) {
+            tg_stream_add(ts, ts->carry.tail[k], ts->carry.len[k]);
+            ts->carry.len[k] = 0;
+        }
+        tg_stream_flush(ts, ts->agent->http);
+    } else {
+        size_t n;
+        char *text = utf8_carry(&ts->carry, stream, data, len, &n);
+        tg_stream_add(ts, text, n);
+        free(text);
+        if (time(NULL) - ts->last_sent >= TG_STREAM_SECS) tg_stream_flush(ts, ts->agent->http);
+    }
+    pthread_mutex_unlock(&g_tg_lock);
+    return true;
+}
+
+/* Send batches the running tool left waiting once TG_STREAM_SECS have
+ * passed. Runs beside the Telegram poll loop, with its own HTTP client. */
+static void *tg_flush_run(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_tg_lock);
+    while (!g_tg_stop) {
+        TgToolStream *ts = g_tg_live;
+        if (!ts) {
+            pthread_cond_wait(&g_tg_cond, &g_tg_lock);
+            continue;
+        }
+        if (ts->sending) {
+            pthread_cond_wait(&g_tg_cond, &g_tg_lock);
+            continue;
+        }
+        time_t due = ts->last_sent + TG_STREAM_SECS;
+        if (ts->len && time(NULL) >= due) {
+            HttpClient *http = worker_http();
+            if (http) tg_stream_flush(ts, http);
+            continue;
+        }
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += ts->len ? (due > time(NULL) ? due - time(NULL) : 0) : 1;
+        pthread_cond_timedwait(&g_tg_cond, &g_tg_lock, &until);
+    }
+    pthread_mutex_unlock(&g_tg_lock);
+    return NULL;
+}
+
 /* Telegram message handler */
 static char *telegram_handler(const TelegramMessage *msg, void *userdata) {
     AgentCtx *ctx = userdata;
@@ -159,19 +430,141 @@ static char *telegram_handler(const TelegramMessage *msg, void *userdata) {
     /* Per-chat session */
     char session_id[64];
     snprintf(session_id, sizeof(session_id), "tg_%lld", msg->chat_id);
-    Session *session = session_new(ctx->cfg->workspace, session_id);
-
-    char *reply = agent_turn(ctx, session, msg->text, false);
+    Session *session = session_new(ctx->workspace, session_id);
+
+    TgToolStream ts = { .agent = ctx, .chat_id = msg->chat_id };
+    const CClawConfig *cfg = config_acquire();
+    bool live = cfg->stream_tool_output;
+    config_release(cfg);
+    if (live) {
+        pthread_mutex_lock(&g_tg_lock);
+        g_tg_live = &ts;
+        pthread_cond_signal(&g_tg_cond);
+        pthread_mutex_unlock(&g_tg_lock);
+    }
+    char *reply = agent_turn(ctx, session, msg->text, false,
+                             live ? tg_tool_output : NULL, &ts);
+    if (live) {
+        pthread_mutex_lock(&g_tg_lock);
+        while (ts.sending) pthread_cond_wait(&g_tg_cond, &g_tg_lock);  /* ts is on our stack */
+        g_tg_live = NULL;
+        pthread_mutex_unlock(&g_tg_lock);
+    }
     session_free(session);
 
     return reply;
 }
 
+/* Context for a file-defined cron job. */
+typedef struct {
+    AgentCtx *agent;
+    CronTask *task;
+} CronJobCtx;
+
+/* Cron jobs and timers run on their own worker threads, and the TLS
+ * client's RNG isn't safe to share between threads, so each of those
+ * threads lazily gets its own client. */
+static pthread_key_t  cron_http_key;
+static pthread_once_t cron_http_once = PTHREAD_ONCE_INIT;
+
+static void cron_http_free(void *http) {
+    http_client_free(http);
+}
+
+static void cron_http_key_init(void) {
+    pthread_key_create(&cron_http_key, cron_http_free);
+}
+
+static HttpClient *worker_http(void) {
+    pthread_once(&cron_http_once, cron_http_key_init);
+    HttpClient *http = pthread_getspecific(cron_http_key);
+    if (!http) {
+        http = http_client_new();
+        pthread_setspecific(cron_http_key, http);
+    }
+    return http;
+}
+
+/* Cron callback — runs one agent turn with the task's prompt and session. */
+static void cron_agent_job(void *userdata) {
+    CronJobCtx *jc = userdata;
+    CronTask *task = jc->task;
+    const char *workspace = jc->agent->workspace;
+
+    AgentCtx agent = *jc->agent;
+    agent.http = worker_http();
+    if (!agent.http) {
+        LOG_ERROR("cron: job '%s' has no HTTP client", task->name);
+        return;
+    }
+
+    Arena *scratch = arena_thread();
+    ArenaMark mark = arena_save(scratch);
+    const char *prompt = task->prompt;
+    if (task->prompt_file[0]) {
+        char *content = ws_read_file(scratch, workspace, task->prompt_file);
+        if (content && content[0]) prompt = content;
+        else LOG_WARN("cron: job '%s' cannot read %s", task->name, task->prompt_file);
+    }
+    if (!prompt) {
+        arena_restore(scratch, mark);
+        return;
+    }
+
+    LOG_INFO("cron: running job '%s' in session %s", task->name, task->session);
+    Session *session = session_new(workspace, task->session);
+    char *reply = agent_turn(&agent, session, prompt, false, NULL, NULL);
+    LOG_INFO("cron: job '%s' done (%zu bytes)", task->name, reply ? strlen(reply) : 0);
+
+    free(reply);
+    session_free(session);
+    arena_restore(scratch, mark);
+}
+
+/* Timer callback for kind "agent" (the remind tool) — payload is
+ * "<session>\n<prompt>". The reply goes back to the session's chat. */
+static void timer_agent_job(uint64_t id, const char *payload, void *userdata) {
+    AgentCtx *ctx = userdata;
+    const char *nl = strchr(payload, '\n');
+    if (!nl || nl == payload) {
+        LOG_WARN("timer %llu: malformed payload", (unsigned long long)id);
+        return;
+    }
+
+    char session_id[64];
+    snprintf(session_id, sizeof(session_id), "%.*s", (int)(nl - payload), payload);
+
+    AgentCtx agent = *ctx;
+    agent.http = worker_http();
+    if (!agent.http) {
+        LOG_ERROR("timer %llu: no HTTP client", (unsigned long long)id);
+        return;
+    }
+
+    LOG_INFO("timer %llu: running in session %s", (unsigned long long)id, session_id);
+    Session *session = session_new(ctx->workspace, session_id);
+    char *reply = agent_turn(&agent, session, nl + 1, false, NULL, NULL);
+    session_free(session);
+
+    /* A gateway client may be gone by now and its fd reused, so a
+     * ws_ session's reply stays in its history only. */
+    long long chat_id;
+    if (reply && reply[0] && sscanf(session_id, "tg_%lld", &chat_id) == 1) {
+        const CClawConfig *cfg = config_acquire();
+        if (cfg->telegram_token[0]) telegram_send(agent.http, cfg->telegram_token, chat_id, reply);
+        config_release(cfg);
+    } else if (reply && reply[0] && !strcmp(session_id, "cli")) {
+        printf("\n\033[1;33mcclaw (reminder)>\033[0m %s\n\n", reply);
+        fflush(stdout);
+    }
+    free(reply);
+}
+
 /* Interactive CLI mode */
 static void cli_mode(AgentCtx *ctx) {
-    Session *session = session_new(ctx->cfg->workspace, "cli");
+    Session *session = session_new(ctx->workspace, "cli");
 
-    printf("CClaw v%s — type /quit to exit\n\n", VERSION);
+    printf("CClaw v%s — type /quit to exit, /mem for memory use, /reload to re-read the config\n\n", VERSION);
 
     char input[4096];
     while (g_running) {
@@ -186,11 +579,20 @@ static void cli_mode(AgentCtx *ctx) {
         if (len == 0) continue;
 
         if (!strcmp(input, "/quit") || !strcmp(input, "/exit")) break;
+        if (!strcmp(input, "/mem")) {
+            mem_stats_dump(stdout);
+            continue;
+        }
+        if (!strcmp(input, "/reload")) {
+            int r = config_reload();
+            printf("%s\n", r > 0 ? "Config reloaded." : r == 0 ? "Config unchanged." : "Config not reloaded.");
+            continue;
+        }
 
         printf("\033[1;33mcclaw>\033[0m ");
         fflush(stdout);
 
-        char *reply = agent_turn(ctx, session, input, true);
+        char *reply = agent_turn(ctx, session, input, true, cli_tool_output, NULL);
         printf("\n\n");
 
         free(reply);
@@ -199,6 +601,11 @@ static void cli_mode(AgentCtx *ctx) {
     session_free(session);
 }
 
+/* The prompt names the model, so it follows a reload. */
+static void on_config_reload(const CClawConfig *old, const CClawConfig *cfg) {
+    if (strcmp(old->model, cfg->model)) ws_prompt_set_model(cfg->model);
+}
+
 static void print_usage(void) {
     printf("CClaw v%s — OpenClaw in C\n\n", VERSION);
     printf("Usage:\n");
@@ -214,9 +621,11 @@ static void print_usage(void) {
 int main(int argc, char **argv) {
     signal(SIGINT, sigint_handler);
     signal(SIGTERM, sigint_handler);
+    arena_json_hooks();
 
-    CClawConfig cfg;
-    config_defaults(&cfg);
+    /* Defaults and command-line options; a reload starts again from here */
+    CClawConfig base;
+    config_defaults(&base);
 
     char *config_path = NULL;
     char *one_shot = NULL;
@@ -235,45 +644,73 @@ int main(int argc, char **argv) {
         if (!strcmp(argv[i], "--config") && i + 1 < argc)
             config_path = argv[++i];
         else if (!strcmp(argv[i], "--workspace") && i + 1 < argc)
-            strncpy(cfg.workspace, argv[++i], sizeof(cfg.workspace) - 1);
+            strncpy(base.workspace, argv[++i], sizeof(base.workspace) - 1);
         else if (!strcmp(argv[i], "--model") && i + 1 < argc)
-            strncpy(cfg.model, argv[++i], sizeof(cfg.model) - 1);
+            strncpy(base.model, argv[++i], sizeof(base.model) - 1);
         else if (!strcmp(argv[i], "--telegram"))
             telegram_mode = 1;
         else if (!strcmp(argv[i], "--gateway-port") && i + 1 < argc)
-            cfg.gateway_port = atoi(argv[++i]);
+            base.gateway_port = atoi(argv[++i]);
         else if (argv[i][0] != '-')
             one_shot = argv[i];
     }
 
-    /* Load config */
-    if (config_path) config_load(&cfg, config_path);
-    else {
-        /* Default config locations */
-        char path[512];
-        const char *home = getenv("HOME");
-        if (home) {
-            snprintf(path, sizeof(path), "%s/.cclaw/config", home);
-            config_load(&cfg, path);
-        }
-    }
-    config_load_env(&cfg);
-
     /* Default workspace to cwd */
-    if (!cfg.workspace[0]) {
-        getcwd(cfg.workspace, sizeof(cfg.workspace));
+    if (!base.workspace[0]) {
+        getcwd(base.workspace, sizeof(base.workspace));
     }
 
+    /* Load config */
+    CClawConfig cfg;
+    memcpy(&cfg, &base, sizeof(cfg));
+    char path[512] = "";
+    const char *home = getenv("HOME");
+    if (config_path) snprintf(path, sizeof(path), "%s", config_path);
+    else if (home) snprintf(path, sizeof(path), "%s/.cclaw/config", home);  /* Default location */
+    if (path[0] && config_load(&cfg, path) < 0) path[0] = '\0';  /* Nothing to watch */
+    config_load_env(&cfg);
+    config_init(&cfg, &base, path[0] ? path : NULL);
+
     log_set_level((LogLevel)cfg.log_level);
+    mem_track_init((MemTrack)cfg.mem_track);
 
     if (!cfg.api_key[0]) {
         fprintf(stderr, "Error: no API key. Set ANTHROPIC_API_KEY or CCLAW_API_KEY.\n");
         return 1;
     }
 
+    /* Sandbox zygote — forked while the process is still single-threaded */
+    if (cfg.shell_sandbox) {
+        SandboxConfig sb = { .network = cfg.shell_sandbox_network };
+        snprintf(sb.workspace, sizeof(sb.workspace), "%s", cfg.workspace);
+        if (!sandbox_init(&sb)) {
+            fprintf(stderr, "Error: shell_sandbox is on but the sandbox could not be set up.\n");
+            return 1;
+        }
+    }
+
+    /* Tool registry — the system prompt lists what's registered */
+    ShellLimits limits = {
+        .timeout = cfg.shell_timeout,
+        .cpu_secs = cfg.shell_cpu_limit,
+        .mem_mb = cfg.shell_mem_limit,
+        .fsize_mb = cfg.shell_fsize_limit,
+    };
+    snprintf(limits.cgroup, sizeof(limits.cgroup), "%s", cfg.shell_cgroup);
+    tool_shell_set_limits(&limits);
+    tool_shell_set_pool(cfg.shell_pool, cfg.shell_pool_idle);
+    tool_file_set_fsync(cfg.file_fsync);
+    fcache_init(cfg.file_cache_mb > 0 ? (size_t)cfg.file_cache_mb << 20 : 0);
+    tools_set_result_cache(cfg.tool_result_cache);
+    tools_init();
+
+    /* One-shot timers: the remind tool schedules them, a thread below runs them */
+    TimerWheel *timers = timer_wheel_new();
+    if (timers) tool_timer_register(timers);
+    if (cfg.tools_dir[0]) tools_load_plugins(cfg.tools_dir);
+
     /* Build system prompt */
-    Arena arena = arena_new(256 * 1024);
-    char *system_prompt = ws_build_system_prompt(&arena, cfg.workspace, cfg.model);
+    ws_prompt_init(cfg.workspace, cfg.model);
     char *tools_json = tools_get_definitions();
 
     HttpClient *http = http_client_new();
@@ -283,28 +720,84 @@ int main(int argc, char **argv) {
     }
 
     AgentCtx ctx = {
-        .cfg = &cfg,
+        .workspace = cfg.workspace,
         .http = http,
-        .system_prompt = system_prompt,
         .tools_json = tools_json,
     };
 
     config_dump(&cfg);
 
+    /* Reload on SIGHUP or when the file changes, except for a one-shot query */
+    if (!one_shot) {
+        config_on_reload(on_config_reload);
+        if (config_watch_start()) signal(SIGHUP, sighup_handler);
+    }
+
     /* Start cron scheduler in background thread */
     CronScheduler cron;
     cron_init(&cron);
     pthread_t cron_thread;
     bool cron_started = false;
 
-    /* Example: heartbeat job every 30 minutes */
-    /* Users can add jobs programmatically via cron_add() */
+    /* File-defined jobs (default <workspace>/.cclaw/cron) run agent turns */
+    char cron_path[1024], cron_db[1024];
+    if (cfg.cron_file[0]) snprintf(cron_path, sizeof(cron_path), "%s", cfg.cron_file);
+    else snprintf(cron_path, sizeof(cron_path), "%s/.cclaw/cron", cfg.workspace);
+    if (cfg.cron_db[0]) snprintf(cron_db, sizeof(cron_db), "%s", cfg.cron_db);
+    else snprintf(cron_db, sizeof(cron_db), "%s/.cclaw/cron.db", cfg.workspace);
+
+    CronTask *cron_tasks = NULL;
+    int num_cron_tasks = cron_load_tasks(cron_path, &cron_tasks);
+    CronJobCtx *cron_ctxs = NULL;
+    CronStore *cron_store = NULL;
+
+    if (num_cron_tasks > 0) {
+        cron_store = cron_store_open(cron_db);
+        if (cron_store) cron_set_store(&cron, cron_store);
+        else LOG_WARN("cron: no state DB — missed runs will not be caught up");
+
+        cron_ctxs = calloc((size_t)num_cron_tasks, sizeof(CronJobCtx));
+        for (int i = 0; i < num_cron_tasks; i++) {
+            cron_ctxs[i].agent = &ctx;
+            cron_ctxs[i].task = &cron_tasks[i];
+            if (cron_add(&cron, cron_tasks[i].name, cron_tasks[i].schedule,
+                         cron_agent_job, &cron_ctxs[i]) >= 0) {
+                cron_set_catchup(&cron, cron_tasks[i].name, cron_tasks[i].catchup);
+                int jitter = cron_tasks[i].jitter >= 0 ? cron_tasks[i].jitter : cfg.cron_jitter;
+                if (jitter > 0) cron_set_jitter(&cron, cron_tasks[i].name, jitter);
+            }
+        }
+    }
+
+    /* Cap concurrent cron turns, and with them cron-originated provider calls */
+    cron_set_concurrency(&cron, cfg.cron_max_concurrent);
+
+    /* Further jobs can be added programmatically via cron_add() */
     if (1) {
         pthread_create(&cron_thread, NULL, (void *(*)(void *))cron_run, &cron);
         cron_started = true;
         LOG_INFO("Cron scheduler started in background");
     }
 
+    /* One-shot timers (reminders) in background thread, persisted across restarts */
+    pthread_t timer_thread;
+    bool timer_started = false;
+
+    if (timers) {
+        char timer_db[1024];
+        snprintf(timer_db, sizeof(timer_db), "%s/.cclaw", cfg.workspace);
+        mkdir(timer_db, 0755);
+        snprintf(timer_db, sizeof(timer_db), "%s/.cclaw/timers.db", cfg.workspace);
+
+        timer_register(timers, TIMER_KIND_AGENT, timer_agent_job, &ctx);
+        timer_set_concurrency(timers, cfg.timer_max_concurrent);
+        if (!timer_open_store(timers, timer_db))
+            LOG_WARN("timer: no store — pending timers will not survive restarts");
+
+        pthread_create(&timer_thread, NULL, (void *(*)(void *))timer_run, timers);
+        timer_started = true;
+    }
+
     /* Start WebSocket gateway if configured */
     pthread_t ws_thread;
     bool ws_started = false;
@@ -319,9 +812,14 @@ int main(int argc, char **argv) {
 
             char session_id[64];
             snprintf(session_id, sizeof(session_id), "ws_%d", client_fd);
-            Session *session = session_new(actx->cfg->workspace, session_id);
-
-            char *reply = agent_turn(actx, session, msg, false);
+            Session *session = session_new(actx->workspace, session_id);
+
+            const CClawConfig *cfg = config_acquire();
+            bool live = cfg->stream_tool_output;
+            config_release(cfg);
+            WsToolStream stream = { .client_fd = client_fd };
+            char *reply = agent_turn(actx, session, msg, false,
+                                     live ? ws_tool_output : NULL, &stream);
             if (reply) {
                 ws_send_text(client_fd, reply, strlen(reply));
                 free(reply);
@@ -347,10 +845,21 @@ int main(int argc, char **argv) {
             return 1;
         }
         LOG_INFO("Starting Telegram bot...");
-        telegram_poll_loop(http, &cfg, telegram_handler, &ctx);
+        pthread_t tg_flush_thread;
+        bool tg_flush_started = pthread_create(&tg_flush_thread, NULL, tg_flush_run, NULL) == 0;
+        telegram_poll_loop(http, telegram_handler, &ctx);
+        if (tg_flush_started) {
+            pthread_mutex_lock(&g_tg_lock);
+            g_tg_stop = true;
+            pthread_cond_signal(&g_tg_cond);
+            pthread_mutex_unlock(&g_tg_lock);
+            pthread_join(tg_flush_thread, NULL);
+        }
     } else if (one_shot) {
         Session *session = session_new(cfg.workspace, NULL);
-        char *reply = agent_turn(&ctx, session, one_shot, true);
+        /* Only echo tool output when it can't end up in a piped answer */
+        ToolChunkFn live = isatty(STDOUT_FILENO) ? cli_tool_output : NULL;
+        char *reply = agent_turn(&ctx, session, one_shot, true, live, NULL);
         printf("\n");
         free(reply);
         session_free(session);
@@ -363,14 +872,32 @@ int main(int argc, char **argv) {
         cron_stop(&cron);
         pthread_join(cron_thread, NULL);
     }
+    cron_free(&cron);
+    if (timer_started) {
+        timer_stop(timers);
+        pthread_join(timer_thread, NULL);
+    }
+    timer_wheel_free(timers);
     if (ws_started) {
         pthread_cancel(ws_thread);
         pthread_join(ws_thread, NULL);
     }
 
+    cron_store_close(cron_store);
+    free(cron_ctxs);
+    if (num_cron_tasks > 0) cron_tasks_free(cron_tasks, num_cron_tasks);
+
     http_client_free(http);
     free(tools_json);
-    arena_free(&arena);
-
+    tools_cleanup();
+    ws_prompt_cleanup();
+    config_cleanup();
+    fcache_cleanup();
+    sandbox_cleanup();
+
+    if (mem_tracking()) mem_stats_dump(stderr);
+    arena_thread_free();
+    pool_trim();
+    if (mem_tracking() == MEM_TRACK_LEAKS) mem_leak_report(stderr);
     return 0;
 }
@@ -0,0 +1,53 @@
+#include "map_guard.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static _Thread_local const char *t_base;
+static _Thread_local size_t      t_len;
+static _Thread_local bool        t_faulted;
+static uintptr_t                 g_page;
+static pthread_once_t            g_once = PTHREAD_ONCE_INIT;
+
+static void on_sigbus(int sig, siginfo_t *si, void *uc) {
+    (void)uc;
+    const char *a = si->si_addr;
+    if (t_base && a >= t_base && a < t_base + t_len) {
+        void *page = (void *)((uintptr_t)a & ~(g_page - 1));
+        if (mmap(page, g_page, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+            t_faulted = true;
+            return;  /* The read is retried and sees zeros */
+        }
+    }
+    /* Not ours: the faulting access repeats and takes the default action */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_DFL;
+    sigaction(sig, &sa, NULL);
+}
+
+static void install(void) {
+    g_page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = on_sigbus;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGBUS, &sa, NULL);
+}
+
+void map_guard_arm(const void *addr, size_t len) {
+    pthread_once(&g_once, install);
+    t_faulted = false;
+    t_len = len;
+    t_base = addr;
+}
+
+bool map_guard_disarm(void) {
+    t_base = NULL;
+    t_len = 0;
+    return t_faulted;
+}
@@ -0,0 +1,23 @@
+#ifndef CCLAW_MAP_GUARD_H
+#define CCLAW_MAP_GUARD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Reads of mmap'd files. A file that another process truncates while we
+ * have it mapped raises SIGBUS when pages past its new end are touched,
+ * which would kill the agent. Code reading a mapping brackets the reads:
+ *
+ *     map_guard_arm(data, size);
+ *     ...read the mapping...
+ *     if (map_guard_disarm()) { ...the file shrank; discard what was read... }
+ *
+ * While armed, a SIGBUS inside [addr, addr + len) on this thread maps a
+ * zero page over the faulting page and the read carries on. Anywhere
+ * else SIGBUS keeps its default action. */
+void map_guard_arm(const void *addr, size_t len);
+
+/* Stop guarding. Returns true if a page had to be replaced. */
+bool map_guard_disarm(void);
+
+#endif
@@ -0,0 +1,390 @@
+/*
+ * Allocation tracking. Live blocks are kept in a table keyed by address,
+ * split into shards with a lock each, so a block's size and tag are
+ * found again when any module frees it. Per-tag counters are atomics.
+ */
+
+#include "mem.h"
+#include "arena.h"
+#include "pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define SHARDS     16
+#define SHARD_INIT 1024  /* Slots per shard to start; doubles at 3/4 full */
+#define LEAK_SITES 20    /* Call sites listed by mem_leak_report() */
+
+typedef struct {
+    void       *ptr;   /* NULL = empty slot */
+    size_t      size;
+    const char *file;  /* MEM_TRACK_LEAKS only */
+    int         line;
+    MemTag      tag;
+} Block;
+
+typedef struct {
+    pthread_mutex_t lock;
+    Block          *slots;
+    size_t          cap, count;
+} Shard;
+
+typedef struct {
+    atomic_size_t      in_use, peak, blocks;
+    atomic_ullong      allocs, frees;
+    atomic_ullong      hist[MEM_HIST];
+} TagStats;
+
+static MemTrack g_level;
+static Shard    g_shards[SHARDS];
+static TagStats g_tags[MEM_TAGS];
+static __thread MemTag t_json_tag = MEM_JSON;
+
+static const char *g_names[MEM_TAGS] = {
+    "other", "http", "provider", "session", "memory", "ws", "tools", "arena", "pool", "json",
+};
+
+/* Hold every shard across fork() so the child's tables aren't caught
+ * mid-update by another thread. */
+static void fork_prepare(void) {
+    for (int i = 0; i < SHARDS; i++) pthread_mutex_lock(&g_shards[i].lock);
+}
+
+static void fork_done(void) {
+    for (int i = SHARDS - 1; i >= 0; i--) pthread_mutex_unlock(&g_shards[i].lock);
+}
+
+void mem_track_init(MemTrack level) {
+    for (int i = 0; i < SHARDS; i++) pthread_mutex_init(&g_shards[i].lock, NULL);
+    if (level) pthread_atfork(fork_prepare, fork_done, fork_done);
+    g_level = level;
+}
+
+MemTrack mem_tracking(void) {
+    return g_level;
+}
+
+int mem_size_class(size_t size) {
+    int c = 0;
+    for (size_t lim = 16; c < MEM_HIST - 1 && size > lim; lim <<= 1) c++;
+    return c;
+}
+
+const char *mem_tag_name(MemTag tag) {
+    return tag < MEM_TAGS ? g_names[tag] : "?";
+}
+
+MemTag mem_json_tag(MemTag tag) {
+    MemTag prev = t_json_tag;
+    t_json_tag = tag;
+    return prev;
+}
+
+/* ── Block table ────────────────────────────────────────────── */
+
+static size_t ptr_hash(const void *p) {
+    uint64_t h = (uint64_t)(uintptr_t)p >> 4;
+    h *= 0x9E3779B97F4A7C15ull;
+    return (size_t)(h >> 32);
+}
+
+static Shard *shard_of(size_t h) {
+    return &g_shards[h % SHARDS];
+}
+
+static void stats_add(const Block *b) {
+    TagStats *t = &g_tags[b->tag];
+    size_t now = atomic_fetch_add_explicit(&t->in_use, b->size, memory_order_relaxed) + b->size;
+    size_t peak = atomic_load_explicit(&t->peak, memory_order_relaxed);
+    while (now > peak &&
+           !atomic_compare_exchange_weak_explicit(&t->peak, &peak, now,
+                                                  memory_order_relaxed, memory_order_relaxed)) {}
+    atomic_fetch_add_explicit(&t->blocks, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&t->allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&t->hist[mem_size_class(b->size)], 1, memory_order_relaxed);
+}
+
+static void stats_sub(const Block *b) {
+    TagStats *t = &g_tags[b->tag];
+    atomic_fetch_sub_explicit(&t->in_use, b->size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&t->blocks, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&t->frees, 1, memory_order_relaxed);
+}
+
+/* Slot for `p` in a shard: where it is, or the empty slot ending its run. */
+static size_t slot_find(const Shard *s, const void *p, size_t h) {
+    size_t i = (h / SHARDS) & (s->cap - 1);
+    while (s->slots[i].ptr && s->slots[i].ptr != p) i = (i + 1) & (s->cap - 1);
+    return i;
+}
+
+static bool shard_grow(Shard *s) {
+    size_t cap = s->cap ? s->cap * 2 : SHARD_INIT;
+    Block *slots = calloc(cap, sizeof(*slots));
+    if (!slots) return false;
+    Block *old = s->slots;
+    size_t old_cap = s->cap;
+    s->slots = slots;
+    s->cap = cap;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].ptr) s->slots[slot_find(s, old[i].ptr, ptr_hash(old[i].ptr))] = old[i];
+    }
+    free(old);
+    return true;
+}
+
+static void track(void *p, size_t size, MemTag tag, const char *file, int line) {
+    if (tag == MEM_JSON) tag = t_json_tag;
+    Block b = { p, size, NULL, 0, tag };
+    if (g_level == MEM_TRACK_LEAKS) {
+        b.file = file;
+        b.line = line;
+    }
+    size_t h = ptr_hash(p);
+    Shard *s = shard_of(h);
+    pthread_mutex_lock(&s->lock);
+    if ((s->count + 1) * 4 > s->cap * 3 && !shard_grow(s)) {
+        pthread_mutex_unlock(&s->lock);
+        return;
+    }
+    size_t i = slot_find(s, p, h);
+    if (s->slots[i].ptr) stats_sub(&s->slots[i]);  /* Freed untracked, and the address reused */
+    else s->count++;
+    s->slots[i] = b;
+    stats_add(&b);
+    pthread_mutex_unlock(&s->lock);
+}
+
+/* Forget `p`; *out gets its record. False if it wasn't tracked. */
+static bool untrack(const void *p, Block *out) {
+    size_t h = ptr_hash(p);
+    Shard *s = shard_of(h);
+    pthread_mutex_lock(&s->lock);
+    if (!s->cap) {
+        pthread_mutex_unlock(&s->lock);
+        return false;
+    }
+    size_t i = slot_find(s, p, h);
+    if (!s->slots[i].ptr) {
+        pthread_mutex_unlock(&s->lock);
+        return false;
+    }
+    *out = s->slots[i];
+    stats_sub(out);
+    s->count--;
+
+    /* Backward-shift the rest of the run so lookups needn't tombstones */
+    size_t mask = s->cap - 1, j = i;
+    for (;;) {
+        s->slots[i].ptr = NULL;
+        for (;;) {
+            j = (j + 1) & mask;
+            if (!s->slots[j].ptr) {
+                pthread_mutex_unlock(&s->lock);
+                return true;
+            }
+            size_t home = (ptr_hash(s->slots[j].ptr) / SHARDS) & mask;
+            /* Move it unless its home lies cyclically in (i, j] */
+            if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) break;
+        }
+        s->slots[i] = s->slots[j];
+        i = j;
+    }
+}
+
+/* ── Wrappers ───────────────────────────────────────────────── */
+
+void *mem_malloc(MemTag tag, size_t size, const char *file, int line) {
+    void *p = malloc(size);
+    if (p && g_level) track(p, size, tag, file, line);
+    return p;
+}
+
+void *mem_calloc(MemTag tag, size_t n, size_t size, const char *file, int line) {
+    void *p = calloc(n, size);
+    if (p && g_level) track(p, n * size, tag, file, line);
+    return p;
+}
+
+void *mem_realloc(MemTag tag, void *p, size_t size, const char *file, int line) {
+    if (!g_level) return realloc(p, size);
+    Block old;
+    bool had = p && untrack(p, &old);
+    void *q = realloc(p, size);
+    if (q) track(q, size, tag, file, line);
+    else if (had && size) track(p, old.size, old.tag, old.file, old.line);  /* p is still live */
+    return q;
+}
+
+char *mem_strdup(MemTag tag, const char *s, const char *file, int line) {
+    char *p = strdup(s);
+    if (p && g_level) track(p, strlen(p) + 1, tag, file, line);
+    return p;
+}
+
+char *mem_strndup(MemTag tag, const char *s, size_t n, const char *file, int line) {
+    char *p = strndup(s, n);
+    if (p && g_level) track(p, strlen(p) + 1, tag, file, line);
+    return p;
+}
+
+void mem_free(void *p) {
+    Block b;
+    if (p && g_level) untrack(p, &b);
+    free(p);
+}
+
+/* ── Reports ────────────────────────────────────────────────── */
+
+void mem_stats(MemTag tag, MemStats *out) {
+    memset(out, 0, sizeof(*out));
+    if (tag >= MEM_TAGS) return;
+    TagStats *t = &g_tags[tag];
+    out->in_use = atomic_load_explicit(&t->in_use, memory_order_relaxed);
+    out->peak = atomic_load_explicit(&t->peak, memory_order_relaxed);
+    out->blocks = atomic_load_explicit(&t->blocks, memory_order_relaxed);
+    out->allocs = atomic_load_explicit(&t->allocs, memory_order_relaxed);
+    out->frees = atomic_load_explicit(&t->frees, memory_order_relaxed);
+    for (int i = 0; i < MEM_HIST; i++)
+        out->hist[i] = atomic_load_explicit(&t->hist[i], memory_order_relaxed);
+}
+
+static const char *fmt_size(char *buf, size_t n, size_t bytes) {
+    if (bytes < 10 * 1024) snprintf(buf, n, "%zu B", bytes);
+    else if (bytes < 10 * 1024 * 1024) snprintf(buf, n, "%zu KB", bytes >> 10);
+    else snprintf(buf, n, "%zu MB", bytes >> 20);
+    return buf;
+}
+
+/* Size classes with any allocations, as "<=64:12 <=1K:3 >256K:1". */
+static void print_hist(FILE *out, const uint64_t *hist) {
+    for (int i = 0; i < MEM_HIST; i++) {
+        if (!hist[i]) continue;
+        size_t lim = (size_t)16 << i;
+        if (i == MEM_HIST - 1) fprintf(out, " >%zuK:%llu", (lim >> 1) >> 10, (unsigned long long)hist[i]);
+        else if (lim < 1024) fprintf(out, " <=%zu:%llu", lim, (unsigned long long)hist[i]);
+        else fprintf(out, " <=%zuK:%llu", lim >> 10, (unsigned long long)hist[i]);
+    }
+    fputc('\n', out);
+}
+
+void mem_stats_dump(FILE *out) {
+    char a[16], b[16], c[16];
+
+    if (g_level) {
+        fprintf(out, "Heap by subsystem:\n");
+        fprintf(out, "  %-9s %9s %9s %8s %10s %10s\n", "tag", "in use", "peak", "blocks", "allocs", "frees");
+        for (int i = 0; i < MEM_TAGS; i++) {
+            MemStats st;
+            mem_stats((MemTag)i, &st);
+            if (!st.allocs) continue;
+            fprintf(out, "  %-9s %9s %9s %8zu %10llu %10llu\n", g_names[i],
+                    fmt_size(a, sizeof(a), st.in_use), fmt_size(b, sizeof(b), st.peak), st.blocks,
+                    (unsigned long long)st.allocs, (unsigned long long)st.frees);
+        }
+        fprintf(out, "Allocation sizes:\n");
+        for (int i = 0; i < MEM_TAGS; i++) {
+            MemStats st;
+            mem_stats((MemTag)i, &st);
+            if (!st.allocs) continue;
+            fprintf(out, "  %-9s", g_names[i]);
+            print_hist(out, st.hist);
+        }
+    } else {
+        fprintf(out, "Heap tracking is off (set mem_track = stats)\n");
+    }
+
+    ArenaStats as;
+    arena_stats(&as);
+    fprintf(out, "Arenas: %zu chunks (%s, peak %s); %llu chunks from the pool, %llu spares reused\n",
+            as.chunks, fmt_size(a, sizeof(a), as.chunk_bytes), fmt_size(b, sizeof(b), as.peak_bytes),
+            (unsigned long long)as.chunk_allocs, (unsigned long long)as.chunk_reuses);
+    if (as.allocs) {
+        fprintf(out, "  %llu allocations, %s:", (unsigned long long)as.allocs,
+                fmt_size(c, sizeof(c), (size_t)as.alloc_bytes));
+        print_hist(out, as.hist);
+    }
+
+    PoolStats ps;
+    pool_stats(&ps);
+    fprintf(out, "Buffer pool: %llu gets, %llu from thread caches, %llu shared, %llu malloc'd; "
+            "%llu dropped; %s cached\n",
+            (unsigned long long)ps.gets, (unsigned long long)ps.thread_hits,
+            (unsigned long long)ps.shared_hits,
+            (unsigned long long)(ps.gets - ps.thread_hits - ps.shared_hits),
+            (unsigned long long)ps.dropped, fmt_size(a, sizeof(a), ps.cached));
+}
+
+typedef struct {
+    const char *file;
+    int         line;
+    MemTag      tag;
+    size_t      blocks, bytes;
+} Site;
+
+static int site_by_place(const void *x, const void *y) {
+    const Site *a = x, *b = y;
+    int c = strcmp(a->file ? a->file : "", b->file ? b->file : "");
+    if (c) return c;
+    if (a->line != b->line) return a->line < b->line ? -1 : 1;
+    return (int)a->tag - (int)b->tag;
+}
+
+static int site_by_bytes(const void *x, const void *y) {
+    const Site *a = x, *b = y;
+    return a->bytes < b->bytes ? 1 : a->bytes > b->bytes ? -1 : 0;
+}
+
+size_t mem_leak_report(FILE *out) {
+    if (g_level != MEM_TRACK_LEAKS) return 0;
+
+    size_t n = 0, cap = 0, bytes = 0;
+    Site *sites = NULL;
+    for (int i = 0; i < SHARDS; i++) {
+        Shard *s = &g_shards[i];
+        pthread_mutex_lock(&s->lock);
+        for (size_t j = 0; j < s->cap; j++) {
+            const Block *b = &s->slots[j];
+            if (!b->ptr) continue;
+            if (n == cap) {
+                cap = cap ? cap * 2 : 256;
+                Site *grown = realloc(sites, cap * sizeof(*sites));
+                if (!grown) break;
+                sites = grown;
+            }
+            sites[n++] = (Site){ b->file, b->line, b->tag, 1, b->size };
+            bytes += b->size;
+        }
+        pthread_mutex_unlock(&s->lock);
+    }
+    size_t blocks = n;
+    if (!n) {
+        fprintf(out, "No leaked blocks\n");
+        free(sites);
+        return 0;
+    }
+
+    /* One row per call site, largest first */
+    qsort(sites, n, sizeof(*sites), site_by_place);
+    size_t m = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (m && !site_by_place(&sites[m - 1], &sites[i])) {
+            sites[m - 1].blocks++;
+            sites[m - 1].bytes += sites[i].bytes;
+        } else {
+            sites[m++] = sites[i];
+        }
+    }
+    qsort(sites, m, sizeof(*sites), site_by_bytes);
+
+    char a[16];
+    fprintf(out, "Leaked: %zu blocks, %s, from %zu call sites:\n", blocks, fmt_size(a, sizeof(a), bytes), m);
+    fprintf(out, "  %9s %7s  %-9s %s\n", "bytes", "blocks", "tag", "site");
+    for (size_t i = 0; i < m && i < LEAK_SITES; i++) {
+        fprintf(out, "  %9s %7zu  %-9s %s:%d\n", fmt_size(a, sizeof(a), sites[i].bytes),
+                sites[i].blocks, g_names[sites[i].tag], sites[i].file ? sites[i].file : "?", sites[i].line);
+    }
+    if (m > LEAK_SITES) fprintf(out, "  ... and %zu more sites\n", m - LEAK_SITES);
+    free(sites);
+    return blocks;
+}
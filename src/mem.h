@@ -0,0 +1,86 @@
+#ifndef CCLAW_MEM_H
+#define CCLAW_MEM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Allocation tracking by subsystem. A module opts in by defining MEM_TAG
+ * and including this header after all others: its malloc, calloc,
+ * realloc, strdup, strndup and free then go through the functions below,
+ * which pass straight to libc while tracking is off. A block may be freed
+ * by any module that opted in, and libc's own blocks (getline, asprintf)
+ * can be passed to their free() as before. */
+
+typedef enum {
+    MEM_OTHER,
+    MEM_HTTP,
+    MEM_PROVIDER,
+    MEM_SESSION,
+    MEM_MEMORY,
+    MEM_WS,
+    MEM_TOOLS,
+    MEM_ARENA,     /* Arena bookkeeping and NULL-arena results */
+    MEM_POOL,      /* Pooled buffers (arena chunks among them), cached ones too */
+    MEM_JSON,      /* cJSON outside a mem_json_tag() scope */
+    MEM_TAGS
+} MemTag;
+
+typedef enum {
+    MEM_TRACK_OFF,
+    MEM_TRACK_STATS,  /* Per-tag bytes, peaks, counts and size classes */
+    MEM_TRACK_LEAKS,  /* Also each block's call site, for mem_leak_report() */
+} MemTrack;
+
+/* Size classes: <=16 B, <=32 B, ... <=256 KB, larger. */
+#define MEM_HIST 16
+
+typedef struct {
+    size_t   in_use;   /* Bytes requested and not yet freed */
+    size_t   peak;
+    size_t   blocks;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t hist[MEM_HIST];  /* Allocations by size class */
+} MemStats;
+
+/* Set the level once at startup, before other threads exist. Blocks
+ * allocated earlier aren't tracked. */
+void     mem_track_init(MemTrack level);
+MemTrack mem_tracking(void);
+
+int         mem_size_class(size_t size);
+const char *mem_tag_name(MemTag tag);
+void        mem_stats(MemTag tag, MemStats *out);
+
+/* Per-tag table, with arena totals. */
+void mem_stats_dump(FILE *out);
+
+/* Blocks still live, grouped by call site (MEM_TRACK_LEAKS). Returns
+ * their number. */
+size_t mem_leak_report(FILE *out);
+
+/* Count this thread's cJSON allocations under `tag` rather than
+ * MEM_JSON. Returns the previous tag, to restore. */
+MemTag mem_json_tag(MemTag tag);
+
+void *mem_malloc(MemTag tag, size_t size, const char *file, int line);
+void *mem_calloc(MemTag tag, size_t n, size_t size, const char *file, int line);
+void *mem_realloc(MemTag tag, void *p, size_t size, const char *file, int line);
+char *mem_strdup(MemTag tag, const char *s, const char *file, int line);
+char *mem_strndup(MemTag tag, const char *s, size_t n, const char *file, int line);
+void  mem_free(void *p);
+
+#endif
+
+/* Outside the guard: only the module's own, last include defines them. */
+#if defined(MEM_TAG) && !defined(CCLAW_MEM_WRAP)
+#define CCLAW_MEM_WRAP
+#define malloc(n)      mem_malloc(MEM_TAG, (n), __FILE__, __LINE__)
+#define calloc(n, s)   mem_calloc(MEM_TAG, (n), (s), __FILE__, __LINE__)
+#define realloc(p, n)  mem_realloc(MEM_TAG, (p), (n), __FILE__, __LINE__)
+#define strdup(s)      mem_strdup(MEM_TAG, (s), __FILE__, __LINE__)
+#define strndup(s, n)  mem_strndup(MEM_TAG, (s), (n), __FILE__, __LINE__)
+#define free(p)        mem_free(p)
+#endif
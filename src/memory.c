@@ -13,6 +13,9 @@
 #include <string.h>
 #include <math.h>
 
+#define MEM_TAG MEM_MEMORY
+#include "mem.h"
+
 struct Memory {
     sqlite3 *db;
 };
@@ -0,0 +1,175 @@
+#include "pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define MEM_TAG MEM_POOL
+#include "mem.h"
+
+#define CLASSES       5                  /* POOL_MIN << 0 .. POOL_MIN << 4 */
+#define THREAD_SLOTS  8                  /* Buffers of one class a thread keeps */
+#define THREAD_BYTES  (256 * 1024)       /* Bytes a thread keeps in all */
+#define SHARED_BYTES  (1024 * 1024)      /* Bytes the shared cache keeps */
+
+/* A cached buffer's first bytes link it into the shared list */
+typedef struct Free {
+    struct Free *next;
+} Free;
+
+typedef struct {
+    void  *buf[CLASSES][THREAD_SLOTS];
+    int    n[CLASSES];
+    size_t bytes;
+} ThreadCache;
+
+static __thread ThreadCache *t_cache;
+static pthread_key_t  g_key;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static Free  *g_shared[CLASSES];
+static size_t g_shared_bytes;
+
+static atomic_ullong g_gets, g_thread_hits, g_shared_hits, g_puts, g_dropped;
+static atomic_size_t g_cached;
+
+static int class_of(size_t size) {
+    int c = 0;
+    for (size_t s = POOL_MIN; s < size; s <<= 1) c++;
+    return c;
+}
+
+/* Class of a buffer `cap` bytes long, or -1 if it isn't one */
+static int class_exact(size_t cap) {
+    if (cap < POOL_MIN || cap > POOL_MAX || (cap & (cap - 1))) return -1;
+    return class_of(cap);
+}
+
+static bool shared_push(int c, void *buf, size_t cap) {
+    bool ok = false;
+    pthread_mutex_lock(&g_lock);
+    if (g_shared_bytes + cap <= SHARED_BYTES) {
+        Free *f = buf;
+        f->next = g_shared[c];
+        g_shared[c] = f;
+        g_shared_bytes += cap;
+        ok = true;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return ok;
+}
+
+/* Move a thread's buffers to the shared cache, freeing what doesn't fit. */
+static void cache_flush(ThreadCache *tc) {
+    for (int c = 0; c < CLASSES; c++) {
+        size_t cap = (size_t)POOL_MIN << c;
+        while (tc->n[c]) {
+            void *buf = tc->buf[c][--tc->n[c]];
+            if (shared_push(c, buf, cap)) continue;
+            free(buf);
+            atomic_fetch_sub_explicit(&g_cached, cap, memory_order_relaxed);
+        }
+    }
+    tc->bytes = 0;
+}
+
+static void thread_exit(void *p) {
+    cache_flush(p);
+    free(p);
+    t_cache = NULL;
+}
+
+static void key_init(void) {
+    pthread_key_create(&g_key, thread_exit);
+}
+
+static ThreadCache *thread_cache(void) {
+    if (!t_cache) {
+        pthread_once(&g_once, key_init);
+        t_cache = calloc(1, sizeof(*t_cache));
+        if (t_cache) pthread_setspecific(g_key, t_cache);
+    }
+    return t_cache;
+}
+
+void *pool_get(size_t size, size_t *cap) {
+    if (size > POOL_MAX) {
+        *cap = size;
+        return malloc(size);
+    }
+    int c = class_of(size);
+    size_t sz = (size_t)POOL_MIN << c;
+    *cap = sz;
+    atomic_fetch_add_explicit(&g_gets, 1, memory_order_relaxed);
+
+    ThreadCache *tc = t_cache;
+    if (tc && tc->n[c]) {
+        tc->bytes -= sz;
+        atomic_fetch_sub_explicit(&g_cached, sz, memory_order_relaxed);
+        atomic_fetch_add_explicit(&g_thread_hits, 1, memory_order_relaxed);
+        return tc->buf[c][--tc->n[c]];
+    }
+
+    pthread_mutex_lock(&g_lock);
+    Free *f = g_shared[c];
+    if (f) {
+        g_shared[c] = f->next;
+        g_shared_bytes -= sz;
+    }
+    pthread_mutex_unlock(&g_lock);
+    if (f) {
+        atomic_fetch_sub_explicit(&g_cached, sz, memory_order_relaxed);
+        atomic_fetch_add_explicit(&g_shared_hits, 1, memory_order_relaxed);
+        return f;
+    }
+    return malloc(sz);
+}
+
+void pool_put(void *buf, size_t cap) {
+    if (!buf) return;
+    int c = class_exact(cap);
+    if (c < 0) {
+        free(buf);
+        return;
+    }
+    atomic_fetch_add_explicit(&g_puts, 1, memory_order_relaxed);
+
+    ThreadCache *tc = thread_cache();
+    if (tc && tc->n[c] < THREAD_SLOTS && tc->bytes + cap <= THREAD_BYTES) {
+        tc->buf[c][tc->n[c]++] = buf;
+        tc->bytes += cap;
+    } else if (!shared_push(c, buf, cap)) {
+        atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+        free(buf);
+        return;
+    }
+    atomic_fetch_add_explicit(&g_cached, cap, memory_order_relaxed);
+}
+
+void pool_stats(PoolStats *out) {
+    out->gets = atomic_load_explicit(&g_gets, memory_order_relaxed);
+    out->thread_hits = atomic_load_explicit(&g_thread_hits, memory_order_relaxed);
+    out->shared_hits = atomic_load_explicit(&g_shared_hits, memory_order_relaxed);
+    out->puts = atomic_load_explicit(&g_puts, memory_order_relaxed);
+    out->dropped = atomic_load_explicit(&g_dropped, memory_order_relaxed);
+    out->cached = atomic_load_explicit(&g_cached, memory_order_relaxed);
+}
+
+void pool_trim(void) {
+    if (t_cache) {
+        pthread_setspecific(g_key, NULL);
+        thread_exit(t_cache);
+    }
+    pthread_mutex_lock(&g_lock);
+    for (int c = 0; c < CLASSES; c++) {
+        while (g_shared[c]) {
+            Free *f = g_shared[c];
+            g_shared[c] = f->next;
+            free(f);
+            atomic_fetch_sub_explicit(&g_cached, (size_t)POOL_MIN << c, memory_order_relaxed);
+        }
+    }
+    g_shared_bytes = 0;
+    pthread_mutex_unlock(&g_lock);
+}
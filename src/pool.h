@@ -0,0 +1,42 @@
+#ifndef CCLAW_POOL_H
+#define CCLAW_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Recycled I/O buffers. Sizes are rounded up to a power of two between
+ * POOL_MIN and POOL_MAX; a returned buffer goes to a small cache of the
+ * calling thread, then to a shared one, and the next pool_get() of its
+ * class takes it from there instead of calling malloc. Larger buffers
+ * are plain malloc/free. Arena chunks, HTTP response bodies, the SSE
+ * reader and WebSocket payloads all come from here, so a buffer freed by
+ * one is reused by the next. */
+
+#define POOL_MIN (4 * 1024)
+#define POOL_MAX (64 * 1024)
+
+/* A buffer of at least `size` bytes; *cap gets its real size, which is
+ * what pool_put() needs back. NULL if out of memory. */
+void *pool_get(size_t size, size_t *cap);
+
+/* Return a buffer from pool_get(). Anything else with a `cap` that isn't
+ * a pool class (0, say) is just freed, so a malloc'd buffer may be
+ * passed too. NULL is ignored. */
+void  pool_put(void *buf, size_t cap);
+
+typedef struct {
+    uint64_t gets;
+    uint64_t thread_hits;  /* Served from the thread's cache */
+    uint64_t shared_hits;  /* Served from the shared cache */
+    uint64_t puts;
+    uint64_t dropped;      /* Returned with both caches full, and freed */
+    size_t   cached;       /* Bytes held in all caches now */
+} PoolStats;
+
+void pool_stats(PoolStats *out);
+
+/* Free the shared cache and this thread's. Other threads' caches are
+ * flushed when they exit. */
+void pool_trim(void);
+
+#endif
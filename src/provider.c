@@ -1,58 +1,94 @@
 #include "provider.h"
 #include "log.h"
+#include "rope.h"
 #include <cJSON.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+#define MEM_TAG MEM_PROVIDER
+#include "mem.h"
+
 #define ANTHROPIC_URL "https://api.anthropic.com/v1/messages"
 #define MAX_TOKENS 8192
 
-/* Build the request body JSON for Anthropic Messages API. */
-static char *build_request_body(const char *model, const char *system_prompt,
-                                const char *messages_json, const char *tools_json,
-                                float temperature, bool stream) {
+/* True if `json` holds a JSON array, which is spliced in as is. */
+static bool is_array(const char *json) {
+    if (!json) return false;
+    while (*json == ' ' || *json == '\n' || *json == '\t' || *json == '\r') json++;
+    return *json == '[';
+}
+
+/* Build the request body for the Anthropic Messages API as segments,
+ * with the system prompt, messages and tools spliced in uncopied. The
+ * rest comes from `a`. */
+static Rope build_request_body(Arena *a, const char *model, SystemPrompt system,
+                               const char *messages_json, const char *tools_json,
+                               float temperature, bool stream) {
+    Arena *prev = arena_json_use(a);
     cJSON *root = cJSON_CreateObject();
     cJSON_AddStringToObject(root, "model", model);
     cJSON_AddNumberToObject(root, "max_tokens", MAX_TOKENS);
     cJSON_AddNumberToObject(root, "temperature", (double)temperature);
 
     if (stream) cJSON_AddBoolToObject(root, "stream", 1);
+    char *head = cJSON_PrintUnformatted(root);
 
-    if (system_prompt && system_prompt[0]) {
-        cJSON_AddStringToObject(root, "system", system_prompt);
-    }
-
-    /* Messages: parse the pre-built JSON array */
-    cJSON *msgs = cJSON_Parse(messages_json);
-    if (msgs) {
-        cJSON_AddItemToObject(root, "messages", msgs);
-    } else {
+    char *msgs = NULL;
+    if (!is_array(messages_json)) {
         /* Fallback: single user message */
-        cJSON *arr = cJSON_AddArrayToObject(root, "messages");
+        cJSON *arr = cJSON_CreateArray();
         cJSON *msg = cJSON_CreateObject();
         cJSON_AddStringToObject(msg, "role", "user");
         cJSON_AddStringToObject(msg, "content", messages_json);
         cJSON_AddItemToArray(arr, msg);
+        msgs = cJSON_PrintUnformatted(arr);
     }
-
-    if (tools_json && tools_json[0]) {
-        cJSON *tools = cJSON_Parse(tools_json);
-        if (tools) cJSON_AddItemToObject(root, "tools", tools);
+    arena_json_use(prev);
+
+    Rope body = { 0 };
+    rope_adds(&body, "{");
+    if (system.json && system.len) {
+        rope_adds(&body, "\"system\":");
+        rope_add(&body, system.json, system.len);
+        rope_adds(&body, ",");
     }
-
-    char *body = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
+    rope_add(&body, head + 1, strlen(head) - 2);  /* Its members, without the braces */
+    rope_adds(&body, ",\"messages\":");
+    rope_adds(&body, msgs ? msgs : messages_json);
+    if (is_array(tools_json)) {
+        rope_adds(&body, ",\"tools\":");
+        rope_adds(&body, tools_json);
+    }
+    rope_adds(&body, "}");
     return body;
 }
 
+/* Append `n` bytes to a string from `a` that grows by doubling. */
+static char *str_append(Arena *a, char *buf, size_t *len, size_t *cap,
+                        const char *s, size_t n) {
+    if (*len + n + 1 > *cap) {
+        size_t want = (*len + n + 1) * 2;
+        char *p = arena_realloc(a, buf, *cap, want < 256 ? 256 : want);
+        if (!p) return buf;
+        buf = p;
+        *cap = want < 256 ? 256 : want;
+    }
+    memcpy(buf + *len, s, n);
+    *len += n;
+    buf[*len] = '\0';
+    return buf;
+}
+
 /* Parse Anthropic non-streaming response. */
-static ChatResponse parse_response(const char *json_str) {
+static ChatResponse parse_response(Arena *a, const char *json_str) {
     ChatResponse resp = {0};
+    Arena *prev = arena_json_use(a);
     cJSON *root = cJSON_Parse(json_str);
     if (!root) {
+        arena_json_use(prev);
         LOG_ERROR("Failed to parse API response");
-        resp.text = strdup("Error: failed to parse API response");
+        resp.text = arena_strdup(a, "Error: failed to parse API response");
         return resp;
     }
 
@@ -60,14 +96,14 @@ static ChatResponse parse_response(const char *json_str) {
     cJSON *err = cJSON_GetObjectItem(root, "error");
     if (err) {
         cJSON *msg = cJSON_GetObjectItem(err, "message");
-        resp.text = strdup(msg ? msg->valuestring : "Unknown API error");
-        cJSON_Delete(root);
+        resp.text = msg ? msg->valuestring : arena_strdup(a, "Unknown API error");
+        arena_json_use(prev);
         return resp;
     }
 
     /* Stop reason */
     cJSON *stop = cJSON_GetObjectItem(root, "stop_reason");
-    if (stop && stop->valuestring) resp.stop_reason = strdup(stop->valuestring);
+    if (stop && stop->valuestring) resp.stop_reason = stop->valuestring;
 
     /* Usage */
     cJSON *usage = cJSON_GetObjectItem(root, "usage");
@@ -83,7 +119,7 @@ static ChatResponse parse_response(const char *json_str) {
     if (content && cJSON_IsArray(content)) {
         /* Count tool uses */
         int num_tools = 0;
-        int text_len = 0;
+        size_t text_len = 0;
         cJSON *block;
         cJSON_ArrayForEach(block, content) {
             cJSON *type = cJSON_GetObjectItem(block, "type");
@@ -91,12 +127,13 @@ static ChatResponse parse_response(const char *json_str) {
             if (!strcmp(type->valuestring, "tool_use")) num_tools++;
             if (!strcmp(type->valuestring, "text")) {
                 cJSON *t = cJSON_GetObjectItem(block, "text");
-                if (t && t->valuestring) text_len += (int)strlen(t->valuestring);
+                if (t && t->valuestring) text_len += strlen(t->valuestring);
             }
         }
 
         if (num_tools > 0) {
-            resp.tool_calls = calloc((size_t)num_tools, sizeof(ToolCall));
+            resp.tool_calls = arena_alloc(a, (size_t)num_tools * sizeof(ToolCall));
+            memset(resp.tool_calls, 0, (size_t)num_tools * sizeof(ToolCall));
             resp.num_tools = num_tools;
             int ti = 0;
             cJSON_ArrayForEach(block, content) {
@@ -105,34 +142,39 @@ static ChatResponse parse_response(const char *json_str) {
                 cJSON *id = cJSON_GetObjectItem(block, "id");
                 cJSON *name = cJSON_GetObjectItem(block, "name");
                 cJSON *input = cJSON_GetObjectItem(block, "input");
-                if (id) resp.tool_calls[ti].id = strdup(id->valuestring);
-                if (name) resp.tool_calls[ti].name = strdup(name->valuestring);
+                if (id) resp.tool_calls[ti].id = id->valuestring;
+                if (name) resp.tool_calls[ti].name = name->valuestring;
                 if (input) resp.tool_calls[ti].input_json = cJSON_PrintUnformatted(input);
                 ti++;
             }
         }
 
         if (text_len > 0) {
-            resp.text = calloc(1, (size_t)text_len + 1);
+            /* Text blocks are joined */
+            char *p = resp.text = arena_alloc(a, text_len + 1);
             cJSON_ArrayForEach(block, content) {
                 cJSON *type = cJSON_GetObjectItem(block, "type");
                 if (!type || strcmp(type->valuestring, "text")) continue;
                 cJSON *t = cJSON_GetObjectItem(block, "text");
-                if (t && t->valuestring) strcat(resp.text, t->valuestring);
+                if (!t || !t->valuestring) continue;
+                size_t n = strlen(t->valuestring);
+                memcpy(p, t->valuestring, n);
+                p += n;
             }
+            *p = '\0';
         }
     }
 
-    cJSON_Delete(root);
+    arena_json_use(prev);
     return resp;
 }
 
-ChatResponse provider_chat(HttpClient *http, const char *api_key,
-                           const char *model, const char *system_prompt,
+ChatResponse provider_chat(HttpClient *http, Arena *arena, const char *api_key,
+                           const char *model, SystemPrompt system,
                            const char *messages_json, const char *tools_json,
                            float temperature) {
-    char *body = build_request_body(model, system_prompt, messages_json,
-                                    tools_json, temperature, false);
+    Rope body = build_request_body(arena, model, system, messages_json,
+                                   tools_json, temperature, false);
 
     char auth[300];
     snprintf(auth, sizeof(auth), "%s", api_key);
@@ -142,26 +184,21 @@ ChatResponse provider_chat(HttpClient *http, const char *api_key,
         "anthropic-version", "2023-06-01",
     };
 
-    HttpResponse hr = http_post_json(http, ANTHROPIC_URL, body, headers, 2);
-    free(body);
+    HttpResponse hr = http_post_json_iov(http, arena, ANTHROPIC_URL, body.seg, body.n, headers, 2);
+    rope_free(&body);
 
-    ChatResponse resp;
-    if (hr.body) {
-        resp = parse_response(hr.body);
-    } else {
-        memset(&resp, 0, sizeof(resp));
-        resp.text = strdup("Error: no response from API");
-    }
-
-    http_response_free(&hr);
-    return resp;
+    if (hr.body) return parse_response(arena, hr.body);
+    return (ChatResponse){ .text = arena_strdup(arena, "Error: no response from API") };
 }
 
 /* Streaming state */
 typedef struct {
     StreamTextCb user_cb;
     void        *userdata;
+    Arena       *arena;   /* The response */
+    Arena        events;  /* Each event's parse, reset for the next */
     ChatResponse resp;
+    size_t text_len, text_cap;
     /* Accumulate tool_use blocks across events */
     char *current_tool_id;
     char *current_tool_name;
@@ -176,11 +213,14 @@ static bool stream_cb(const char *data, size_t len, void *ud) {
 
     if (!strcmp(data, "[DONE]")) return false;
 
+    arena_reset(&st->events);
+    Arena *prev = arena_json_use(&st->events);
     cJSON *event = cJSON_Parse(data);
+    arena_json_use(prev);
     if (!event) return true;
 
     cJSON *type = cJSON_GetObjectItem(event, "type");
-    if (!type || !type->valuestring) { cJSON_Delete(event); return true; }
+    if (!type || !type->valuestring) return true;
 
     if (!strcmp(type->valuestring, "content_block_delta")) {
         cJSON *delta = cJSON_GetObjectItem(event, "delta");
@@ -190,31 +230,20 @@ static bool stream_cb(const char *data, size_t len, void *ud) {
                 cJSON *text = cJSON_GetObjectItem(delta, "text");
                 if (text && text->valuestring) {
                     if (st->user_cb) {
-                        if (!st->user_cb(text->valuestring, st->userdata)) {
-                            cJSON_Delete(event);
-                            return false;
-                        }
+                        if (!st->user_cb(text->valuestring, st->userdata)) return false;
                     }
                     /* Accumulate text */
-                    if (!st->resp.text) st->resp.text = strdup(text->valuestring);
-                    else {
-                        size_t old = strlen(st->resp.text);
-                        size_t add = strlen(text->valuestring);
-                        st->resp.text = realloc(st->resp.text, old + add + 1);
-                        memcpy(st->resp.text + old, text->valuestring, add + 1);
-                    }
+                    st->resp.text = str_append(st->arena, st->resp.text, &st->text_len,
+                                               &st->text_cap, text->valuestring,
+                                               strlen(text->valuestring));
                 }
             } else if (dt && !strcmp(dt->valuestring, "input_json_delta")) {
                 cJSON *partial = cJSON_GetObjectItem(delta, "partial_json");
-                if (partial && partial->valuestring) {
-                    size_t plen = strlen(partial->valuestring);
-                    if (st->tool_input_len + plen >= st->tool_input_cap) {
-                        st->tool_input_cap = (st->tool_input_cap + plen) * 2;
-                        st->current_tool_input = realloc(st->current_tool_input, st->tool_input_cap);
-                    }
-                    memcpy(st->current_tool_input + st->tool_input_len, partial->valuestring, plen);
-                    st->tool_input_len += plen;
-                    st->current_tool_input[st->tool_input_len] = '\0';
+                if (partial && partial->valuestring && st->current_tool_id) {
+                    st->current_tool_input = str_append(st->arena, st->current_tool_input,
+                                                        &st->tool_input_len, &st->tool_input_cap,
+                                                        partial->valuestring,
+                                                        strlen(partial->valuestring));
                 }
             }
         }
@@ -225,41 +254,34 @@ static bool stream_cb(const char *data, size_t len, void *ud) {
             if (cbt && !strcmp(cbt->valuestring, "tool_use")) {
                 cJSON *id = cJSON_GetObjectItem(cb_json, "id");
                 cJSON *name = cJSON_GetObjectItem(cb_json, "name");
-                free(st->current_tool_id);
-                free(st->current_tool_name);
-                st->current_tool_id = id ? strdup(id->valuestring) : NULL;
-                st->current_tool_name = name ? strdup(name->valuestring) : NULL;
+                st->current_tool_id = id ? arena_strdup(st->arena, id->valuestring) : NULL;
+                st->current_tool_name = name ? arena_strdup(st->arena, name->valuestring) : NULL;
+                st->current_tool_input = NULL;
                 st->tool_input_len = 0;
-                if (!st->current_tool_input) {
-                    st->tool_input_cap = 1024;
-                    st->current_tool_input = malloc(st->tool_input_cap);
-                }
-                st->current_tool_input[0] = '\0';
+                st->tool_input_cap = 0;
             }
         }
     } else if (!strcmp(type->valuestring, "content_block_stop")) {
         /* Finalize tool call if active */
         if (st->current_tool_id) {
             int n = st->resp.num_tools;
-            st->resp.tool_calls = realloc(st->resp.tool_calls, (size_t)(n + 1) * sizeof(ToolCall));
+            st->resp.tool_calls = arena_realloc(st->arena, st->resp.tool_calls,
+                                                (size_t)n * sizeof(ToolCall),
+                                                (size_t)(n + 1) * sizeof(ToolCall));
             st->resp.tool_calls[n].id = st->current_tool_id;
             st->resp.tool_calls[n].name = st->current_tool_name;
-            st->resp.tool_calls[n].input_json = st->current_tool_input;
+            st->resp.tool_calls[n].input_json = st->current_tool_input
+                ? st->current_tool_input : arena_strdup(st->arena, "");
             st->resp.num_tools = n + 1;
             st->current_tool_id = NULL;
             st->current_tool_name = NULL;
             st->current_tool_input = NULL;
-            st->tool_input_len = 0;
-            st->tool_input_cap = 0;
         }
     } else if (!strcmp(type->valuestring, "message_delta")) {
         cJSON *delta = cJSON_GetObjectItem(event, "delta");
         if (delta) {
             cJSON *sr = cJSON_GetObjectItem(delta, "stop_reason");
-            if (sr && sr->valuestring) {
-                free(st->resp.stop_reason);
-                st->resp.stop_reason = strdup(sr->valuestring);
-            }
+            if (sr && sr->valuestring) st->resp.stop_reason = arena_strdup(st->arena, sr->valuestring);
         }
         cJSON *usage = cJSON_GetObjectItem(event, "usage");
         if (usage) {
@@ -277,17 +299,16 @@ static bool stream_cb(const char *data, size_t len, void *ud) {
         }
     }
 
-    cJSON_Delete(event);
     return true;
 }
 
-ChatResponse provider_chat_stream(HttpClient *http, const char *api_key,
-                                  const char *model, const char *system_prompt,
+ChatResponse provider_chat_stream(HttpClient *http, Arena *arena, const char *api_key,
+                                  const char *model, SystemPrompt system,
                                   const char *messages_json, const char *tools_json,
                                   float temperature,
                                   StreamTextCb cb, void *userdata) {
-    char *body = build_request_body(model, system_prompt, messages_json,
-                                    tools_json, temperature, true);
+    Rope body = build_request_body(arena, model, system, messages_json,
+                                   tools_json, temperature, true);
 
     const char *headers[] = {
         "x-api-key", api_key,
@@ -297,21 +318,12 @@ ChatResponse provider_chat_stream(HttpClient *http, const char *api_key,
     StreamState st = {0};
     st.user_cb = cb;
     st.userdata = userdata;
+    st.arena = arena;
+    st.events = arena_new(16 * 1024);
 
-    http_post_stream(http, ANTHROPIC_URL, body, headers, 2, stream_cb, &st);
-    free(body);
+    http_post_stream_iov(http, ANTHROPIC_URL, body.seg, body.n, headers, 2, stream_cb, &st);
+    rope_free(&body);
+    arena_free(&st.events);
 
     return st.resp;
 }
-
-void chat_response_free(ChatResponse *r) {
-    free(r->text);
-    free(r->stop_reason);
-    for (int i = 0; i < r->num_tools; i++) {
-        free(r->tool_calls[i].id);
-        free(r->tool_calls[i].name);
-        free(r->tool_calls[i].input_json);
-    }
-    free(r->tool_calls);
-    memset(r, 0, sizeof(*r));
-}
@@ -12,7 +12,8 @@ typedef struct {
     char *input_json;  /* Raw JSON string of arguments */
 } ToolCall;
 
-/* Chat response — either text or tool calls */
+/* Chat response — either text or tool calls. Everything in it comes
+ * from the arena the call was given, and is released with it. */
 typedef struct {
     char  *text;          /* NULL if tool_use */
     ToolCall *tool_calls;
@@ -22,29 +23,38 @@ typedef struct {
     int    output_tokens;
 } ChatResponse;
 
+/* The system prompt as a quoted, escaped JSON string (see WsPrompt).
+ * Providers splice it into the request body as is, so it's escaped once
+ * per prompt rather than per request, and never copied. {NULL, 0} = none. */
+typedef struct {
+    const char *json;
+    size_t      len;
+} SystemPrompt;
+
 /* Streaming callback: text delta. Return false to abort. */
 typedef bool (*StreamTextCb)(const char *delta, void *userdata);
 
-/* Send a chat message (non-streaming). */
+/* Send a chat message (non-streaming). The request body and the
+ * response are built in `arena`. */
 ChatResponse provider_chat(HttpClient *http,
+                           Arena *arena,
                            const char *api_key,
                            const char *model,
-                           const char *system_prompt,
+                           SystemPrompt system,
                            const char *messages_json,
                            const char *tools_json,
                            float temperature);
 
 /* Send a chat message with streaming text output. */
 ChatResponse provider_chat_stream(HttpClient *http,
+                                  Arena *arena,
                                   const char *api_key,
                                   const char *model,
-                                  const char *system_prompt,
+                                  SystemPrompt system,
                                   const char *messages_json,
                                   const char *tools_json,
                                   float temperature,
                                   StreamTextCb cb,
                                   void *userdata);
 
-void chat_response_free(ChatResponse *r);
-
 #endif
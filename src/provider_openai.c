@@ -7,11 +7,15 @@
 
 #include "provider_openai.h"
 #include "log.h"
+#include "rope.h"
 #include <cJSON.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+#define MEM_TAG MEM_PROVIDER
+#include "mem.h"
+
 #define OPENAI_URL "https://api.openai.com/v1/chat/completions"
 #define MAX_TOKENS 8192
 
@@ -19,12 +23,13 @@
  * Convert Anthropic-style tools JSON to OpenAI function calling format.
  * Anthropic: [{ name, description, input_schema }]
  * OpenAI:    [{ type: "function", function: { name, description, parameters } }]
+ * Call with an arena selected for cJSON; nothing needs deleting.
  */
 static cJSON *convert_tools(const char *tools_json) {
     if (!tools_json || !tools_json[0]) return NULL;
 
     cJSON *src = cJSON_Parse(tools_json);
-    if (!src || !cJSON_IsArray(src)) { cJSON_Delete(src); return NULL; }
+    if (!src || !cJSON_IsArray(src)) return NULL;
 
     cJSON *out = cJSON_CreateArray();
     cJSON *tool;
@@ -36,80 +41,105 @@ static cJSON *convert_tools(const char *tools_json) {
         cJSON *fn = cJSON_CreateObject();
         if (name)   cJSON_AddStringToObject(fn, "name", name->valuestring);
         if (desc)   cJSON_AddStringToObject(fn, "description", desc->valuestring);
-        if (schema) cJSON_AddItemToObject(fn, "parameters", cJSON_Duplicate(schema, 1));
+        if (schema) cJSON_AddItemReferenceToObject(fn, "parameters", schema);
 
         cJSON *wrapper = cJSON_CreateObject();
         cJSON_AddStringToObject(wrapper, "type", "function");
         cJSON_AddItemToObject(wrapper, "function", fn);
         cJSON_AddItemToArray(out, wrapper);
     }
-
-    cJSON_Delete(src);
     return out;
 }
 
+/* The elements of the JSON array in `json`, without its brackets. NULL
+ * if it isn't an array; *len = 0 if it's empty. */
+static const char *array_items(const char *json, size_t *len) {
+    if (!json) return NULL;
+    while (*json == ' ' || *json == '\n' || *json == '\t' || *json == '\r') json++;
+    if (*json != '[') return NULL;
+    const char *end = json + strlen(json);
+    while (end > json + 1 && end[-1] != ']') end--;
+    if (end == json + 1) return NULL;
+    const char *items = json + 1;
+    end--;
+    while (items < end && (*items == ' ' || *items == '\n' || *items == '\t' || *items == '\r'))
+        items++;
+    *len = (size_t)(end - items);
+    return items;
+}
+
+/* Append `n` bytes to a string from `a` that grows by doubling. */
+static char *str_append(Arena *a, char *buf, size_t *len, size_t *cap,
+                        const char *s, size_t n) {
+    if (*len + n + 1 > *cap) {
+        size_t want = (*len + n + 1) * 2;
+        char *p = arena_realloc(a, buf, *cap, want < 256 ? 256 : want);
+        if (!p) return buf;
+        buf = p;
+        *cap = want < 256 ? 256 : want;
+    }
+    memcpy(buf + *len, s, n);
+    *len += n;
+    buf[*len] = '\0';
+    return buf;
+}
+
 /*
- * Build OpenAI request body.
- * Messages are in Anthropic format (role/content), which is mostly compatible.
- * We prepend a system message if provided.
+ * Build OpenAI request body as segments.
+ * Messages are in Anthropic format (role/content), which is mostly compatible,
+ * so they're spliced in as is. We prepend a system message if provided,
+ * also spliced in uncopied. The rest comes from `a`.
  */
-static char *build_request_body(const char *model, const char *system_prompt,
-                                const char *messages_json, const char *tools_json,
-                                float temperature, bool stream) {
+static Rope build_request_body(Arena *a, const char *model, SystemPrompt system,
+                               const char *messages_json, const char *tools_json,
+                               float temperature, bool stream) {
+    Arena *prev = arena_json_use(a);
     cJSON *root = cJSON_CreateObject();
     cJSON_AddStringToObject(root, "model", model);
     cJSON_AddNumberToObject(root, "max_tokens", MAX_TOKENS);
     cJSON_AddNumberToObject(root, "temperature", (double)temperature);
     if (stream) cJSON_AddBoolToObject(root, "stream", 1);
 
-    /* Build messages array with system prompt prepended */
-    cJSON *msgs = cJSON_CreateArray();
-
-    if (system_prompt && system_prompt[0]) {
-        cJSON *sys = cJSON_CreateObject();
-        cJSON_AddStringToObject(sys, "role", "system");
-        cJSON_AddStringToObject(sys, "content", system_prompt);
-        cJSON_AddItemToArray(msgs, sys);
-    }
+    /* Convert and add tools */
+    cJSON *tools = convert_tools(tools_json);
+    if (tools && cJSON_GetArraySize(tools) > 0)
+        cJSON_AddItemToObject(root, "tools", tools);
+    char *head = cJSON_PrintUnformatted(root);
 
-    cJSON *user_msgs = cJSON_Parse(messages_json);
-    if (user_msgs && cJSON_IsArray(user_msgs)) {
-        cJSON *m;
-        cJSON_ArrayForEach(m, user_msgs) {
-            cJSON_AddItemToArray(msgs, cJSON_Duplicate(m, 1));
-        }
-        cJSON_Delete(user_msgs);
-    } else {
+    size_t msgs_len = 0;
+    const char *msgs = array_items(messages_json, &msgs_len);
+    if (!msgs) {
         /* Fallback: single user message */
         cJSON *m = cJSON_CreateObject();
         cJSON_AddStringToObject(m, "role", "user");
         cJSON_AddStringToObject(m, "content", messages_json);
-        cJSON_AddItemToArray(msgs, m);
-        cJSON_Delete(user_msgs);
+        msgs = cJSON_PrintUnformatted(m);
+        msgs_len = strlen(msgs);
     }
-
-    cJSON_AddItemToObject(root, "messages", msgs);
-
-    /* Convert and add tools */
-    cJSON *tools = convert_tools(tools_json);
-    if (tools && cJSON_GetArraySize(tools) > 0) {
-        cJSON_AddItemToObject(root, "tools", tools);
-    } else {
-        cJSON_Delete(tools);
+    arena_json_use(prev);
+
+    Rope body = { 0 };
+    rope_adds(&body, "{\"messages\":[");
+    if (system.json && system.len) {
+        rope_adds(&body, "{\"role\":\"system\",\"content\":");
+        rope_add(&body, system.json, system.len);
+        rope_adds(&body, msgs_len ? "}," : "}");
     }
-
-    char *body = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
+    rope_add(&body, msgs, msgs_len);
+    rope_adds(&body, "],");
+    rope_adds(&body, head + 1);  /* Its members and closing brace */
     return body;
 }
 
 /* Parse OpenAI non-streaming response. */
-static ChatResponse parse_response(const char *json_str) {
+static ChatResponse parse_response(Arena *a, const char *json_str) {
     ChatResponse resp = {0};
+    Arena *prev = arena_json_use(a);
     cJSON *root = cJSON_Parse(json_str);
+    arena_json_use(prev);
     if (!root) {
         LOG_ERROR("Failed to parse OpenAI response");
-        resp.text = strdup("Error: failed to parse OpenAI API response");
+        resp.text = arena_strdup(a, "Error: failed to parse OpenAI API response");
         return resp;
     }
 
@@ -117,8 +147,7 @@ static ChatResponse parse_response(const char *json_str) {
     cJSON *err = cJSON_GetObjectItem(root, "error");
     if (err) {
         cJSON *msg = cJSON_GetObjectItem(err, "message");
-        resp.text = strdup(msg ? msg->valuestring : "Unknown OpenAI API error");
-        cJSON_Delete(root);
+        resp.text = msg ? msg->valuestring : arena_strdup(a, "Unknown OpenAI API error");
         return resp;
     }
 
@@ -134,8 +163,7 @@ static ChatResponse parse_response(const char *json_str) {
     /* Choices */
     cJSON *choices = cJSON_GetObjectItem(root, "choices");
     if (!choices || !cJSON_IsArray(choices) || cJSON_GetArraySize(choices) == 0) {
-        resp.text = strdup("Error: no choices in response");
-        cJSON_Delete(root);
+        resp.text = arena_strdup(a, "Error: no choices in response");
         return resp;
     }
 
@@ -144,52 +172,52 @@ static ChatResponse parse_response(const char *json_str) {
     if (finish && finish->valuestring) {
         /* Map OpenAI finish reasons to Anthropic-style */
         if (!strcmp(finish->valuestring, "stop"))
-            resp.stop_reason = strdup("end_turn");
+            resp.stop_reason = arena_strdup(a, "end_turn");
         else if (!strcmp(finish->valuestring, "tool_calls"))
-            resp.stop_reason = strdup("tool_use");
+            resp.stop_reason = arena_strdup(a, "tool_use");
         else
-            resp.stop_reason = strdup(finish->valuestring);
+            resp.stop_reason = finish->valuestring;
     }
 
     cJSON *message = cJSON_GetObjectItem(choice, "message");
-    if (!message) { cJSON_Delete(root); return resp; }
+    if (!message) return resp;
 
     /* Text content */
     cJSON *content = cJSON_GetObjectItem(message, "content");
     if (content && content->valuestring && content->valuestring[0]) {
-        resp.text = strdup(content->valuestring);
+        resp.text = content->valuestring;
     }
 
     /* Tool calls */
     cJSON *tool_calls = cJSON_GetObjectItem(message, "tool_calls");
     if (tool_calls && cJSON_IsArray(tool_calls)) {
         int n = cJSON_GetArraySize(tool_calls);
-        resp.tool_calls = calloc((size_t)n, sizeof(ToolCall));
+        resp.tool_calls = arena_alloc(a, (size_t)n * sizeof(ToolCall));
+        memset(resp.tool_calls, 0, (size_t)n * sizeof(ToolCall));
         resp.num_tools = n;
         for (int i = 0; i < n; i++) {
             cJSON *tc = cJSON_GetArrayItem(tool_calls, i);
             cJSON *id = cJSON_GetObjectItem(tc, "id");
             cJSON *fn = cJSON_GetObjectItem(tc, "function");
-            if (id) resp.tool_calls[i].id = strdup(id->valuestring);
+            if (id) resp.tool_calls[i].id = id->valuestring;
             if (fn) {
                 cJSON *name = cJSON_GetObjectItem(fn, "name");
                 cJSON *args = cJSON_GetObjectItem(fn, "arguments");
-                if (name) resp.tool_calls[i].name = strdup(name->valuestring);
-                if (args) resp.tool_calls[i].input_json = strdup(args->valuestring);
+                if (name) resp.tool_calls[i].name = name->valuestring;
+                if (args) resp.tool_calls[i].input_json = args->valuestring;
             }
         }
     }
 
-    cJSON_Delete(root);
     return resp;
 }
 
-ChatResponse openai_chat(HttpClient *http, const char *api_key,
-                          const char *model, const char *system_prompt,
+ChatResponse openai_chat(HttpClient *http, Arena *arena, const char *api_key,
+                          const char *model, SystemPrompt system,
                           const char *messages_json, const char *tools_json,
                           float temperature) {
-    char *body = build_request_body(model, system_prompt, messages_json,
-                                    tools_json, temperature, false);
+    Rope body = build_request_body(arena, model, system, messages_json,
+                                   tools_json, temperature, false);
 
     char auth[300];
     snprintf(auth, sizeof(auth), "Bearer %s", api_key);
@@ -198,26 +226,21 @@ ChatResponse openai_chat(HttpClient *http, const char *api_key,
         "Authorization", auth,
     };
 
-    HttpResponse hr = http_post_json(http, OPENAI_URL, body, headers, 1);
-    free(body);
-
-    ChatResponse resp;
-    if (hr.body) {
-        resp = parse_response(hr.body);
-    } else {
-        memset(&resp, 0, sizeof(resp));
-        resp.text = strdup("Error: no response from OpenAI API");
-    }
+    HttpResponse hr = http_post_json_iov(http, arena, OPENAI_URL, body.seg, body.n, headers, 1);
+    rope_free(&body);
 
-    http_response_free(&hr);
-    return resp;
+    if (hr.body) return parse_response(arena, hr.body);
+    return (ChatResponse){ .text = arena_strdup(arena, "Error: no response from OpenAI API") };
 }
 
 /* Streaming state */
 typedef struct {
     StreamTextCb user_cb;
     void        *userdata;
+    Arena       *arena;   /* The response */
+    Arena        events;  /* Each event's parse, reset for the next */
     ChatResponse resp;
+    size_t text_len, text_cap;
     /* Tool call accumulation (OpenAI streams tool calls incrementally) */
     int   current_tool_idx;
     char *tool_ids[32];
@@ -234,11 +257,14 @@ static bool oai_stream_cb(const char *data, size_t len, void *ud) {
 
     if (!strcmp(data, "[DONE]")) return false;
 
+    arena_reset(&st->events);
+    Arena *prev = arena_json_use(&st->events);
     cJSON *event = cJSON_Parse(data);
+    arena_json_use(prev);
     if (!event) return true;
 
     cJSON *choices = cJSON_GetObjectItem(event, "choices");
-    if (!choices || cJSON_GetArraySize(choices) == 0) { cJSON_Delete(event); return true; }
+    if (!choices || cJSON_GetArraySize(choices) == 0) return true;
 
     cJSON *choice = cJSON_GetArrayItem(choices, 0);
     cJSON *delta = cJSON_GetObjectItem(choice, "delta");
@@ -246,11 +272,11 @@ static bool oai_stream_cb(const char *data, size_t len, void *ud) {
 
     if (finish && finish->valuestring) {
         if (!strcmp(finish->valuestring, "stop"))
-            st->resp.stop_reason = strdup("end_turn");
+            st->resp.stop_reason = arena_strdup(st->arena, "end_turn");
         else if (!strcmp(finish->valuestring, "tool_calls"))
-            st->resp.stop_reason = strdup("tool_use");
+            st->resp.stop_reason = arena_strdup(st->arena, "tool_use");
         else
-            st->resp.stop_reason = strdup(finish->valuestring);
+            st->resp.stop_reason = arena_strdup(st->arena, finish->valuestring);
     }
 
     if (delta) {
@@ -258,19 +284,10 @@ static bool oai_stream_cb(const char *data, size_t len, void *ud) {
         cJSON *content = cJSON_GetObjectItem(delta, "content");
         if (content && content->valuestring) {
             if (st->user_cb) {
-                if (!st->user_cb(content->valuestring, st->userdata)) {
-                    cJSON_Delete(event);
-                    return false;
-                }
-            }
-            if (!st->resp.text) {
-                st->resp.text = strdup(content->valuestring);
-            } else {
-                size_t old = strlen(st->resp.text);
-                size_t add = strlen(content->valuestring);
-                st->resp.text = realloc(st->resp.text, old + add + 1);
-                memcpy(st->resp.text + old, content->valuestring, add + 1);
+                if (!st->user_cb(content->valuestring, st->userdata)) return false;
             }
+            st->resp.text = str_append(st->arena, st->resp.text, &st->text_len, &st->text_cap,
+                                       content->valuestring, strlen(content->valuestring));
         }
 
         /* Tool calls delta */
@@ -280,33 +297,24 @@ static bool oai_stream_cb(const char *data, size_t len, void *ud) {
             cJSON_ArrayForEach(tc, tool_calls) {
                 cJSON *idx_j = cJSON_GetObjectItem(tc, "index");
                 int idx = idx_j ? idx_j->valueint : 0;
-                if (idx >= 32) continue;
+                if (idx < 0 || idx >= 32) continue;
 
                 if (idx >= st->num_tools) st->num_tools = idx + 1;
 
                 cJSON *id = cJSON_GetObjectItem(tc, "id");
-                if (id && id->valuestring) {
-                    free(st->tool_ids[idx]);
-                    st->tool_ids[idx] = strdup(id->valuestring);
-                }
+                if (id && id->valuestring) st->tool_ids[idx] = arena_strdup(st->arena, id->valuestring);
 
                 cJSON *fn = cJSON_GetObjectItem(tc, "function");
                 if (fn) {
                     cJSON *name = cJSON_GetObjectItem(fn, "name");
-                    if (name && name->valuestring) {
-                        free(st->tool_names[idx]);
-                        st->tool_names[idx] = strdup(name->valuestring);
-                    }
+                    if (name && name->valuestring)
+                        st->tool_names[idx] = arena_strdup(st->arena, name->valuestring);
                     cJSON *args = cJSON_GetObjectItem(fn, "arguments");
                     if (args && args->valuestring) {
-                        size_t alen = strlen(args->valuestring);
-                        if (st->tool_args_len[idx] + alen >= st->tool_args_cap[idx]) {
-                            st->tool_args_cap[idx] = (st->tool_args_cap[idx] + alen) * 2 + 64;
-                            st->tool_args[idx] = realloc(st->tool_args[idx], st->tool_args_cap[idx]);
-                        }
-                        memcpy(st->tool_args[idx] + st->tool_args_len[idx], args->valuestring, alen);
-                        st->tool_args_len[idx] += alen;
-                        st->tool_args[idx][st->tool_args_len[idx]] = '\0';
+                        st->tool_args[idx] = str_append(st->arena, st->tool_args[idx],
+                                                        &st->tool_args_len[idx],
+                                                        &st->tool_args_cap[idx],
+                                                        args->valuestring, strlen(args->valuestring));
                     }
                 }
             }
@@ -322,17 +330,16 @@ static bool oai_stream_cb(const char *data, size_t len, void *ud) {
         if (ct) st->resp.output_tokens = ct->valueint;
     }
 
-    cJSON_Delete(event);
     return true;
 }
 
-ChatResponse openai_chat_stream(HttpClient *http, const char *api_key,
-                                const char *model, const char *system_prompt,
+ChatResponse openai_chat_stream(HttpClient *http, Arena *arena, const char *api_key,
+                                const char *model, SystemPrompt system,
                                 const char *messages_json, const char *tools_json,
                                 float temperature,
                                 StreamTextCb cb, void *userdata) {
-    char *body = build_request_body(model, system_prompt, messages_json,
-                                    tools_json, temperature, true);
+    Rope body = build_request_body(arena, model, system, messages_json,
+                                   tools_json, temperature, true);
 
     char auth[300];
     snprintf(auth, sizeof(auth), "Bearer %s", api_key);
@@ -344,13 +351,16 @@ ChatResponse openai_chat_stream(HttpClient *http, const char *api_key,
     OaiStreamState st = {0};
     st.user_cb = cb;
     st.userdata = userdata;
+    st.arena = arena;
+    st.events = arena_new(16 * 1024);
 
-    http_post_stream(http, OPENAI_URL, body, headers, 1, oai_stream_cb, &st);
-    free(body);
+    http_post_stream_iov(http, OPENAI_URL, body.seg, body.n, headers, 1, oai_stream_cb, &st);
+    rope_free(&body);
+    arena_free(&st.events);
 
     /* Finalize tool calls */
     if (st.num_tools > 0) {
-        st.resp.tool_calls = calloc((size_t)st.num_tools, sizeof(ToolCall));
+        st.resp.tool_calls = arena_alloc(arena, (size_t)st.num_tools * sizeof(ToolCall));
         st.resp.num_tools = st.num_tools;
         for (int i = 0; i < st.num_tools; i++) {
             st.resp.tool_calls[i].id = st.tool_ids[i];
@@ -6,18 +6,20 @@
 
 /* OpenAI Chat Completions API (non-streaming). */
 ChatResponse openai_chat(HttpClient *http,
+                         Arena *arena,
                          const char *api_key,
                          const char *model,
-                         const char *system_prompt,
+                         SystemPrompt system,
                          const char *messages_json,
                          const char *tools_json,
                          float temperature);
 
 /* OpenAI Chat Completions API (streaming). */
 ChatResponse openai_chat_stream(HttpClient *http,
+                                Arena *arena,
                                 const char *api_key,
                                 const char *model,
-                                const char *system_prompt,
+                                SystemPrompt system,
                                 const char *messages_json,
                                 const char *tools_json,
                                 float temperature,
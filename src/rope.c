@@ -0,0 +1,36 @@
+#include "rope.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MEM_TAG MEM_OTHER
+#include "mem.h"
+
+void rope_add(Rope *r, const void *data, size_t len) {
+    if (!len) return;
+    if (r->n == r->cap) {
+        r->cap = r->cap ? r->cap * 2 : 16;
+        r->seg = realloc(r->seg, (size_t)r->cap * sizeof(*r->seg));
+    }
+    r->seg[r->n++] = (struct iovec){ (void *)data, len };
+    r->len += len;
+}
+
+void rope_adds(Rope *r, const char *s) {
+    rope_add(r, s, strlen(s));
+}
+
+char *rope_join(const Rope *r, Arena *a) {
+    char *out = a ? arena_alloc(a, r->len + 1) : malloc(r->len + 1);
+    char *p = out;
+    for (int i = 0; i < r->n; i++) {
+        memcpy(p, r->seg[i].iov_base, r->seg[i].iov_len);
+        p += r->seg[i].iov_len;
+    }
+    *p = '\0';
+    return out;
+}
+
+void rope_free(Rope *r) {
+    free(r->seg);
+    *r = (Rope){ 0 };
+}
@@ -0,0 +1,27 @@
+#ifndef CCLAW_ROPE_H
+#define CCLAW_ROPE_H
+
+#include "arena.h"
+#include <stddef.h>
+#include <sys/uio.h>
+
+/* A string kept as a list of segments pointing at memory owned by the
+ * caller, so large pieces are joined once at their exact size, or handed
+ * to writev-style APIs without being joined at all. Zero-initialise. */
+typedef struct {
+    struct iovec *seg;
+    int           n, cap;
+    size_t        len;  /* Total bytes */
+} Rope;
+
+/* Append by reference; the memory must outlive the rope. */
+void rope_add(Rope *r, const void *data, size_t len);
+void rope_adds(Rope *r, const char *s);
+
+/* Copy the segments into one NUL-terminated string of exactly len + 1
+ * bytes, from the arena (or malloc if a is NULL). */
+char *rope_join(const Rope *r, Arena *a);
+
+void rope_free(Rope *r);
+
+#endif
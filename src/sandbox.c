@@ -0,0 +1,626 @@
+/*
+ * Namespace sandbox for shell commands.
+ *
+ * At startup the agent forks a zygote that enters a new user and mount
+ * namespace (and a network namespace when networking is off), bind-mounts
+ * the host's / read-only under a private root, hides home directories
+ * behind empty tmpfs mounts, mounts the workspace read-write and a
+ * private /tmp, and pivots into that root. This is done once.
+ *
+ * Per command, the agent sends the zygote argv, cwd and stdio over a
+ * SOCK_SEQPACKET socket (fds via SCM_RIGHTS) together with the child end
+ * of a control socket. The zygote clone()s an init process into a new
+ * PID and mount namespace and replies with its host pid, so the agent
+ * can apply cgroup and rlimits before sending 'go'. Init mounts a fresh
+ * /proc, forks the command with no capabilities, no_new_privs and a
+ * seccomp filter, and writes its wait status to the control socket when
+ * it exits. When init exits, the kernel kills whatever the command left
+ * in the namespace; when the agent closes or shuts down the control
+ * socket, init kills everything first.
+ */
+
+#include "sandbox.h"
+#include "log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#define MEM_TAG MEM_TOOLS
+#include "mem.h"
+
+#define MSG_MAX (160 * 1024)  /* Request size; one argument is capped at 128KB by exec anyway */
+
+#ifndef AT_RECURSIVE
+#define AT_RECURSIVE 0x8000
+#endif
+#ifndef MOUNT_ATTR_RDONLY
+#define MOUNT_ATTR_RDONLY 0x00000001
+#endif
+#ifndef SYS_mount_setattr
+#define SYS_mount_setattr 442
+#endif
+
+#if defined(__x86_64__)
+#define SECCOMP_ARCH AUDIT_ARCH_X86_64
+#elif defined(__aarch64__)
+#define SECCOMP_ARCH AUDIT_ARCH_AARCH64
+#endif
+
+extern char **environ;
+
+static struct {
+    pthread_mutex_t lock;   /* One request/reply on the zygote socket at a time */
+    int    sock;            /* To the zygote; -1 = not running */
+    pid_t  zygote;
+    char   dir[64];         /* /tmp/cclaw-sandbox-XXXXXX */
+    char   tmp[80];         /* dir/tmp, the sandbox's /tmp */
+    char   workspace[PATH_MAX];
+    bool   network;
+    char **env;             /* Zygote only: environment for commands */
+} g_sb = { .lock = PTHREAD_MUTEX_INITIALIZER, .sock = -1 };
+
+/* ── Zygote: building the root ─────────────────────────────── */
+
+static bool fail(char *err, size_t n, const char *what, const char *arg) {
+    snprintf(err, n, "%s %s: %s", what, arg, strerror(errno));
+    return false;
+}
+
+static bool write_file(const char *path, const char *text) {
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    ssize_t n = write(fd, text, strlen(text));
+    close(fd);
+    return n == (ssize_t)strlen(text);
+}
+
+static void mkdirs(char *path) {
+    for (char *p = path + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(path, 0755);
+        *p = '/';
+    }
+    mkdir(path, 0755);
+}
+
+/* Undo mountinfo's octal escapes (\040 for space) in place. */
+static void unescape(char *s) {
+    char *w = s;
+    for (char *r = s; *r; r++) {
+        if (r[0] == '\\' && r[1] >= '0' && r[1] <= '3' && r[2] && r[3]) {
+            *w++ = (char)((r[1] - '0') * 64 + (r[2] - '0') * 8 + (r[3] - '0'));
+            r += 3;
+        } else {
+            *w++ = *r;
+        }
+    }
+    *w = '\0';
+}
+
+/* Make every mount under `root` read-only. mount_setattr() does it in one
+ * call (Linux 5.12+); otherwise each mount is remounted, keeping the
+ * nosuid/nodev/noexec flags that a user namespace may not clear. */
+static bool make_readonly(const char *root, char *err, size_t n) {
+    struct { uint64_t attr_set, attr_clr, propagation, userns_fd; } attr = { MOUNT_ATTR_RDONLY, 0, 0, 0 };
+    if (syscall(SYS_mount_setattr, AT_FDCWD, root, AT_RECURSIVE, &attr, sizeof(attr)) == 0)
+        return true;
+
+    FILE *f = fopen("/proc/self/mountinfo", "re");
+    if (!f) return fail(err, n, "open", "/proc/self/mountinfo");
+    size_t rlen = strlen(root);
+    char line[4096], mp[4096];
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%*s %*s %*s %*s %4095s", mp) != 1) continue;
+        unescape(mp);
+        if (strncmp(mp, root, rlen) || (mp[rlen] && mp[rlen] != '/')) continue;
+
+        unsigned long flags = MS_BIND | MS_REMOUNT | MS_RDONLY;
+        struct statvfs sv;
+        if (statvfs(mp, &sv) == 0) {
+            if (sv.f_flag & ST_NOSUID)     flags |= MS_NOSUID;
+            if (sv.f_flag & ST_NODEV)      flags |= MS_NODEV;
+            if (sv.f_flag & ST_NOEXEC)     flags |= MS_NOEXEC;
+            if (sv.f_flag & ST_NOATIME)    flags |= MS_NOATIME;
+            if (sv.f_flag & ST_NODIRATIME) flags |= MS_NODIRATIME;
+            if (sv.f_flag & ST_RELATIME)   flags |= MS_RELATIME;
+        }
+        if (mount(NULL, mp, NULL, flags, NULL) < 0) ok = fail(err, n, "remount read-only", mp);
+    }
+    fclose(f);
+    return ok;
+}
+
+static void loopback_up(void) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return;
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "lo");
+    if (ioctl(fd, SIOCGIFFLAGS, &ifr) == 0) {
+        ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+        ioctl(fd, SIOCSIFFLAGS, &ifr);
+    }
+    close(fd);
+}
+
+/* Environment for commands: locale and terminal basics, nothing else the
+ * agent holds (API keys, tokens). */
+static char **scrubbed_env(void) {
+    static const char *keep[] = { "PATH=", "LANG=", "LC_", "TZ=", "USER=", "LOGNAME=", NULL };
+    size_t n = 0, cap = 16;
+    char **env = malloc(cap * sizeof(char *));
+    for (char **e = environ; *e; e++) {
+        for (int k = 0; keep[k]; k++) {
+            if (strncmp(*e, keep[k], strlen(keep[k]))) continue;
+            if (n + 6 >= cap) env = realloc(env, (cap *= 2) * sizeof(char *));
+            env[n++] = strdup(*e);
+            break;
+        }
+    }
+    if (!getenv("PATH")) env[n++] = strdup("PATH=/usr/local/bin:/usr/bin:/bin");
+    size_t hlen = strlen(g_sb.workspace) + 6;
+    char *home = malloc(hlen);
+    snprintf(home, hlen, "HOME=%s", g_sb.workspace);
+    env[n++] = home;
+    env[n++] = strdup("TMPDIR=/tmp");
+    env[n++] = strdup("SHELL=/bin/sh");
+    env[n++] = strdup("TERM=dumb");
+    env[n] = NULL;
+    return env;
+}
+
+static bool build_root(uid_t uid, gid_t gid, char *err, size_t n) {
+    int flags = CLONE_NEWUSER | CLONE_NEWNS | (g_sb.network ? 0 : CLONE_NEWNET);
+    if (unshare(flags) < 0) return fail(err, n, "unshare", "(user namespaces disabled?)");
+
+    char map[64];
+    snprintf(map, sizeof(map), "%u %u 1\n", (unsigned)uid, (unsigned)uid);
+    if (!write_file("/proc/self/uid_map", map)) return fail(err, n, "write", "uid_map");
+    write_file("/proc/self/setgroups", "deny");
+    snprintf(map, sizeof(map), "%u %u 1\n", (unsigned)gid, (unsigned)gid);
+    if (!write_file("/proc/self/gid_map", map)) return fail(err, n, "write", "gid_map");
+    if (!g_sb.network) loopback_up();
+
+    char root[PATH_MAX], path[PATH_MAX * 2];
+    snprintf(root, sizeof(root), "%s/root", g_sb.dir);
+    if (mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) < 0) return fail(err, n, "make private", "/");
+    if (mount("/", root, NULL, MS_BIND | MS_REC, NULL) < 0) return fail(err, n, "bind", "/");
+    if (!make_readonly(root, err, n)) return false;
+
+    snprintf(path, sizeof(path), "%s/tmp", root);
+    if (mount(g_sb.tmp, path, NULL, MS_BIND, NULL) < 0) return fail(err, n, "bind", path);
+    snprintf(path, sizeof(path), "%s/dev/shm", root);
+    struct stat st;
+    if (stat(path, &st) == 0 && mount("tmpfs", path, "tmpfs", MS_NOSUID | MS_NODEV, "mode=1777") < 0)
+        return fail(err, n, "mount tmpfs", path);
+
+    /* Hide home directories (keys, agent config, other projects). Later
+     * entries may already be hidden by earlier ones. */
+    const char *hide[] = { "/home", "/root", "/run/user", getenv("HOME"), NULL };
+    char hidden[4][PATH_MAX * 2];
+    int nhidden = 0;
+    for (int i = 0; hide[i]; i++) {
+        if (!hide[i][0] || !strcmp(hide[i], "/")) continue;
+        snprintf(hidden[nhidden], sizeof(hidden[0]), "%s%s", root, hide[i]);
+        if (stat(hidden[nhidden], &st) < 0 || !S_ISDIR(st.st_mode)) continue;
+        if (mount("tmpfs", hidden[nhidden], "tmpfs", MS_NOSUID | MS_NODEV, "mode=0755,size=64k") < 0)
+            return fail(err, n, "mount tmpfs", hide[i]);
+        nhidden++;
+    }
+
+    /* The workspace, read-write; its mount point may lie in a tmpfs. */
+    snprintf(path, sizeof(path), "%s%s", root, g_sb.workspace);
+    mkdirs(path);
+    if (mount(g_sb.workspace, path, NULL, MS_BIND | MS_REC, NULL) < 0)
+        return fail(err, n, "bind", g_sb.workspace);
+    for (int i = 0; i < nhidden; i++)
+        mount(NULL, hidden[i], NULL, MS_REMOUNT | MS_RDONLY | MS_NOSUID | MS_NODEV, NULL);
+
+    if (chdir(root) < 0) return fail(err, n, "chdir", root);
+    if (syscall(SYS_pivot_root, ".", ".") < 0) return fail(err, n, "pivot_root", root);
+    if (umount2(".", MNT_DETACH) < 0) return fail(err, n, "detach", "old root");
+    if (chdir("/") < 0) return fail(err, n, "chdir", "/");
+    return true;
+}
+
+/* ── Zygote: running commands ─────────────────────────────── */
+
+/* Deny syscalls that reconfigure the sandbox or reach into the kernel or
+ * other processes: namespace and mount changes, module and kexec loading,
+ * tracing, keyrings, BPF, clock and swap changes. They fail with EPERM;
+ * syscalls from another ABI (x32, i386) kill the process. */
+static const int g_denied[] = {
+    SYS_mount, SYS_umount2, SYS_pivot_root, SYS_chroot, SYS_unshare, SYS_setns,
+    SYS_ptrace, SYS_process_vm_readv, SYS_process_vm_writev,
+    SYS_kexec_load, SYS_init_module, SYS_finit_module, SYS_delete_module,
+    SYS_bpf, SYS_perf_event_open, SYS_userfaultfd, SYS_keyctl, SYS_add_key, SYS_request_key,
+    SYS_reboot, SYS_swapon, SYS_swapoff, SYS_acct, SYS_quotactl, SYS_syslog,
+    SYS_open_by_handle_at, SYS_settimeofday, SYS_clock_settime, SYS_clock_adjtime, SYS_adjtimex,
+    SYS_vhangup,
+#ifdef SYS_kexec_file_load
+    SYS_kexec_file_load,
+#endif
+#ifdef SYS_open_tree
+    SYS_open_tree, SYS_move_mount, SYS_fsopen, SYS_fsconfig, SYS_fsmount, SYS_fspick,
+#endif
+    SYS_mount_setattr,
+#ifdef SYS_iopl
+    SYS_iopl, SYS_ioperm,
+#endif
+};
+
+#define NS_FLAGS (CLONE_NEWUSER | CLONE_NEWNS | CLONE_NEWPID | CLONE_NEWNET | \
+                  CLONE_NEWUTS | CLONE_NEWIPC | CLONE_NEWCGROUP)
+#define ARG_LO(k) (offsetof(struct seccomp_data, args) + (k) * sizeof(uint64_t))  /* Little-endian */
+
+static bool install_seccomp(void) {
+#ifdef SECCOMP_ARCH
+    struct sock_filter f[2 * sizeof(g_denied) / sizeof(g_denied[0]) + 24];
+    size_t n = 0;
+    f[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch));
+    f[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SECCOMP_ARCH, 1, 0);
+    f[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS);
+    f[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr));
+#ifdef __x86_64__
+    f[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0x40000000, 0, 1);  /* x32 */
+    f[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS);
+#endif
+    for (size_t i = 0; i < sizeof(g_denied) / sizeof(g_denied[0]); i++) {
+        f[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)g_denied[i], 0, 1);
+        f[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | EPERM);
+    }
+#ifdef SYS_clone3
+    /* clone3 passes flags in memory the filter can't read; libc falls
+     * back to clone. */
+    f[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SYS_clone3, 0, 1);
+    f[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | ENOSYS);
+#endif
+    /* clone() into new namespaces */
+    f[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SYS_clone, 0, 4);
+    f[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, ARG_LO(0));
+    f[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, NS_FLAGS, 0, 1);
+    f[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | EPERM);
+    f[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+    /* TIOCSTI: pushing input into a terminal outside the sandbox */
+    f[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SYS_ioctl, 0, 3);
+    f[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, ARG_LO(1));
+    f[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, TIOCSTI, 0, 1);
+    f[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | EPERM);
+    f[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+
+    struct sock_fprog prog = { (unsigned short)n, f };
+    return prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) == 0;
+#else
+    return true;  /* No filter for this architecture; namespaces still apply */
+#endif
+}
+
+static void close_from(int lowfd) {
+#ifdef SYS_close_range
+    if (syscall(SYS_close_range, lowfd, ~0U, 0) == 0) return;
+#endif
+    for (int fd = lowfd; fd < 1024; fd++) close(fd);
+}
+
+/* In the command's process: stdio, no privileges, exec. */
+static void exec_command(int fds[3], const char *cwd, char *const argv[]) {
+    /* Move the fds clear of 0-2 first, so dup2() can't clobber one. */
+    for (int i = 0; i < 3; i++) fds[i] = fcntl(fds[i], F_DUPFD, 10);
+    for (int i = 0; i < 3; i++) dup2(fds[i], i);
+    close_from(3);
+    setsid();
+    if (chdir(cwd) < 0 && chdir(g_sb.workspace) < 0) chdir("/");
+
+    for (int cap = 0; prctl(PR_CAPBSET_READ, cap) >= 0; cap++) prctl(PR_CAPBSET_DROP, cap);
+    prctl(PR_CAP_AMBIENT, PR_CAP_AMBIENT_CLEAR_ALL, 0, 0, 0);
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) < 0 || !install_seccomp()) {
+        dprintf(2, "sandbox: cannot install seccomp filter: %s\n", strerror(errno));
+        _exit(126);
+    }
+    sigset_t none;
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+    execve("/bin/sh", argv, g_sb.env);
+    dprintf(2, "sandbox: cannot exec /bin/sh: %s\n", strerror(errno));
+    _exit(127);
+}
+
+/* PID 1 of a command's namespace. */
+static void run_init(int ctl, int fds[3], const char *cwd, char *const argv[]) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    prctl(PR_SET_NAME, "cclaw-init");
+    signal(SIGCHLD, SIG_DFL);
+
+    /* A /proc for this namespace; the host's would show (and expose the
+     * environment of) every process of the user. */
+    if (mount("proc", "/proc", "proc", MS_NOSUID | MS_NODEV | MS_NOEXEC, NULL) < 0 &&
+        mount("tmpfs", "/proc", "tmpfs", MS_RDONLY | MS_NOSUID | MS_NODEV | MS_NOEXEC, "size=4k") < 0) {
+        dprintf(fds[2], "sandbox: cannot mount /proc: %s\n", strerror(errno));
+        _exit(1);
+    }
+
+    sigset_t chld;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, NULL);
+    int sfd = signalfd(-1, &chld, SFD_CLOEXEC | SFD_NONBLOCK);
+
+    char go;
+    if (sfd < 0 || recv(ctl, &go, 1, 0) != 1 || go != 'g') _exit(1);
+
+    pid_t child = fork();
+    if (child == 0) exec_command(fds, cwd, argv);
+    for (int i = 0; i < 3; i++) close(fds[i]);
+    if (child < 0) _exit(1);
+
+    for (;;) {
+        struct pollfd p[2] = { { ctl, POLLIN, 0 }, { sfd, POLLIN, 0 } };
+        if (poll(p, 2, -1) < 0) continue;
+        if (p[0].revents) {  /* Agent closed the control socket or asked to kill */
+            kill(-1, SIGKILL);
+            _exit(0);
+        }
+        struct signalfd_siginfo si;
+        while (read(sfd, &si, sizeof(si)) > 0) {}
+        int status;
+        pid_t w;
+        while ((w = waitpid(-1, &status, WNOHANG)) > 0) {
+            if (w != child) continue;
+            send(ctl, &status, sizeof(status), MSG_NOSIGNAL);
+            _exit(0);  /* Takes the rest of the namespace with it */
+        }
+    }
+}
+
+/* Handle one request: "cwd\0arg0\0arg1\0..." with stdin, stdout, stderr
+ * and the control socket attached. Replies with init's pid or -errno. */
+static void serve_one(int sock, char *buf, ssize_t len, int *fds, int nfds, bool truncated) {
+    int reply;
+    char *argv[1024];
+    int argc = 0;
+    if (truncated || nfds != 4 || len < 2 || buf[len - 1]) {
+        reply = truncated ? -E2BIG : -EINVAL;
+    } else {
+        for (char *p = buf + strlen(buf) + 1; p < buf + len && argc < 1023; p += strlen(p) + 1)
+            argv[argc++] = p;
+        argv[argc] = NULL;
+
+        pid_t pid = (pid_t)syscall(SYS_clone, CLONE_NEWPID | CLONE_NEWNS | SIGCHLD, NULL, NULL, NULL, NULL);
+        if (pid == 0) {
+            close(sock);
+            run_init(fds[3], fds, buf, argv);
+        }
+        reply = pid > 0 ? pid : -errno;
+    }
+    for (int i = 0; i < nfds; i++) close(fds[i]);
+    send(sock, &reply, sizeof(reply), MSG_NOSIGNAL);
+}
+
+static void zygote_main(int sock, uid_t uid, gid_t gid) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    setsid();                   /* Out of the terminal's process group (Ctrl-C) */
+    for (int s = 1; s < NSIG; s++) signal(s, SIG_DFL);
+    signal(SIGCHLD, SIG_IGN);   /* Inits are reaped automatically */
+    sigset_t none;
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+
+    char err[512] = "ok";
+    if (!build_root(uid, gid, err, sizeof(err))) {
+        send(sock, err, strlen(err), MSG_NOSIGNAL);
+        _exit(1);
+    }
+    /* It holds a copy of the agent's memory: no ptrace, no /proc/pid/mem.
+     * (Not before the uid_map writes, which this makes root-owned.) */
+    prctl(PR_SET_DUMPABLE, 0);
+    g_sb.env = scrubbed_env();
+    send(sock, err, strlen(err), MSG_NOSIGNAL);
+
+    char *buf = malloc(MSG_MAX);
+    for (;;) {
+        union { struct cmsghdr h; char b[CMSG_SPACE(4 * sizeof(int))]; } cm;
+        struct iovec iov = { buf, MSG_MAX };
+        struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = cm.b, .msg_controllen = sizeof(cm.b) };
+        ssize_t len = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+        if (len < 0 && errno == EINTR) continue;
+        if (len <= 0) _exit(0);  /* Agent exited */
+
+        int fds[4], nfds = 0;
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+            int got = (int)((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            for (int i = 0; i < got; i++) {
+                int fd;
+                memcpy(&fd, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+                if (nfds < 4) fds[nfds++] = fd;
+                else close(fd);
+            }
+        }
+        serve_one(sock, buf, len, fds, nfds, (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0);
+    }
+}
+
+/* ── Agent side ─────────────────────────────────────────────── */
+
+static int rm_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st; (void)type; (void)ftw;
+    remove(path);
+    return 0;
+}
+
+bool sandbox_init(const SandboxConfig *cfg) {
+    if (!realpath(cfg->workspace, g_sb.workspace)) {
+        LOG_ERROR("sandbox: workspace %s: %s", cfg->workspace, strerror(errno));
+        return false;
+    }
+    g_sb.network = cfg->network;
+
+    snprintf(g_sb.dir, sizeof(g_sb.dir), "/tmp/cclaw-sandbox-XXXXXX");
+    if (!mkdtemp(g_sb.dir)) {
+        LOG_ERROR("sandbox: mkdtemp: %s", strerror(errno));
+        return false;
+    }
+    char root[96];
+    snprintf(root, sizeof(root), "%s/root", g_sb.dir);
+    snprintf(g_sb.tmp, sizeof(g_sb.tmp), "%s/tmp", g_sb.dir);
+    mkdir(root, 0700);
+    mkdir(g_sb.tmp, 0700);
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        LOG_ERROR("sandbox: socketpair: %s", strerror(errno));
+        sandbox_cleanup();
+        return false;
+    }
+    int sndbuf = 2 * MSG_MAX;
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    uid_t uid = getuid();
+    gid_t gid = getgid();
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(sv[0]);
+        zygote_main(sv[1], uid, gid);
+    }
+    close(sv[1]);
+    if (pid < 0) {
+        LOG_ERROR("sandbox: fork: %s", strerror(errno));
+        close(sv[0]);
+        sandbox_cleanup();
+        return false;
+    }
+    g_sb.zygote = pid;
+    g_sb.sock = sv[0];
+
+    char ready[512];
+    ssize_t n = recv(g_sb.sock, ready, sizeof(ready) - 1, 0);
+    ready[n > 0 ? n : 0] = '\0';
+    if (strcmp(ready, "ok")) {
+        LOG_ERROR("sandbox: setup failed: %s", n > 0 ? ready : "zygote exited");
+        sandbox_cleanup();
+        return false;
+    }
+    LOG_INFO("sandbox: ready (zygote %d, workspace %s, network %s)",
+             (int)pid, g_sb.workspace, g_sb.network ? "shared" : "off");
+    return true;
+}
+
+bool sandbox_active(void) {
+    return g_sb.sock >= 0;
+}
+
+const char *sandbox_tmp(void) {
+    return g_sb.tmp;
+}
+
+int sandbox_spawn(char *const argv[], const char *cwd, int in_fd, int out_fd, int err_fd,
+                  SandboxProc *p) {
+    char *buf = malloc(MSG_MAX);
+    size_t len = 0;
+    for (int i = -1; i < 0 || argv[i]; i++) {
+        const char *s = i < 0 ? cwd : argv[i];
+        size_t sl = strlen(s) + 1;
+        if (len + sl > MSG_MAX) { free(buf); return E2BIG; }
+        memcpy(buf + len, s, sl);
+        len += sl;
+    }
+
+    int ctl[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, ctl) < 0) { free(buf); return errno; }
+    int devnull = in_fd < 0 ? open("/dev/null", O_RDONLY | O_CLOEXEC) : -1;
+    int fds[4] = { in_fd < 0 ? devnull : in_fd, out_fd, err_fd, ctl[1] };
+
+    union { struct cmsghdr h; char b[CMSG_SPACE(sizeof(fds))]; } cm;
+    memset(&cm, 0, sizeof(cm));
+    struct iovec iov = { buf, len };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = cm.b, .msg_controllen = sizeof(cm.b) };
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(c), fds, sizeof(fds));
+
+    int reply = -EPIPE;
+    pthread_mutex_lock(&g_sb.lock);
+    if (g_sb.sock >= 0 && sendmsg(g_sb.sock, &msg, MSG_NOSIGNAL) == (ssize_t)len &&
+        recv(g_sb.sock, &reply, sizeof(reply), 0) != sizeof(reply))
+        reply = -EPIPE;
+    pthread_mutex_unlock(&g_sb.lock);
+
+    free(buf);
+    if (devnull >= 0) close(devnull);
+    close(ctl[1]);
+    if (reply <= 0) {
+        if (reply == -EPIPE) LOG_ERROR("sandbox: zygote is gone; commands cannot run");
+        close(ctl[0]);
+        return -reply;
+    }
+    p->pid = reply;
+    p->ctl = ctl[0];
+    return 0;
+}
+
+bool sandbox_resume(SandboxProc *p) {
+    return send(p->ctl, "g", 1, MSG_NOSIGNAL) == 1;
+}
+
+bool sandbox_wait(SandboxProc *p, int *status, bool block) {
+    for (;;) {
+        int st;
+        ssize_t n = recv(p->ctl, &st, sizeof(st), block ? 0 : MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+        *status = n == sizeof(st) ? st : SIGKILL;  /* Init died or was told to kill */
+        return true;
+    }
+}
+
+void sandbox_kill(SandboxProc *p) {
+    shutdown(p->ctl, SHUT_WR);
+}
+
+void sandbox_release(SandboxProc *p) {
+    if (p->ctl >= 0) close(p->ctl);
+    p->ctl = -1;
+}
+
+void sandbox_cleanup(void) {
+    if (g_sb.sock >= 0) {
+        close(g_sb.sock);  /* The zygote exits on EOF */
+        g_sb.sock = -1;
+    }
+    if (g_sb.zygote > 0) {
+        waitpid(g_sb.zygote, NULL, 0);
+        g_sb.zygote = 0;
+    }
+    if (g_sb.dir[0]) {
+        nftw(g_sb.dir, rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+        g_sb.dir[0] = '\0';
+    }
+}
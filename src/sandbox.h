@@ -0,0 +1,54 @@
+#ifndef CCLAW_SANDBOX_H
+#define CCLAW_SANDBOX_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* Isolation for shell commands: each command runs in its own PID
+ * namespace, inside a user and mount namespace where the host is mounted
+ * read-only, home directories are hidden and only the workspace and a
+ * private /tmp are writable, under a seccomp filter. The namespaces are
+ * set up once by a pre-forked zygote, so a command costs one clone(). */
+
+typedef struct {
+    char workspace[512];  /* Mounted read-write at the same path */
+    bool network;         /* Share the host network (false = loopback only) */
+} SandboxConfig;
+
+/* A command running in the sandbox. */
+typedef struct {
+    pid_t pid;  /* Host pid of the sandbox's init, for cgroup and rlimits */
+    int   ctl;  /* Readable once the command exited; closing it kills all */
+} SandboxProc;
+
+/* Fork the zygote and build the sandbox. Call once at startup, before
+ * any threads exist. Returns false (and logs why) if the kernel doesn't
+ * allow unprivileged namespaces. */
+bool sandbox_init(const SandboxConfig *cfg);
+
+bool sandbox_active(void);
+
+/* Host path of the sandbox's /tmp. */
+const char *sandbox_tmp(void);
+
+/* Start /bin/sh with `argv` in `cwd` and the given stdio (in_fd -1 =
+ * /dev/null). It waits for sandbox_resume(), so the caller can confine
+ * p->pid first. Returns 0 or an errno value. */
+int sandbox_spawn(char *const argv[], const char *cwd, int in_fd, int out_fd, int err_fd,
+                  SandboxProc *p);
+
+bool sandbox_resume(SandboxProc *p);
+
+/* Collect the command's wait status once p->ctl is readable (or block
+ * for it). A sandbox that was killed reports SIGKILL. */
+bool sandbox_wait(SandboxProc *p, int *status, bool block);
+
+/* Kill every process in the sandbox; sandbox_wait() then returns. */
+void sandbox_kill(SandboxProc *p);
+
+void sandbox_release(SandboxProc *p);
+
+/* Stop the zygote and remove the sandbox's /tmp. */
+void sandbox_cleanup(void);
+
+#endif
@@ -4,12 +4,18 @@
 #include <string.h>
 #include <stdio.h>
 
+#define MEM_TAG MEM_SESSION
+#include "mem.h"
+
 Session *session_new(const char *workspace, const char *session_id) {
     Session *s = calloc(1, sizeof(*s));
+    MemTag prev = mem_json_tag(MEM_SESSION);
     s->messages = cJSON_CreateArray();
+    mem_json_tag(prev);
     s->count = 0;
 
     if (session_id) {
+        snprintf(s->id, sizeof(s->id), "%s", session_id);
         snprintf(s->session_file, sizeof(s->session_file),
                  "%s/.cclaw/sessions/%s.json", workspace, session_id);
     }
@@ -26,7 +32,9 @@ Session *session_new(const char *workspace, const char *session_id) {
             buf[n] = '\0';
             fclose(fp);
 
+            prev = mem_json_tag(MEM_SESSION);
             cJSON *loaded = cJSON_Parse(buf);
+            mem_json_tag(prev);
             free(buf);
             if (loaded && cJSON_IsArray(loaded)) {
                 cJSON_Delete(s->messages);
@@ -42,15 +50,20 @@ Session *session_new(const char *workspace, const char *session_id) {
     return s;
 }
 
+/* The history's nodes are counted under the session tag, not json */
+
 void session_add_user(Session *s, const char *text) {
+    MemTag prev = mem_json_tag(MEM_SESSION);
     cJSON *msg = cJSON_CreateObject();
     cJSON_AddStringToObject(msg, "role", "user");
     cJSON_AddStringToObject(msg, "content", text);
     cJSON_AddItemToArray(s->messages, msg);
     s->count++;
+    mem_json_tag(prev);
 }
 
 void session_add_assistant(Session *s, const char *text) {
+    MemTag prev = mem_json_tag(MEM_SESSION);
     cJSON *msg = cJSON_CreateObject();
     cJSON_AddStringToObject(msg, "role", "assistant");
     /* Anthropic format: content is an array of blocks */
@@ -61,6 +74,7 @@ void session_add_assistant(Session *s, const char *text) {
     cJSON_AddItemToArray(content, block);
     cJSON_AddItemToArray(s->messages, msg);
     s->count++;
+    mem_json_tag(prev);
 }
 
 void session_add_tool_use(Session *s, const char *tool_id, const char *name, const char *input_json) {
@@ -68,6 +82,7 @@ void session_add_tool_use(Session *s, const char *tool_id, const char *name, con
     cJSON *last = cJSON_GetArrayItem(s->messages, s->count - 1);
     cJSON *role = last ? cJSON_GetObjectItem(last, "role") : NULL;
 
+    MemTag prev = mem_json_tag(MEM_SESSION);
     cJSON *block = cJSON_CreateObject();
     cJSON_AddStringToObject(block, "type", "tool_use");
     cJSON_AddStringToObject(block, "id", tool_id);
@@ -81,6 +96,7 @@ void session_add_tool_use(Session *s, const char *tool_id, const char *name, con
         cJSON *content = cJSON_GetObjectItem(last, "content");
         if (content && cJSON_IsArray(content)) {
             cJSON_AddItemToArray(content, block);
+            mem_json_tag(prev);
             return;
         }
     }
@@ -92,9 +108,11 @@ void session_add_tool_use(Session *s, const char *tool_id, const char *name, con
     cJSON_AddItemToArray(content, block);
     cJSON_AddItemToArray(s->messages, msg);
     s->count++;
+    mem_json_tag(prev);
 }
 
 void session_add_tool_result(Session *s, const char *tool_id, const char *output) {
+    MemTag prev = mem_json_tag(MEM_SESSION);
     cJSON *msg = cJSON_CreateObject();
     cJSON_AddStringToObject(msg, "role", "user");
     cJSON *content = cJSON_AddArrayToObject(msg, "content");
@@ -105,10 +123,14 @@ void session_add_tool_result(Session *s, const char *tool_id, const char *output
     cJSON_AddItemToArray(content, block);
     cJSON_AddItemToArray(s->messages, msg);
     s->count++;
+    mem_json_tag(prev);
 }
 
-char *session_messages_json(Session *s) {
-    return cJSON_PrintUnformatted(s->messages);
+char *session_messages_json(Session *s, Arena *a) {
+    Arena *prev = arena_json_use(a);
+    char *json = cJSON_PrintUnformatted(s->messages);
+    arena_json_use(prev);
+    return json;
 }
 
 void session_save(Session *s) {
@@ -125,7 +147,9 @@ void session_save(Session *s) {
         system(cmd);
     }
 
+    MemTag prev = mem_json_tag(MEM_SESSION);
     char *json = cJSON_Print(s->messages);
+    mem_json_tag(prev);
     FILE *fp = fopen(s->session_file, "w");
     if (fp) {
         fputs(json, fp);
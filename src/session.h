@@ -1,6 +1,7 @@
 #ifndef CCLAW_SESSION_H
 #define CCLAW_SESSION_H
 
+#include "arena.h"
 #include <cJSON.h>
 
 /* In-memory message history as a JSON array.
@@ -8,6 +9,7 @@
 typedef struct {
     cJSON *messages;  /* JSON array of {role, content} objects */
     int    count;
+    char   id[64];            /* Empty for a session that isn't saved */
     char   session_file[512];
 } Session;
 
@@ -16,7 +18,7 @@ void     session_add_user(Session *s, const char *text);
 void     session_add_assistant(Session *s, const char *text);
 void     session_add_tool_use(Session *s, const char *tool_id, const char *name, const char *input_json);
 void     session_add_tool_result(Session *s, const char *tool_id, const char *output);
-char    *session_messages_json(Session *s);  /* Caller frees */
+char    *session_messages_json(Session *s, Arena *a);  /* From `a`; NULL = heap, caller frees */
 void     session_save(Session *s);
 void     session_free(Session *s);
 
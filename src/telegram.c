@@ -5,6 +5,9 @@
 #include <string.h>
 #include <stdio.h>
 
+#define MEM_TAG MEM_OTHER
+#include "mem.h"
+
 #define TG_API "https://api.telegram.org/bot"
 #define MAX_TEXT 4096
 
@@ -28,15 +31,15 @@ static int is_user_allowed(const CClawConfig *cfg, long long from_id, const char
     return 0;
 }
 
-int telegram_send(HttpClient *http, const char *token,
-                  long long chat_id, const char *text) {
+static int send_message(HttpClient *http, const char *token, long long chat_id,
+                        const char *text, const char *parse_mode) {
     char url[512];
     snprintf(url, sizeof(url), "%s%s/sendMessage", TG_API, token);
 
     cJSON *body = cJSON_CreateObject();
     cJSON_AddNumberToObject(body, "chat_id", (double)chat_id);
     cJSON_AddStringToObject(body, "text", text);
-    cJSON_AddStringToObject(body, "parse_mode", "Markdown");
+    if (parse_mode) cJSON_AddStringToObject(body, "parse_mode", parse_mode);
 
     char *json = cJSON_PrintUnformatted(body);
     const char *headers[] = { "Content-Type", "application/json" };
@@ -51,6 +54,16 @@ int telegram_send(HttpClient *http, const char *token,
     return ok ? 0 : -1;
 }
 
+int telegram_send(HttpClient *http, const char *token,
+                  long long chat_id, const char *text) {
+    return send_message(http, token, chat_id, text, "Markdown");
+}
+
+int telegram_send_plain(HttpClient *http, const char *token,
+                        long long chat_id, const char *text) {
+    return send_message(http, token, chat_id, text, NULL);
+}
+
 int telegram_send_typing(HttpClient *http, const char *token, long long chat_id) {
     char url[512];
     snprintf(url, sizeof(url), "%s%s/sendChatAction", TG_API, token);
@@ -68,16 +81,17 @@ int telegram_send_typing(HttpClient *http, const char *token, long long chat_id)
     return 0;
 }
 
-int telegram_poll_loop(HttpClient *http, const CClawConfig *cfg,
-                       TelegramMsgHandler handler, void *userdata) {
+int telegram_poll_loop(HttpClient *http, TelegramMsgHandler handler, void *userdata) {
     long long offset = 0;
     char url[512];
 
     LOG_INFO("Telegram long-polling started");
 
     for (;;) {
+        const CClawConfig *cfg = config_acquire();
         snprintf(url, sizeof(url), "%s%s/getUpdates?timeout=30&offset=%lld",
                  TG_API, cfg->telegram_token, offset);
+        config_release(cfg);
 
         const char *headers[] = { "Content-Type", "application/json" };
         HttpResponse resp = http_get(http, url, headers, 1);
@@ -106,6 +120,8 @@ int telegram_poll_loop(HttpClient *http, const CClawConfig *cfg,
             continue;
         }
 
+        /* One snapshot for the batch, so a reload applies from the next */
+        cfg = config_acquire();
         cJSON *update;
         cJSON_ArrayForEach(update, result) {
             cJSON *uid = cJSON_GetObjectItem(update, "update_id");
@@ -153,6 +169,7 @@ int telegram_poll_loop(HttpClient *http, const CClawConfig *cfg,
                 free(reply);
             }
         }
+        config_release(cfg);
 
         cJSON_Delete(root);
     }
@@ -16,14 +16,18 @@ typedef struct {
 /* Callback when a message arrives. Return the reply text (or NULL). */
 typedef char *(*TelegramMsgHandler)(const TelegramMessage *msg, void *userdata);
 
-/* Start Telegram long-polling loop (blocking). */
-int telegram_poll_loop(HttpClient *http, const CClawConfig *cfg,
-                       TelegramMsgHandler handler, void *userdata);
+/* Start Telegram long-polling loop (blocking). The token and allowlist
+ * come from the live config (config_acquire()), read for every poll. */
+int telegram_poll_loop(HttpClient *http, TelegramMsgHandler handler, void *userdata);
 
 /* Send a text message. */
 int telegram_send(HttpClient *http, const char *token,
                   long long chat_id, const char *text);
 
+/* Send a text message without Markdown parsing (for raw output). */
+int telegram_send_plain(HttpClient *http, const char *token,
+                        long long chat_id, const char *text);
+
 /* Send typing indicator. */
 int telegram_send_typing(HttpClient *http, const char *token, long long chat_id);
 
@@ -0,0 +1,597 @@
+/*
+ * Hierarchical timing wheel for one-shot timers.
+ *
+ * A timer is filed on the lowest level whose range still contains its expiry
+ * relative to the wheel's current time: level L holds timers whose expiry
+ * agrees with `now` on every bit above 6*(L+1), in slot (expires >> 6L) & 63.
+ * When the clock crosses a level-L boundary, that level's current slot is
+ * cascaded down; level 0 slots fire as the clock reaches them. Timers live on
+ * intrusive doubly linked lists, and an id → timer hash makes cancel O(1).
+ *
+ * With a store attached, inserts and deletes are queued and written to SQLite
+ * in one transaction per tick, so a million pending timers cost one fsync per
+ * second rather than one per timer.
+ *
+ * With workers set, timer_advance() hands due timers to a small thread pool
+ * instead of firing them itself, so one slow callback (an agent turn) does
+ * not hold up the others or the tick.
+ */
+
+#include "timer.h"
+#include "log.h"
+#include <sqlite3.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MEM_TAG MEM_OTHER
+#include "mem.h"
+
+/* Clock jumps larger than this rebuild the wheel instead of ticking through */
+#define TIMER_REBUILD_GAP 4096
+
+typedef struct Timer {
+    struct Timer *prev, *next;
+    uint64_t      id;
+    time_t        expires;
+    char         *payload;
+    int           kind;
+} Timer;
+
+typedef struct {
+    char    name[32];
+    TimerFn fn;
+    void   *userdata;
+} TimerKind;
+
+/* Pending store write */
+typedef struct {
+    uint64_t id;
+    bool     insert;
+} TimerOp;
+
+struct TimerWheel {
+    Timer           wheel[TIMER_LEVELS][TIMER_SLOTS]; /* List heads */
+    Timer           expired;    /* Due at or before the current tick */
+    time_t          now;
+    size_t          pending;
+    uint64_t        next_id;
+
+    Timer         **map;        /* id → timer, open addressing */
+    size_t          map_cap;
+    size_t          map_used;   /* Occupied + deleted entries */
+
+    TimerKind       kinds[TIMER_MAX_KINDS];
+    int             num_kinds;
+
+    sqlite3        *db;
+    TimerOp        *ops;
+    size_t          num_ops, ops_cap;
+
+    pthread_mutex_t lock;
+    bool            running;
+
+    /* Worker pool (0 workers = fire on the calling thread). Due timers wait
+     * on `work` and stay in the map, so they can still be cancelled and are
+     * deleted from the store only when a worker picks them up. */
+    int             workers;
+    pthread_t      *worker_threads;
+    bool            pool_live;
+    Timer           work;
+    pthread_cond_t  work_ready;
+};
+
+static Timer map_tombstone;
+#define MAP_DELETED (&map_tombstone)
+
+/* --- Intrusive lists ------------------------------------------------------ */
+
+static void list_init(Timer *head) {
+    head->next = head->prev = head;
+}
+
+static void list_add(Timer *head, Timer *t) {
+    t->prev = head->prev;
+    t->next = head;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+static void list_del(Timer *t) {
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = t->prev = t;
+}
+
+/* Move every entry of `from` onto the end of `to`. */
+static void list_splice(Timer *from, Timer *to) {
+    if (from->next == from) return;
+    from->next->prev = to->prev;
+    from->prev->next = to;
+    to->prev->next = from->next;
+    to->prev = from->prev;
+    list_init(from);
+}
+
+/* --- id → timer map ------------------------------------------------------- */
+
+static size_t map_hash(uint64_t id, size_t cap) {
+    return (size_t)((id * 0x9E3779B97F4A7C15ull) >> 17) & (cap - 1);
+}
+
+static void map_put(TimerWheel *tw, Timer *t);
+
+static void map_grow(TimerWheel *tw) {
+    Timer **old = tw->map;
+    size_t old_cap = tw->map_cap;
+
+    /* Size for the live timers only; rehashing also drops tombstones */
+    tw->map_cap = 1024;
+    while ((tw->pending + 1) * 4 > tw->map_cap) tw->map_cap *= 2;
+    tw->map = calloc(tw->map_cap, sizeof(Timer *));
+    tw->map_used = 0;
+
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i] && old[i] != MAP_DELETED) map_put(tw, old[i]);
+    }
+    free(old);
+}
+
+static void map_put(TimerWheel *tw, Timer *t) {
+    if ((tw->map_used + 1) * 2 > tw->map_cap) map_grow(tw);
+    size_t mask = tw->map_cap - 1;
+    size_t i = map_hash(t->id, tw->map_cap);
+    while (tw->map[i] && tw->map[i] != MAP_DELETED) i = (i + 1) & mask;
+    if (!tw->map[i]) tw->map_used++;
+    tw->map[i] = t;
+}
+
+/* Index of the entry for `id`, or -1. */
+static long map_find(const TimerWheel *tw, uint64_t id) {
+    if (!tw->map_cap) return -1;
+    size_t mask = tw->map_cap - 1;
+    for (size_t i = map_hash(id, tw->map_cap);; i = (i + 1) & mask) {
+        Timer *t = tw->map[i];
+        if (!t) return -1;
+        if (t != MAP_DELETED && t->id == id) return (long)i;
+    }
+}
+
+static void map_del(TimerWheel *tw, uint64_t id) {
+    long i = map_find(tw, id);
+    if (i >= 0) tw->map[i] = MAP_DELETED;
+}
+
+/* --- Wheel ---------------------------------------------------------------- */
+
+/* File a timer on the level/slot for its expiry relative to tw->now. */
+static void place(TimerWheel *tw, Timer *t) {
+    if (t->expires <= tw->now) {
+        list_add(&tw->expired, t);
+        return;
+    }
+
+    uint64_t diff = (uint64_t)t->expires ^ (uint64_t)tw->now;
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 && (diff >> (TIMER_SLOT_BITS * (level + 1)))) level++;
+
+    int slot = (int)(((uint64_t)t->expires >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1));
+    list_add(&tw->wheel[level][slot], t);
+}
+
+/* Advance one second: cascade coarser slots whose boundary was crossed,
+ * then move the level-0 slot for the new second onto the expired list. */
+static void tick(TimerWheel *tw) {
+    uint64_t now = (uint64_t)++tw->now;
+
+    for (int level = 1; level < TIMER_LEVELS; level++) {
+        uint64_t low = ((uint64_t)1 << (TIMER_SLOT_BITS * level)) - 1;
+        if (now & low) break;
+
+        int slot = (int)((now >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1));
+        Timer list;
+        list_init(&list);
+        list_splice(&tw->wheel[level][slot], &list);
+        while (list.next != &list) {
+            Timer *t = list.next;
+            list_del(t);
+            place(tw, t);
+        }
+    }
+
+    list_splice(&tw->wheel[0][now & (TIMER_SLOTS - 1)], &tw->expired);
+}
+
+/* Re-file every timer after a large clock jump. O(n), but rare. */
+static void rebuild(TimerWheel *tw, time_t now) {
+    Timer all;
+    list_init(&all);
+    for (int l = 0; l < TIMER_LEVELS; l++)
+        for (int s = 0; s < TIMER_SLOTS; s++)
+            list_splice(&tw->wheel[l][s], &all);
+
+    tw->now = now;
+    while (all.next != &all) {
+        Timer *t = all.next;
+        list_del(t);
+        place(tw, t);
+    }
+}
+
+static void queue_op(TimerWheel *tw, uint64_t id, bool insert) {
+    if (!tw->db) return;
+    if (tw->num_ops >= tw->ops_cap) {
+        tw->ops_cap = tw->ops_cap ? tw->ops_cap * 2 : 256;
+        tw->ops = realloc(tw->ops, tw->ops_cap * sizeof(TimerOp));
+    }
+    tw->ops[tw->num_ops].id = id;
+    tw->ops[tw->num_ops].insert = insert;
+    tw->num_ops++;
+}
+
+static int find_kind(const TimerWheel *tw, const char *kind) {
+    for (int i = 0; i < tw->num_kinds; i++) {
+        if (!strcmp(tw->kinds[i].name, kind)) return i;
+    }
+    return -1;
+}
+
+static void timer_destroy(Timer *t) {
+    free(t->payload);
+    free(t);
+}
+
+/* --- Public API ----------------------------------------------------------- */
+
+TimerWheel *timer_wheel_new(void) {
+    TimerWheel *tw = calloc(1, sizeof(*tw));
+    if (!tw) return NULL;
+    for (int l = 0; l < TIMER_LEVELS; l++)
+        for (int s = 0; s < TIMER_SLOTS; s++)
+            list_init(&tw->wheel[l][s]);
+    list_init(&tw->expired);
+    list_init(&tw->work);
+    tw->now = time(NULL);
+    tw->next_id = 1;
+    pthread_mutex_init(&tw->lock, NULL);
+    pthread_cond_init(&tw->work_ready, NULL);
+    return tw;
+}
+
+void timer_set_concurrency(TimerWheel *tw, int workers) {
+    pthread_mutex_lock(&tw->lock);
+    tw->workers = workers > 0 ? workers : 0;
+    pthread_mutex_unlock(&tw->lock);
+}
+
+bool timer_register(TimerWheel *tw, const char *kind, TimerFn fn, void *userdata) {
+    pthread_mutex_lock(&tw->lock);
+    int i = find_kind(tw, kind);
+    if (i < 0) {
+        if (tw->num_kinds >= TIMER_MAX_KINDS) {
+            pthread_mutex_unlock(&tw->lock);
+            LOG_ERROR("timer: max kinds (%d) reached", TIMER_MAX_KINDS);
+            return false;
+        }
+        i = tw->num_kinds++;
+        strncpy(tw->kinds[i].name, kind, sizeof(tw->kinds[i].name) - 1);
+    }
+    tw->kinds[i].fn = fn;
+    tw->kinds[i].userdata = userdata;
+    pthread_mutex_unlock(&tw->lock);
+    return true;
+}
+
+bool timer_open_store(TimerWheel *tw, const char *db_path) {
+    sqlite3 *db;
+    if (sqlite3_open(db_path, &db) != SQLITE_OK) {
+        LOG_ERROR("Failed to open timer DB %s: %s", db_path, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return false;
+    }
+
+    const char *sql =
+        "PRAGMA journal_mode=WAL;"
+        "PRAGMA synchronous=NORMAL;"
+        "CREATE TABLE IF NOT EXISTS timers ("
+        "  id INTEGER PRIMARY KEY,"
+        "  kind TEXT NOT NULL,"
+        "  expires INTEGER NOT NULL,"
+        "  payload TEXT"
+        ");";
+
+    char *err = NULL;
+    if (sqlite3_exec(db, sql, NULL, NULL, &err) != SQLITE_OK) {
+        LOG_ERROR("Failed to create timers table: %s", err);
+        sqlite3_free(err);
+        sqlite3_close(db);
+        return false;
+    }
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "SELECT id, kind, expires, payload FROM timers;",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        LOG_ERROR("timer load prepare: %s", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return false;
+    }
+
+    pthread_mutex_lock(&tw->lock);
+    size_t loaded = 0, skipped = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        uint64_t id = (uint64_t)sqlite3_column_int64(stmt, 0);
+        const char *kind = (const char *)sqlite3_column_text(stmt, 1);
+        const char *payload = (const char *)sqlite3_column_text(stmt, 3);
+
+        if (id >= tw->next_id) tw->next_id = id + 1;
+
+        int k = kind ? find_kind(tw, kind) : -1;
+        if (k < 0) { skipped++; continue; } /* Kept in the DB for later */
+
+        Timer *t = calloc(1, sizeof(*t));
+        t->id = id;
+        t->kind = k;
+        t->expires = (time_t)sqlite3_column_int64(stmt, 2);
+        t->payload = strdup(payload ? payload : "");
+        place(tw, t);
+        map_put(tw, t);
+        tw->pending++;
+        loaded++;
+    }
+    tw->db = db;
+    pthread_mutex_unlock(&tw->lock);
+    sqlite3_finalize(stmt);
+
+    LOG_INFO("timer: loaded %zu pending timer(s)", loaded);
+    if (skipped) LOG_WARN("timer: %zu timer(s) of unregistered kinds left in store", skipped);
+    return true;
+}
+
+uint64_t timer_add(TimerWheel *tw, const char *kind, time_t expires, const char *payload) {
+    Timer *t = calloc(1, sizeof(*t));
+    if (!t) return 0;
+    t->expires = expires;
+    t->payload = strdup(payload ? payload : "");
+
+    pthread_mutex_lock(&tw->lock);
+    t->kind = find_kind(tw, kind);
+    if (t->kind < 0 ||
+        expires - tw->now >= ((time_t)1 << (TIMER_SLOT_BITS * TIMER_LEVELS - 1))) {
+        pthread_mutex_unlock(&tw->lock);
+        LOG_ERROR("timer: rejected timer of kind '%s'", kind);
+        timer_destroy(t);
+        return 0;
+    }
+    t->id = tw->next_id++;
+    place(tw, t);
+    map_put(tw, t);
+    tw->pending++;
+    queue_op(tw, t->id, true);
+    uint64_t id = t->id;
+    pthread_mutex_unlock(&tw->lock);
+
+    return id;
+}
+
+bool timer_cancel(TimerWheel *tw, uint64_t id) {
+    pthread_mutex_lock(&tw->lock);
+    long i = map_find(tw, id);
+    Timer *t = NULL;
+    if (i >= 0) {
+        t = tw->map[i];
+        tw->map[i] = MAP_DELETED;
+        list_del(t);
+        tw->pending--;
+        queue_op(tw, id, false);
+    }
+    pthread_mutex_unlock(&tw->lock);
+
+    if (!t) return false;
+    timer_destroy(t);
+    return true;
+}
+
+size_t timer_pending(TimerWheel *tw) {
+    pthread_mutex_lock(&tw->lock);
+    size_t n = tw->pending;
+    pthread_mutex_unlock(&tw->lock);
+    return n;
+}
+
+int timer_advance(TimerWheel *tw, time_t now) {
+    Timer due;
+    list_init(&due);
+
+    pthread_mutex_lock(&tw->lock);
+    if (now - tw->now > TIMER_REBUILD_GAP) rebuild(tw, now);
+    while (tw->now < now) tick(tw);
+
+    if (tw->pool_live) {
+        int queued = 0;
+        for (Timer *t = tw->expired.next; t != &tw->expired; t = t->next) queued++;
+        list_splice(&tw->expired, &tw->work);
+        if (queued) pthread_cond_broadcast(&tw->work_ready);
+        pthread_mutex_unlock(&tw->lock);
+        return queued;
+    }
+
+    list_splice(&tw->expired, &due);
+    for (Timer *t = due.next; t != &due; t = t->next) {
+        map_del(tw, t->id);
+        tw->pending--;
+        queue_op(tw, t->id, false);
+    }
+    pthread_mutex_unlock(&tw->lock);
+
+    /* Fire outside the lock so handlers may add or cancel timers */
+    int fired = 0;
+    while (due.next != &due) {
+        Timer *t = due.next;
+        list_del(t);
+        TimerKind *k = &tw->kinds[t->kind];
+        if (k->fn) k->fn(t->id, t->payload, k->userdata);
+        timer_destroy(t);
+        fired++;
+    }
+    return fired;
+}
+
+/* Row copied out of the wheel for a store write */
+typedef struct {
+    uint64_t    id;
+    bool        insert;
+    const char *kind;
+    time_t      expires;
+    char       *payload;
+} TimerRow;
+
+/* Write queued inserts/deletes in one transaction. */
+static void flush_store(TimerWheel *tw) {
+    pthread_mutex_lock(&tw->lock);
+    size_t n = tw->num_ops;
+    if (!tw->db || n == 0) {
+        pthread_mutex_unlock(&tw->lock);
+        return;
+    }
+    TimerRow *rows = calloc(n, sizeof(TimerRow));
+    for (size_t i = 0; i < n; i++) {
+        rows[i].id = tw->ops[i].id;
+        if (!tw->ops[i].insert) continue;
+        long m = map_find(tw, rows[i].id);
+        if (m < 0) continue; /* Already fired or cancelled */
+        Timer *t = tw->map[m];
+        rows[i].insert = true;
+        rows[i].kind = tw->kinds[t->kind].name;
+        rows[i].expires = t->expires;
+        rows[i].payload = strdup(t->payload);
+    }
+    tw->num_ops = 0;
+    pthread_mutex_unlock(&tw->lock);
+
+    sqlite3_stmt *ins = NULL, *del = NULL;
+    sqlite3_exec(tw->db, "BEGIN;", NULL, NULL, NULL);
+    sqlite3_prepare_v2(tw->db,
+        "INSERT OR REPLACE INTO timers (id, kind, expires, payload) VALUES (?, ?, ?, ?);",
+        -1, &ins, NULL);
+    sqlite3_prepare_v2(tw->db, "DELETE FROM timers WHERE id = ?;", -1, &del, NULL);
+
+    for (size_t i = 0; i < n; i++) {
+        TimerRow *r = &rows[i];
+        if (r->insert && ins) {
+            sqlite3_bind_int64(ins, 1, (sqlite3_int64)r->id);
+            sqlite3_bind_text(ins, 2, r->kind, -1, SQLITE_STATIC);
+            sqlite3_bind_int64(ins, 3, (sqlite3_int64)r->expires);
+            sqlite3_bind_text(ins, 4, r->payload, -1, SQLITE_STATIC);
+            if (sqlite3_step(ins) != SQLITE_DONE)
+                LOG_ERROR("timer store insert: %s", sqlite3_errmsg(tw->db));
+            sqlite3_reset(ins);
+        } else if (!r->insert && del) {
+            sqlite3_bind_int64(del, 1, (sqlite3_int64)r->id);
+            sqlite3_step(del);
+            sqlite3_reset(del);
+        }
+        free(r->payload);
+    }
+
+    sqlite3_finalize(ins);
+    sqlite3_finalize(del);
+    if (sqlite3_exec(tw->db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+        LOG_ERROR("timer store commit: %s", sqlite3_errmsg(tw->db));
+    free(rows);
+}
+
+static void *worker_main(void *arg) {
+    TimerWheel *tw = arg;
+
+    pthread_mutex_lock(&tw->lock);
+    for (;;) {
+        while (tw->pool_live && tw->work.next == &tw->work)
+            pthread_cond_wait(&tw->work_ready, &tw->lock);
+        if (!tw->pool_live) break;
+
+        Timer *t = tw->work.next;
+        list_del(t);
+        map_del(tw, t->id);
+        tw->pending--;
+        queue_op(tw, t->id, false);
+        TimerKind *k = &tw->kinds[t->kind];
+        pthread_mutex_unlock(&tw->lock);
+
+        if (k->fn) k->fn(t->id, t->payload, k->userdata);
+        timer_destroy(t);
+
+        pthread_mutex_lock(&tw->lock);
+    }
+    pthread_mutex_unlock(&tw->lock);
+    return NULL;
+}
+
+void timer_run(TimerWheel *tw) {
+    tw->running = true;
+
+    pthread_mutex_lock(&tw->lock);
+    int nworkers = tw->workers;
+    if (nworkers > 0) {
+        tw->worker_threads = calloc((size_t)nworkers, sizeof(pthread_t));
+        tw->pool_live = true;
+        for (int i = 0; i < nworkers; i++)
+            pthread_create(&tw->worker_threads[i], NULL, worker_main, tw);
+    }
+    LOG_INFO("timer: service started (%zu pending, %d workers)", tw->pending, nworkers);
+    pthread_mutex_unlock(&tw->lock);
+
+    while (tw->running) {
+        timer_advance(tw, time(NULL));
+        flush_store(tw);
+        sleep(1);
+    }
+
+    /* Let running callbacks finish. Timers still queued stay in the store
+     * and fire on the next start */
+    pthread_mutex_lock(&tw->lock);
+    tw->pool_live = false;
+    pthread_cond_broadcast(&tw->work_ready);
+    pthread_mutex_unlock(&tw->lock);
+    for (int i = 0; i < nworkers; i++) pthread_join(tw->worker_threads[i], NULL);
+    free(tw->worker_threads);
+    tw->worker_threads = NULL;
+
+    pthread_mutex_lock(&tw->lock);
+    list_splice(&tw->work, &tw->expired);
+    pthread_mutex_unlock(&tw->lock);
+
+    LOG_INFO("timer: service stopped");
+}
+
+void timer_stop(TimerWheel *tw) {
+    tw->running = false;
+}
+
+void timer_wheel_free(TimerWheel *tw) {
+    if (!tw) return;
+    flush_store(tw);
+
+    for (int l = 0; l < TIMER_LEVELS; l++) {
+        for (int s = 0; s < TIMER_SLOTS; s++) {
+            Timer *head = &tw->wheel[l][s];
+            while (head->next != head) {
+                Timer *t = head->next;
+                list_del(t);
+                timer_destroy(t);
+            }
+        }
+    }
+    while (tw->expired.next != &tw->expired) {
+        Timer *t = tw->expired.next;
+        list_del(t);
+        timer_destroy(t);
+    }
+
+    if (tw->db) sqlite3_close(tw->db);
+    free(tw->map);
+    free(tw->ops);
+    pthread_cond_destroy(&tw->work_ready);
+    pthread_mutex_destroy(&tw->lock);
+    free(tw);
+}
@@ -0,0 +1,62 @@
+#ifndef CCLAW_TIMER_H
+#define CCLAW_TIMER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/* One-shot timer service ("remind me in 3 hours").
+ *
+ * A hierarchical timing wheel with 1-second resolution: TIMER_LEVELS wheels
+ * of TIMER_SLOTS slots each, the first covering the next 64 seconds, the
+ * next 64 minutes, and so on. Insert and cancel are O(1); each tick touches
+ * one slot plus an occasional cascade from a coarser wheel. */
+
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS     (1 << TIMER_SLOT_BITS)
+#define TIMER_LEVELS    6    /* 64^6 s ≈ 2000 years of range */
+#define TIMER_MAX_KINDS 16
+
+typedef struct TimerWheel TimerWheel;
+
+/* Timer callback. `payload` is the string given to timer_add(). */
+typedef void (*TimerFn)(uint64_t id, const char *payload, void *userdata);
+
+TimerWheel *timer_wheel_new(void);
+void        timer_wheel_free(TimerWheel *tw);
+
+/* Register a handler for a timer kind. Kinds are persisted by name, so
+ * register them before timer_open_store() loads pending timers. */
+bool timer_register(TimerWheel *tw, const char *kind, TimerFn fn, void *userdata);
+
+/* Fire timers on `workers` threads started by timer_run() instead of the
+ * thread calling timer_advance(), so a slow callback doesn't delay the
+ * others. Call before timer_run(). */
+void timer_set_concurrency(TimerWheel *tw, int workers);
+
+/* Persist pending timers in SQLite and load the ones left from the last run.
+ * Overdue timers fire on the first tick. Writes are batched per tick. */
+bool timer_open_store(TimerWheel *tw, const char *db_path);
+
+/* Schedule a one-shot timer. Returns its id, or 0 on failure. */
+uint64_t timer_add(TimerWheel *tw, const char *kind, time_t expires, const char *payload);
+
+/* Cancel a pending timer. Returns false if it already fired or is unknown. */
+bool timer_cancel(TimerWheel *tw, uint64_t id);
+
+/* Number of pending timers. */
+size_t timer_pending(TimerWheel *tw);
+
+/* Advance the wheel to `now` and fire every timer that expired, or queue
+ * them for the workers while timer_run() has them. Returns the number of
+ * timers fired or queued. */
+int timer_advance(TimerWheel *tw, time_t now);
+
+/* Run the timer loop (blocking — run in a thread). Ticks once a second. */
+void timer_run(TimerWheel *tw);
+
+/* Stop the timer loop. */
+void timer_stop(TimerWheel *tw);
+
+#endif
@@ -0,0 +1,233 @@
+/*
+ * On-demand context files.
+ *
+ * Files in <workspace>/skills/ are not pasted into the system prompt.
+ * The prompt carries only an index, one line per file with a short
+ * description, and the model reads a file with load_context when it
+ * needs it. A file declares its description in front matter:
+ *
+ *   ---
+ *   description: Release checklist and deploy commands
+ *   ---
+ *
+ * or else its first non-blank line (a heading's '#'s are dropped) is
+ * used. Contents come from the file cache, so repeated loads of an
+ * unchanged file are served from memory.
+ */
+
+#include "tool_context.h"
+#include "file_cache.h"
+#include "log.h"
+#include <cJSON.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEM_TAG MEM_TOOLS
+#include "mem.h"
+
+#define CONTEXT_EXT      ".md"
+#define CONTEXT_MAX      256   /* Files listed in the index */
+#define DESCRIPTION_MAX  200   /* Longer descriptions are cut */
+
+/* Letters, digits, '.', '_' and '-', not starting with '.'. */
+static bool valid_name(const char *s, size_t len) {
+    if (!len || s[0] == '.') return false;
+    for (size_t i = 0; i < len; i++) {
+        char c = s[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+              c == '.' || c == '_' || c == '-'))
+            return false;
+    }
+    return true;
+}
+
+/* Length of an opening "---" line, or 0 if there's no front matter. */
+static size_t front_matter_open(const char *text) {
+    if (!strncmp(text, "---\n", 4)) return 4;
+    if (!strncmp(text, "---\r\n", 5)) return 5;
+    return 0;
+}
+
+/* Where the body starts, past any front matter. */
+static const char *skip_front_matter(const char *text) {
+    size_t open = front_matter_open(text);
+    if (!open) return text;
+    for (const char *p = text + open - 1; (p = strstr(p, "\n---")); p += 4) {
+        const char *e = p + 4;
+        if (*e == '\r') e++;
+        if (*e == '\n') return e + 1;
+        if (!*e) return e;
+    }
+    return text;  /* Unterminated: treat it all as body */
+}
+
+/* Copy the line at p (up to '\n') into out, trimmed. */
+static void copy_line(char *out, size_t cap, const char *p) {
+    while (*p == ' ' || *p == '\t') p++;
+    size_t n = strcspn(p, "\r\n");
+    while (n && (p[n - 1] == ' ' || p[n - 1] == '\t')) n--;
+    if (n >= cap) n = cap - 1;
+    memcpy(out, p, n);
+    out[n] = '\0';
+}
+
+static void describe(const char *text, char *out, size_t cap) {
+    out[0] = '\0';
+    const char *body = skip_front_matter(text);
+    for (const char *p = text + front_matter_open(text); body != text && p < body; ) {
+        if (!strncmp(p, "description:", 12)) {
+            copy_line(out, cap, p + 12);
+            return;
+        }
+        const char *nl = strchr(p, '\n');
+        if (!nl) break;  /* Closing "---" was the last line */
+        p = nl + 1;
+    }
+    for (const char *p = body; *p; ) {
+        const char *q = p;
+        while (*q == '#' || *q == ' ' || *q == '\t') q++;
+        if (*q && *q != '\n' && *q != '\r') {
+            copy_line(out, cap, q);
+            return;
+        }
+        const char *nl = strchr(p, '\n');
+        if (!nl) break;
+        p = nl + 1;
+    }
+}
+
+static int name_cmp(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Sorted names (without extension) of the context files. Caller frees. */
+static char **list_names(const char *dir, int *count) {
+    *count = 0;
+    DIR *d = opendir(dir);
+    if (!d) return NULL;
+    char **names = NULL;
+    int n = 0, cap = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) && n < CONTEXT_MAX) {
+        size_t len = strlen(de->d_name), ext = strlen(CONTEXT_EXT);
+        if (len <= ext || strcmp(de->d_name + len - ext, CONTEXT_EXT)) continue;
+        if (!valid_name(de->d_name, len - ext)) continue;
+        if (n == cap) names = realloc(names, (size_t)(cap = cap ? cap * 2 : 16) * sizeof(*names));
+        names[n++] = strndup(de->d_name, len - ext);
+    }
+    closedir(d);
+    qsort(names, (size_t)n, sizeof(*names), name_cmp);
+    *count = n;
+    return names;
+}
+
+char *tool_context_index(const char *workspace, size_t *len) {
+    char dir[1024];
+    snprintf(dir, sizeof(dir), "%s/%s", workspace, CONTEXT_DIR);
+    int n;
+    char **names = list_names(dir, &n);
+
+    size_t cap = 512, off = 0;
+    char *out = malloc(cap);
+    out[0] = '\0';
+    for (int i = 0; i < n; i++) {
+        char path[1300], desc[DESCRIPTION_MAX + 1] = "";
+        snprintf(path, sizeof(path), "%s/%s" CONTEXT_EXT, dir, names[i]);
+        const CachedFile *f = fcache_get(path);
+        if (!f) {  /* Empty, vanished or too large: nothing to load */
+            if (errno == EFBIG) LOG_WARN("context: %s is over %d KB; not listed", path, FCACHE_MAX_FILE / 1024);
+            free(names[i]);
+            continue;
+        }
+        describe(f->data, desc, sizeof(desc));
+        fcache_release(f);
+
+        if (!off) {
+            off = (size_t)snprintf(out, cap,
+                "## Skills\n\n"
+                "Context files you can read on demand. Before a task one of them "
+                "covers, call load_context with its name.\n\n");
+        }
+        size_t need = strlen(names[i]) + strlen(desc) + 16;
+        while (off + need + 2 > cap) out = realloc(out, cap *= 2);
+        off += (size_t)snprintf(out + off, cap - off, desc[0] ? "- **%s**: %s\n" : "- **%s**\n",
+                                names[i], desc);
+        free(names[i]);
+    }
+    free(names);
+    if (off) {
+        out[off++] = '\n';
+        out[off] = '\0';
+    }
+    *len = off;
+    return out;
+}
+
+ToolExecResult tool_load_context_exec(const char *input_json, const char *workspace) {
+    ToolExecResult r = {0, NULL};
+
+    cJSON *args = cJSON_Parse(input_json);
+    if (!args) { r.output = strdup("Error: invalid JSON"); return r; }
+    cJSON *name = cJSON_GetObjectItem(args, "name");
+    if (!cJSON_IsString(name) || !name->valuestring[0]) {
+        r.output = strdup("Error: missing 'name'");
+        cJSON_Delete(args);
+        return r;
+    }
+
+    char n[256];
+    snprintf(n, sizeof(n), "%s", name->valuestring);
+    size_t len = strlen(n), ext = strlen(CONTEXT_EXT);
+    if (len > ext && !strcmp(n + len - ext, CONTEXT_EXT)) n[len -= ext] = '\0';
+
+    char msg[600];
+    if (!valid_name(n, len)) {
+        snprintf(msg, sizeof(msg), "Error: invalid context name '%s'", name->valuestring);
+        r.output = strdup(msg);
+        cJSON_Delete(args);
+        return r;
+    }
+
+    char path[1300];
+    snprintf(path, sizeof(path), "%s/%s/%s" CONTEXT_EXT, workspace, CONTEXT_DIR, n);
+    const CachedFile *f = fcache_get(path);
+    if (!f) {
+        if (errno == EFBIG)
+            snprintf(msg, sizeof(msg), "Error: %s is over %d KB", n, FCACHE_MAX_FILE / 1024);
+        else
+            snprintf(msg, sizeof(msg), "Error: no context named '%s' (see the Skills list)", n);
+        r.output = strdup(msg);
+    } else {
+        const char *body = skip_front_matter(f->data);
+        while (*body == '\n' || *body == '\r') body++;
+        r.output = strdup(body);
+        r.success = 1;
+        fcache_release(f);
+        LOG_DEBUG("load_context: %s", n);
+    }
+
+    cJSON_Delete(args);
+    return r;
+}
+
+void tool_context_register(void) {
+    static const ToolDef def = {
+        .name = "load_context",
+        .description = "Read the full text of a context file listed under Skills in the "
+                       "system prompt. Load one before a task it covers.",
+        .input_schema =
+            "{"
+                "\"type\":\"object\","
+                "\"properties\":{"
+                    "\"name\":{\"type\":\"string\",\"description\":\"Name from the Skills list\"}"
+                "},"
+                "\"required\":[\"name\"]"
+            "}",
+        .fn = tool_load_context_exec,
+        .flags = TOOL_READ_ONLY | TOOL_CONCURRENT,
+    };
+    tools_register(&def);
+}
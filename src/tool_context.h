@@ -0,0 +1,18 @@
+#ifndef CCLAW_TOOL_CONTEXT_H
+#define CCLAW_TOOL_CONTEXT_H
+
+#include "tools.h"
+
+/* Directory of on-demand context files, relative to the workspace. */
+#define CONTEXT_DIR "skills"
+
+ToolExecResult tool_load_context_exec(const char *input_json, const char *workspace);
+
+/* Register the load_context tool. */
+void tool_context_register(void);
+
+/* The "## Skills" prompt section: one line per context file with its
+ * description. Empty (not NULL) if there are none. Caller frees. */
+char *tool_context_index(const char *workspace, size_t *len);
+
+#endif
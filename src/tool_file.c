@@ -1,14 +1,27 @@
 #include "tool_file.h"
+#include "file_cache.h"
+#include "map_guard.h"
+#include "util.h"
 #include "log.h"
 #include <cJSON.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <libgen.h>
+#include <pthread.h>
+#include <unistd.h>
 
-#define MAX_FILE_READ (512 * 1024)  /* 512KB */
+#define MEM_TAG MEM_TOOLS
+#include "mem.h"
+
+#define MAX_FILE_READ (512 * 1024)  /* 512KB per call */
+#define LINE_STRIDE   256           /* Lines between line-index marks */
+#define INDEX_MIN     (1024 * 1024) /* Files this large keep their index cached */
+#define INDEX_CACHE   8             /* Cached line indexes */
 
 static void resolve_path(char *out, size_t outlen, const char *workspace, const char *path) {
     if (path[0] == '/') {
@@ -33,6 +46,160 @@ static int mkdirs(const char *path) {
     return mkdir(dir, 0755);
 }
 
+/* ── Line index ─────────────────────────────────────────────── */
+
+/* Offsets of every LINE_STRIDE-th line start, so a line number resolves
+ * to at most LINE_STRIDE lines of scanning. Indexes of large files are
+ * cached in memory (not on disk, so they're rebuilt after a restart),
+ * keyed by inode, size and mtime so any change rebuilds them. */
+typedef struct {
+    dev_t           dev;
+    ino_t           ino;
+    off_t           size;
+    struct timespec mtime;
+    size_t          lines;
+    off_t          *marks;   /* marks[k] = offset of line k*LINE_STRIDE + 1 */
+    int             refs;
+    unsigned long   used;    /* LRU clock */
+} LineIndex;
+
+static LineIndex      *g_index[INDEX_CACHE];
+static unsigned long   g_index_clock;
+static pthread_mutex_t g_index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static LineIndex *index_build(const char *data, size_t size) {
+    LineIndex *ix = calloc(1, sizeof(*ix));
+    size_t cap = size / 4096 + 16;  /* Grown as needed */
+    ix->marks = malloc(cap * sizeof(off_t));
+    ix->marks[0] = 0;
+    size_t nmarks = 1;
+
+    const char *p = data, *end = data + size;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        if (!nl) { ix->lines++; break; }  /* Last line has no newline */
+        p = nl + 1;
+        if (++ix->lines % LINE_STRIDE == 0 && p < end) {
+            if (nmarks == cap) {
+                cap *= 2;
+                ix->marks = realloc(ix->marks, cap * sizeof(off_t));
+            }
+            ix->marks[nmarks++] = p - data;
+        }
+    }
+    ix->refs = 1;
+    return ix;
+}
+
+static void index_unref(LineIndex *ix) {
+    if (!ix) return;
+    pthread_mutex_lock(&g_index_lock);
+    bool last = --ix->refs == 0;
+    pthread_mutex_unlock(&g_index_lock);
+    if (last) {
+        free(ix->marks);
+        free(ix);
+    }
+}
+
+static bool index_matches(const LineIndex *ix, const struct stat *st) {
+    return ix->dev == st->st_dev && ix->ino == st->st_ino && ix->size == st->st_size &&
+           ix->mtime.tv_sec == st->st_mtim.tv_sec && ix->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+/* The line index for a file, from the cache or built now. Release with
+ * index_unref(). Small files aren't cached; scanning them is cheap. */
+static LineIndex *index_get(const char *data, size_t size, const struct stat *st) {
+    bool cacheable = S_ISREG(st->st_mode) && st->st_size >= INDEX_MIN;
+    if (cacheable) {
+        pthread_mutex_lock(&g_index_lock);
+        for (int i = 0; i < INDEX_CACHE; i++) {
+            LineIndex *ix = g_index[i];
+            if (ix && index_matches(ix, st)) {
+                ix->refs++;
+                ix->used = ++g_index_clock;
+                pthread_mutex_unlock(&g_index_lock);
+                return ix;
+            }
+        }
+        pthread_mutex_unlock(&g_index_lock);
+    }
+
+    /* Built outside the lock: a multi-GB scan shouldn't block other reads. */
+    LineIndex *ix = index_build(data, size);
+    if (!cacheable) return ix;
+
+    ix->dev = st->st_dev;
+    ix->ino = st->st_ino;
+    ix->size = st->st_size;
+    ix->mtime = st->st_mtim;
+
+    pthread_mutex_lock(&g_index_lock);
+    int slot = 0;
+    for (int i = 0; i < INDEX_CACHE; i++) {
+        if (!g_index[i]) { slot = i; break; }
+        if (g_index[i]->used < g_index[slot]->used) slot = i;
+    }
+    LineIndex *old = g_index[slot];
+    g_index[slot] = ix;
+    ix->refs++;
+    ix->used = ++g_index_clock;
+    pthread_mutex_unlock(&g_index_lock);
+    index_unref(old);
+    return ix;
+}
+
+/* Offset of 1-based line `line`; `size` past the last line. */
+static size_t line_offset(const LineIndex *ix, const char *data, size_t size, size_t line) {
+    if (line > ix->lines) return size;
+    size_t k = (line - 1) / LINE_STRIDE;
+    size_t off = (size_t)ix->marks[k];
+    for (size_t n = (line - 1) % LINE_STRIDE; n > 0 && off < size; n--) {
+        const char *nl = memchr(data + off, '\n', size - off);
+        off = nl ? (size_t)(nl - data) + 1 : size;
+    }
+    return off;
+}
+
+void tool_file_cleanup(void) {
+    pthread_mutex_lock(&g_index_lock);
+    LineIndex *ixs[INDEX_CACHE];
+    memcpy(ixs, g_index, sizeof(ixs));
+    memset(g_index, 0, sizeof(g_index));
+    pthread_mutex_unlock(&g_index_lock);
+    for (int i = 0; i < INDEX_CACHE; i++) index_unref(ixs[i]);
+}
+
+/* ── file_read ──────────────────────────────────────────────── */
+
+/* Non-negative integer argument, or `def` if absent. -1 if invalid. */
+static long long arg_count(const cJSON *args, const char *name, long long def) {
+    cJSON *v = cJSON_GetObjectItem(args, name);
+    if (!v) return def;
+    if (!cJSON_IsNumber(v) || v->valuedouble < 0) return -1;
+    return (long long)v->valuedouble;
+}
+
+/* Slurp up to MAX_FILE_READ bytes from something that can't be mapped
+ * (pipes, /proc files that report size 0). */
+static char *read_stream(int fd, size_t *len) {
+    char *buf = malloc(MAX_FILE_READ);
+    size_t n = 0;
+    while (n < MAX_FILE_READ) {
+        ssize_t r = read(fd, buf + n, MAX_FILE_READ - n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        n += (size_t)r;
+    }
+    *len = n;
+    return buf;
+}
+
+/* Files are mapped rather than read, so a window into a huge file costs
+ * only the pages it touches; with the line index, lines N..M of a
+ * multi-GB log are found without reading what comes before them. Reads
+ * of the mapping run under map_guard, so a file truncated meanwhile
+ * fails the call instead of killing the agent with SIGBUS. */
 ToolExecResult tool_file_read(const char *input_json, const char *workspace) {
     ToolExecResult r = {0, NULL};
 
@@ -46,34 +213,207 @@ ToolExecResult tool_file_read(const char *input_json, const char *workspace) {
         return r;
     }
 
+    long long offset = arg_count(args, "offset", 0);
+    long long length = arg_count(args, "length", MAX_FILE_READ);
+    long long start_line = arg_count(args, "start_line", 0);
+    long long end_line = arg_count(args, "end_line", 0);
+    bool by_line = cJSON_GetObjectItem(args, "start_line") || cJSON_GetObjectItem(args, "end_line");
+    bool by_byte = cJSON_GetObjectItem(args, "offset") || cJSON_GetObjectItem(args, "length");
+    const char *bad = NULL;
+    if (offset < 0 || length < 0 || start_line < 0 || end_line < 0)
+        bad = "Error: offset, length, start_line and end_line must be non-negative integers";
+    else if (by_line && by_byte)
+        bad = "Error: use either offset/length or start_line/end_line, not both";
+    else if (end_line && start_line > end_line)
+        bad = "Error: start_line is after end_line";
+    if (bad) {
+        r.output = strdup(bad);
+        cJSON_Delete(args);
+        return r;
+    }
+    if (start_line == 0) start_line = 1;
+
     char fullpath[1024];
     resolve_path(fullpath, sizeof(fullpath), workspace, path->valuestring);
 
-    FILE *fp = fopen(fullpath, "r");
-    if (!fp) {
-        char buf[1280];
-        snprintf(buf, sizeof(buf), "Error: cannot read %s: %s", fullpath, strerror(errno));
-        r.output = strdup(buf);
-        cJSON_Delete(args);
-        return r;
+    /* Small files come from the shared cache; the rest are mapped. */
+    struct stat st;
+    char *data = NULL, *copy = NULL;
+    size_t size = 0;
+    const CachedFile *cached = fcache_get(fullpath);
+    if (cached) {
+        data = (char *)cached->data;
+        size = cached->size;
+        st = cached->st;
+    } else {
+        int fd = open(fullpath, O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || fstat(fd, &st) < 0) {
+            char buf[1280];
+            snprintf(buf, sizeof(buf), "Error: cannot read %s: %s", fullpath, strerror(errno));
+            r.output = strdup(buf);
+            if (fd >= 0) close(fd);
+            cJSON_Delete(args);
+            return r;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            char buf[1280];
+            snprintf(buf, sizeof(buf), "Error: %s is a directory", fullpath);
+            r.output = strdup(buf);
+            close(fd);
+            cJSON_Delete(args);
+            return r;
+        }
+
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+            size = (size_t)st.st_size;
+            data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) data = NULL;
+        }
+        if (!data) data = copy = read_stream(fd, &size);
+        close(fd);
     }
 
-    fseek(fp, 0, SEEK_END);
-    long size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+    bool mapped = !cached && !copy;
+    if (mapped) map_guard_arm(data, size);
 
-    if (size > MAX_FILE_READ) size = MAX_FILE_READ;
+    LineIndex *ix = index_get(data, size, &st);
 
-    r.output = malloc((size_t)size + 1);
-    size_t n = fread(r.output, 1, (size_t)size, fp);
-    r.output[n] = '\0';
+    /* Resolve the window to [from, to) */
+    size_t from, to;
+    if (by_line) {
+        size_t last = end_line && (size_t)end_line < ix->lines ? (size_t)end_line : ix->lines;
+        from = (size_t)start_line <= ix->lines ? line_offset(ix, data, size, (size_t)start_line) : size;
+        to = (size_t)start_line <= last ? line_offset(ix, data, size, last + 1) : from;
+    } else {
+        from = (unsigned long long)offset < size ? (size_t)offset : size;
+        to = (unsigned long long)length < size - from ? from + (size_t)length : size;
+    }
+
+    /* Cap the window, at a line break in line mode when one fits. */
+    bool capped = to - from > MAX_FILE_READ;
+    if (capped) {
+        to = from + MAX_FILE_READ;
+        if (by_line) {
+            const char *p = data + to;
+            while (p > data + from && p[-1] != '\n') p--;
+            if (p > data + from) to = (size_t)(p - data);
+        }
+    }
+
+    /* Header: what the file is and which part of it this is */
+    char header[512];
+    int hlen;
+    if (by_line) {
+        size_t first = (size_t)start_line, shown = 0;
+        for (const char *p = data + from; p < data + to; shown++) {
+            const char *nl = memchr(p, '\n', (size_t)(data + to - p));
+            p = nl ? nl + 1 : data + to;
+        }
+        if (shown) {
+            hlen = snprintf(header, sizeof(header), "[%s: %zu bytes, %zu lines; lines %zu-%zu%s]\n",
+                            path->valuestring, size, ix->lines, first, first + shown - 1,
+                            capped ? ", truncated at 512KB" : "");
+        } else {
+            hlen = snprintf(header, sizeof(header), "[%s: %zu bytes, %zu lines; no lines in range]\n",
+                            path->valuestring, size, ix->lines);
+        }
+    } else {
+        bool whole = from == 0 && to == size;
+        hlen = snprintf(header, sizeof(header), "[%s: %zu bytes, %zu lines%s",
+                        path->valuestring, size, ix->lines, whole ? "]\n" : "");
+        if (!whole)
+            hlen += snprintf(header + hlen, sizeof(header) - (size_t)hlen, "; %zu bytes at offset %zu%s]\n",
+                             to - from, from,
+                             to < size && (capped || !by_byte) ? "; read further with offset/length or start_line/end_line" : "");
+    }
+    if (copy && size == MAX_FILE_READ)
+        hlen += snprintf(header + hlen, sizeof(header) - (size_t)hlen, "[stream; first 512KB only]\n");
+
+    r.output = malloc((size_t)hlen + (to - from) + 1);
+    memcpy(r.output, header, (size_t)hlen);
+    memcpy(r.output + hlen, data + from, to - from);
+    r.output[(size_t)hlen + (to - from)] = '\0';
     r.success = 1;
+    if (mapped && map_guard_disarm()) {
+        char buf[1280];
+        snprintf(buf, sizeof(buf), "Error: %s was truncated while being read; try again", fullpath);
+        free(r.output);
+        r.output = strdup(buf);
+        r.success = 0;
+    }
 
-    fclose(fp);
+    index_unref(ix);
+    if (cached) fcache_release(cached);
+    else if (copy) free(copy);
+    else munmap(data, size);
     cJSON_Delete(args);
     return r;
 }
 
+/* ── Writing ────────────────────────────────────────────────── */
+
+static bool g_fsync;
+
+void tool_file_set_fsync(bool on) {
+    g_fsync = on;
+}
+
+/* Replace `path` with `data` atomically: write a temp file in the same
+ * directory, then rename() it over the target, so readers and crashes
+ * see either the old content or the new, never a torn file. The target's
+ * permissions are kept. Parent directories are only created when the
+ * first attempt finds them missing. With fsync on, the data and the
+ * rename are flushed before returning. Returns false with `err` set. */
+static bool write_atomic(const char *path, const char *data, size_t len,
+                         char *err, size_t errlen) {
+    /* Write through symlinks rather than replacing them */
+    char real[1024];
+    struct stat st;
+    fcache_invalidate(path);
+    bool exists = stat(path, &st) == 0;
+    if (exists && realpath(path, real)) path = real;
+
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.cclaw-XXXXXX", path);
+    int fd = mkostemp(tmp, O_CLOEXEC);
+    if (fd < 0 && errno == ENOENT) {
+        mkdirs(path);
+        snprintf(tmp, sizeof(tmp), "%s.cclaw-XXXXXX", path);
+        fd = mkostemp(tmp, O_CLOEXEC);
+    }
+    if (fd < 0) {
+        snprintf(err, errlen, "cannot write %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    fchmod(fd, exists ? st.st_mode & 07777 : 0644);
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, data + done, len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    bool ok = done == len && (!g_fsync || fsync(fd) == 0);
+    int saved = errno;
+    if (close(fd) < 0 && ok) { ok = false; saved = errno; }
+    if (ok && rename(tmp, path) < 0) { ok = false; saved = errno; }
+    if (!ok) {
+        unlink(tmp);
+        snprintf(err, errlen, "cannot write %s: %s", path, strerror(saved));
+        return false;
+    }
+    fcache_invalidate(path);
+
+    if (g_fsync) {  /* Make the rename itself durable */
+        char dir[1024];
+        snprintf(dir, sizeof(dir), "%s", path);
+        int dfd = open(dirname(dir), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dfd >= 0) { fsync(dfd); close(dfd); }
+    }
+    return true;
+}
+
 ToolExecResult tool_file_write(const char *input_json, const char *workspace) {
     ToolExecResult r = {0, NULL};
 
@@ -91,22 +431,16 @@ ToolExecResult tool_file_write(const char *input_json, const char *workspace) {
     char fullpath[1024];
     resolve_path(fullpath, sizeof(fullpath), workspace, path->valuestring);
 
-    /* Create parent directories */
-    mkdirs(fullpath);
-
-    FILE *fp = fopen(fullpath, "w");
-    if (!fp) {
-        char buf[1280];
-        snprintf(buf, sizeof(buf), "Error: cannot write %s: %s", fullpath, strerror(errno));
+    size_t len = strlen(content->valuestring);
+    char err[1280];
+    if (!write_atomic(fullpath, content->valuestring, len, err, sizeof(err))) {
+        char buf[1300];
+        snprintf(buf, sizeof(buf), "Error: %s", err);
         r.output = strdup(buf);
         cJSON_Delete(args);
         return r;
     }
 
-    size_t len = strlen(content->valuestring);
-    fwrite(content->valuestring, 1, len, fp);
-    fclose(fp);
-
     char buf[1280];
     snprintf(buf, sizeof(buf), "Wrote %zu bytes to %s", len, path->valuestring);
     r.output = strdup(buf);
@@ -117,3 +451,350 @@ ToolExecResult tool_file_write(const char *input_json, const char *workspace) {
     cJSON_Delete(args);
     return r;
 }
+
+/* ── Editing ────────────────────────────────────────────────── */
+
+/* Apply search-and-replace edits in order. Each old_string must match
+ * exactly once unless replace_all is set, so an ambiguous edit fails
+ * instead of changing the wrong place. */
+static bool apply_edits(char **text, size_t *len, const cJSON *edits, int *count,
+                        char *err, size_t errlen) {
+    int n = cJSON_GetArraySize(edits);
+    for (int i = 0; i < n; i++) {
+        const cJSON *e = cJSON_GetArrayItem(edits, i);
+        const cJSON *from = cJSON_GetObjectItem(e, "old_string");
+        const cJSON *to = cJSON_GetObjectItem(e, "new_string");
+        if (!cJSON_IsString(from) || !cJSON_IsString(to) || !from->valuestring[0]) {
+            snprintf(err, errlen, "edit %d: needs non-empty old_string and new_string", i + 1);
+            return false;
+        }
+        bool all = cJSON_IsTrue(cJSON_GetObjectItem(e, "replace_all"));
+        size_t flen = strlen(from->valuestring), tlen = strlen(to->valuestring);
+
+        int hits = 0;
+        for (char *p = *text; (p = memmem(p, *len - (size_t)(p - *text), from->valuestring, flen));
+             p += flen)
+            hits++;
+        if (hits == 0) {
+            snprintf(err, errlen, "edit %d: old_string not found", i + 1);
+            return false;
+        }
+        if (hits > 1 && !all) {
+            snprintf(err, errlen, "edit %d: old_string matches %d places; add surrounding "
+                     "context to make it unique, or set replace_all", i + 1, hits);
+            return false;
+        }
+
+        Buf out = {0};
+        char *p = *text, *end = *text + *len;
+        for (char *m; (m = memmem(p, (size_t)(end - p), from->valuestring, flen)); p = m + flen) {
+            buf_add(&out, p, (size_t)(m - p));
+            buf_add(&out, to->valuestring, tlen);
+        }
+        buf_add(&out, p, (size_t)(end - p));
+        free(*text);
+        *text = out.data;
+        *len = out.len;
+        *count += hits;
+    }
+    return true;
+}
+
+/* A line of a file or hunk, including its '\n' if it has one. */
+typedef struct {
+    const char *s;
+    size_t      len;
+} Line;
+
+static Line *split_lines(const char *text, size_t len, size_t *n) {
+    size_t cap = 64;
+    Line *lines = malloc(cap * sizeof(Line));
+    *n = 0;
+    for (const char *p = text, *end = text + len; p < end;) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *next = nl ? nl + 1 : end;
+        if (*n == cap) lines = realloc(lines, (cap *= 2) * sizeof(Line));
+        lines[(*n)++] = (Line){ p, (size_t)(next - p) };
+        p = next;
+    }
+    return lines;
+}
+
+static bool lines_match(const Line *file, size_t nfile, size_t at, const Line *want, size_t nwant) {
+    if (at + nwant > nfile) return false;
+    for (size_t i = 0; i < nwant; i++)
+        if (file[at + i].len != want[i].len || memcmp(file[at + i].s, want[i].s, want[i].len))
+            return false;
+    return true;
+}
+
+/* One hunk's old and new side. Hunk lines point into `store`, which holds
+ * each body line with its marker stripped and '\n' restored. */
+typedef struct {
+    size_t old_start;
+    Line  *old, *new;
+    size_t nold, nnew;
+    Buf    store;
+} Hunk;
+
+static void hunk_free(Hunk *h) {
+    free(h->old);
+    free(h->new);
+    free(h->store.data);
+}
+
+/* Parse the hunk starting at patch line `*i` (an "@@" line). */
+static bool parse_hunk(const Line *pl, size_t np, size_t *i, Hunk *h) {
+    memset(h, 0, sizeof(*h));
+    unsigned long old_start = 0;
+    if (sscanf(pl[*i].s, "@@ -%lu", &old_start) != 1) return false;
+    h->old_start = old_start;
+    (*i)++;
+
+    /* First pass: copy body lines into the store, remembering sides. */
+    typedef struct { size_t off, len; char side; } Raw;
+    Raw *raw = malloc((np - *i + 1) * sizeof(Raw));
+    size_t nraw = 0;
+    for (; *i < np; (*i)++) {
+        const char *s = pl[*i].s;
+        size_t len = pl[*i].len;
+        if (len >= 2 && !strncmp(s, "@@", 2)) break;
+        /* A "--- " line is a removed "-- " line unless a "+++ " header follows */
+        if (len >= 4 && !strncmp(s, "--- ", 4) && *i + 1 < np &&
+            pl[*i + 1].len >= 4 && !strncmp(pl[*i + 1].s, "+++ ", 4))
+            break;
+        if (s[0] == '\\') {  /* "\ No newline at end of file" applies to the line before */
+            if (nraw && h->store.len && h->store.data[h->store.len - 1] == '\n') {
+                h->store.len--;
+                raw[nraw - 1].len--;
+            }
+            continue;
+        }
+        char side = s[0];
+        const char *body = s + 1;
+        size_t blen = len - 1;
+        if (side == '\n' || side == '\r') {  /* Blank context line with its space dropped */
+            side = ' ';
+            body = s;
+            blen = len;
+        } else if (side != ' ' && side != '-' && side != '+') {
+            break;
+        }
+        raw[nraw++] = (Raw){ h->store.len, blen, side };
+        buf_add(&h->store, body, blen);
+        if (blen == 0 || body[blen - 1] != '\n') {  /* Last patch line without '\n' */
+            buf_add(&h->store, "\n", 1);
+            raw[nraw - 1].len++;
+        }
+    }
+
+    /* Second pass: the store is final, so pointers into it are stable. */
+    h->old = malloc((nraw + 1) * sizeof(Line));
+    h->new = malloc((nraw + 1) * sizeof(Line));
+    for (size_t k = 0; k < nraw; k++) {
+        Line l = { h->store.data + raw[k].off, raw[k].len };
+        if (raw[k].side != '+') h->old[h->nold++] = l;
+        if (raw[k].side != '-') h->new[h->nnew++] = l;
+    }
+    free(raw);
+    return nraw > 0;
+}
+
+/* Apply unified-diff hunks. Each hunk is matched exactly on its context
+ * and removed lines, at its stated position shifted by the drift of
+ * earlier hunks, or failing that at the nearest position where it fits. */
+static bool apply_patch(char **text, size_t *len, const char *patch, int *count,
+                        char *err, size_t errlen) {
+    size_t nf, np;
+    Line *file = split_lines(*text, *len, &nf);
+    Line *pl = split_lines(patch, strlen(patch), &np);
+    Buf out = {0};
+    size_t cursor = 0;   /* File lines before this are already emitted */
+    long drift = 0;
+    bool ok = true;
+    *count = 0;
+
+    for (size_t i = 0; i < np && ok;) {
+        if (pl[i].len < 2 || strncmp(pl[i].s, "@@", 2)) { i++; continue; }
+
+        Hunk h;
+        if (!parse_hunk(pl, np, &i, &h)) {
+            snprintf(err, errlen, "hunk %d: malformed", *count + 1);
+            hunk_free(&h);
+            ok = false;
+            break;
+        }
+
+        /* Pure insertions ("@@ -N,0") go after line N */
+        long want = (long)h.old_start - (h.nold ? 1 : 0) + drift;
+        if (want < (long)cursor) want = (long)cursor;
+        long at = -1;
+        for (long d = 0; at < 0 && (want - d >= (long)cursor || want + d <= (long)nf); d++) {
+            if (want + d <= (long)nf && lines_match(file, nf, (size_t)(want + d), h.old, h.nold))
+                at = want + d;
+            else if (d && want - d >= (long)cursor &&
+                     lines_match(file, nf, (size_t)(want - d), h.old, h.nold))
+                at = want - d;
+        }
+        if (at < 0) {
+            snprintf(err, errlen, "hunk %d (@@ -%zu): context does not match the file",
+                     *count + 1, h.old_start);
+            hunk_free(&h);
+            ok = false;
+            break;
+        }
+
+        for (size_t k = cursor; k < (size_t)at; k++) buf_add(&out, file[k].s, file[k].len);
+        for (size_t k = 0; k < h.nnew; k++) buf_add(&out, h.new[k].s, h.new[k].len);
+        cursor = (size_t)at + h.nold;
+        drift = at - ((long)h.old_start - (h.nold ? 1 : 0));
+        (*count)++;
+        hunk_free(&h);
+    }
+
+    if (ok && *count == 0) {
+        snprintf(err, errlen, "patch has no hunks");
+        ok = false;
+    }
+    if (ok) {
+        for (size_t k = cursor; k < nf; k++) buf_add(&out, file[k].s, file[k].len);
+        free(*text);
+        *text = out.data ? out.data : strdup("");
+        *len = out.len;
+    } else {
+        free(out.data);
+    }
+    free(file);
+    free(pl);
+    return ok;
+}
+
+ToolExecResult tool_file_edit(const char *input_json, const char *workspace) {
+    ToolExecResult r = {0, NULL};
+
+    cJSON *args = cJSON_Parse(input_json);
+    if (!args) { r.output = strdup("Error: invalid JSON"); return r; }
+
+    cJSON *path = cJSON_GetObjectItem(args, "path");
+    cJSON *edits = cJSON_GetObjectItem(args, "edits");
+    cJSON *patch = cJSON_GetObjectItem(args, "patch");
+    if (!path || !path->valuestring || (!cJSON_IsArray(edits) == !cJSON_IsString(patch))) {
+        r.output = strdup("Error: need 'path' and either 'edits' or 'patch'");
+        cJSON_Delete(args);
+        return r;
+    }
+
+    char fullpath[1024];
+    resolve_path(fullpath, sizeof(fullpath), workspace, path->valuestring);
+
+    char err[1280];
+    struct stat st;
+    int fd = open(fullpath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        snprintf(err, sizeof(err), "Error: cannot edit %s: %s", fullpath,
+                 fd < 0 ? strerror(errno) : "not a regular file");
+        if (fd >= 0) close(fd);
+        r.output = strdup(err);
+        cJSON_Delete(args);
+        return r;
+    }
+    size_t len = 0, old_len = (size_t)st.st_size;
+    char *text = malloc(old_len + 1);
+    while (len < old_len) {
+        ssize_t n = read(fd, text + len, old_len - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        len += (size_t)n;
+    }
+    close(fd);
+    old_len = len;
+
+    int count = 0;
+    bool ok = cJSON_IsArray(edits)
+        ? apply_edits(&text, &len, edits, &count, err, sizeof(err))
+        : apply_patch(&text, &len, patch->valuestring, &count, err, sizeof(err));
+    if (ok) ok = write_atomic(fullpath, text, len, err, sizeof(err));
+    free(text);
+
+    char buf[1400];
+    if (ok) {
+        snprintf(buf, sizeof(buf), "Edited %s: %d %s, %zu -> %zu bytes", path->valuestring, count,
+                 cJSON_IsArray(edits) ? "replacement(s)" : "hunk(s)", old_len, len);
+        LOG_INFO("file_edit: %s (%d changes)", path->valuestring, count);
+    } else {
+        snprintf(buf, sizeof(buf), "Error: %s (file unchanged)", err);
+    }
+    r.output = strdup(buf);
+    r.success = ok;
+
+    cJSON_Delete(args);
+    return r;
+}
+
+void tool_file_register(void) {
+    static const ToolDef read_def = {
+        .name = "file_read",
+        .description = "Read a file, or a window of it. The result starts with a header giving "
+                       "the file's size and line count. Reads are capped at 512KB; use "
+                       "start_line/end_line (1-based, inclusive) or offset/length (bytes) "
+                       "to page through larger files.",
+        .input_schema =
+            "{"
+                "\"type\":\"object\","
+                "\"properties\":{"
+                    "\"path\":{\"type\":\"string\",\"description\":\"File path (relative to workspace)\"},"
+                    "\"start_line\":{\"type\":\"integer\",\"description\":\"First line to return (1-based)\"},"
+                    "\"end_line\":{\"type\":\"integer\",\"description\":\"Last line to return (inclusive)\"},"
+                    "\"offset\":{\"type\":\"integer\",\"description\":\"Byte offset to start at\"},"
+                    "\"length\":{\"type\":\"integer\",\"description\":\"Bytes to return\"}"
+                "},"
+                "\"required\":[\"path\"]"
+            "}",
+        .fn = tool_file_read,
+        .flags = TOOL_READ_ONLY | TOOL_CONCURRENT,
+    };
+    static const ToolDef write_def = {
+        .name = "file_write",
+        .description = "Write content to a file, replacing it atomically. Creates parent "
+                       "directories. To change part of an existing file, use file_edit.",
+        .input_schema =
+            "{"
+                "\"type\":\"object\","
+                "\"properties\":{"
+                    "\"path\":{\"type\":\"string\",\"description\":\"File path\"},"
+                    "\"content\":{\"type\":\"string\",\"description\":\"Content to write\"}"
+                "},"
+                "\"required\":[\"path\",\"content\"]"
+            "}",
+        .fn = tool_file_write,
+    };
+    static const ToolDef edit_def = {
+        .name = "file_edit",
+        .description = "Edit a file in place without resending it. Pass either 'edits', a list "
+                       "of exact search-and-replace pairs applied in order (each old_string must "
+                       "be unique unless replace_all is set), or 'patch', unified-diff hunks for "
+                       "this file. All changes apply atomically or not at all.",
+        .input_schema =
+            "{"
+                "\"type\":\"object\","
+                "\"properties\":{"
+                    "\"path\":{\"type\":\"string\",\"description\":\"File path\"},"
+                    "\"edits\":{\"type\":\"array\",\"items\":{"
+                        "\"type\":\"object\","
+                        "\"properties\":{"
+                            "\"old_string\":{\"type\":\"string\",\"description\":\"Exact text to replace\"},"
+                            "\"new_string\":{\"type\":\"string\",\"description\":\"Replacement text\"},"
+                            "\"replace_all\":{\"type\":\"boolean\",\"description\":\"Replace every occurrence\"}"
+                        "},"
+                        "\"required\":[\"old_string\",\"new_string\"]"
+                    "}},"
+                    "\"patch\":{\"type\":\"string\",\"description\":\"Unified diff hunks (@@ -a,b +c,d @@)\"}"
+                "},"
+                "\"required\":[\"path\"]"
+            "}",
+        .fn = tool_file_edit,
+    };
+    tools_register(&read_def);
+    tools_register(&write_def);
+    tools_register(&edit_def);
+}
@@ -5,5 +5,16 @@
 
 ToolExecResult tool_file_read(const char *input_json, const char *workspace);
 ToolExecResult tool_file_write(const char *input_json, const char *workspace);
+ToolExecResult tool_file_edit(const char *input_json, const char *workspace);
+
+/* fsync written files (and their directory) before reporting success.
+ * Call before tools_init(). */
+void tool_file_set_fsync(bool on);
+
+/* Register file_read, file_write and file_edit. */
+void tool_file_register(void);
+
+/* Drop cached line indexes. */
+void tool_file_cleanup(void);
 
 #endif
@@ -0,0 +1,616 @@
+/*
+ * Workspace search.
+ *
+ * A small pool of threads walks the tree from a shared stack of
+ * directories: each worker lists a directory, pushes its subdirectories
+ * and searches its files, so a wide tree keeps every thread busy. Small
+ * files are read into a per-worker buffer and large ones mmap'd, then
+ * scanned in place: literal patterns with memmem/memchr, regexes behind
+ * a literal prefilter where one can be extracted. Mapped files are read
+ * under map_guard, so one truncated mid-scan is dropped rather than
+ * killing the agent. Matches are formatted with context by the worker
+ * that found them. .gitignore files are honoured and symlinks are never
+ * followed.
+ */
+
+#include "tool_search.h"
+#include "gitignore.h"
+#include "map_guard.h"
+#include "workspace.h"
+#include "util.h"
+#include "log.h"
+#include <cJSON.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <regex.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MEM_TAG MEM_TOOLS
+#include "mem.h"
+
+#define SEARCH_THREADS   8
+#define SEARCH_MAX_FILE  (64L * 1024 * 1024)  /* Larger files are skipped */
+#define SEARCH_READ_MAX  (256 * 1024)         /* Larger files are mmap'd, smaller read() */
+#define SEARCH_HARD_CAP  5000                 /* Stop the walk after this many matches */
+#define DEFAULT_RESULTS  50
+#define MAX_RESULTS      500
+#define MAX_CONTEXT      10
+#define SHOW_LINE_MAX    300                  /* Longer lines are cut (minified files) */
+#define OUTPUT_MAX       (64 * 1024)
+#define BINARY_PROBE     8192                 /* A NUL in this prefix marks a binary file */
+#define PREFILTER_MIN    3                    /* Shortest literal worth prefiltering on */
+
+/* ── Patterns ───────────────────────────────────────────────── */
+
+typedef struct {
+    bool    regex;
+    bool    icase;
+    regex_t re;
+    char   *lit;      /* Literal pattern, or the regex's required literal; NULL = none */
+    size_t  lit_len;  /* Lowercased when icase */
+} Matcher;
+
+/* Next occurrence of m->lit in [p, end), or NULL. */
+static const char *find_literal(const Matcher *m, const char *p, const char *end) {
+    if (!m->icase) return memmem(p, (size_t)(end - p), m->lit, m->lit_len);
+
+    /* Nearest position of either case of the first byte; each memchr
+     * result is reused until the scan passes it (`end` = none left). */
+    int lo = (unsigned char)m->lit[0], up = toupper(lo);
+    const char *next_lo = p, *next_up = lo != up ? p : end;
+    bool have_lo = false, have_up = lo == up;
+    while (p + m->lit_len <= end) {
+        if (!have_lo || next_lo < p) {
+            next_lo = memchr(p, lo, (size_t)(end - p));
+            if (!next_lo) next_lo = end;
+            have_lo = true;
+        }
+        if (!have_up || next_up < p) {
+            next_up = memchr(p, up, (size_t)(end - p));
+            if (!next_up) next_up = end;
+            have_up = true;
+        }
+        const char *c = next_lo < next_up ? next_lo : next_up;
+        if (c + m->lit_len > end) return NULL;
+
+        size_t i = 1;
+        while (i < m->lit_len && tolower((unsigned char)c[i]) == (unsigned char)m->lit[i]) i++;
+        if (i == m->lit_len) return c;
+        p = c + 1;
+    }
+    return NULL;
+}
+
+/* Does the line [s, e) match the regex? */
+static bool regex_line(const Matcher *m, const char *s, const char *e) {
+#ifdef REG_STARTEND
+    regmatch_t pm = { .rm_so = 0, .rm_eo = e - s };
+    return regexec(&m->re, s, 1, &pm, REG_STARTEND) == 0;
+#else
+    char small[1024], *buf = (size_t)(e - s) < sizeof(small) ? small : malloc((size_t)(e - s) + 1);
+    memcpy(buf, s, (size_t)(e - s));
+    buf[e - s] = '\0';
+    bool hit = regexec(&m->re, buf, 0, NULL, 0) == 0;
+    if (buf != small) free(buf);
+    return hit;
+#endif
+}
+
+/* The longest run of plain characters every match must contain, or NULL.
+ * Only runs outside groups and bracket expressions count, and alternation
+ * gives up, since then no single literal is required. */
+static char *required_literal(const char *re, size_t *len) {
+    if (strchr(re, '|')) return NULL;
+    const char *best = NULL;
+    size_t best_len = 0;
+    int depth = 0;
+    for (const char *p = re; *p;) {
+        const char *run = p;
+        while (*p && !strchr(".[]()*+?{}^$\\", *p)) p++;
+        size_t n = (size_t)(p - run);
+        if (n && (*p == '*' || *p == '?' || *p == '{')) n--;  /* Last char is optional */
+        if (depth == 0 && n > best_len) { best = run; best_len = n; }
+
+        if (*p == '\\' && p[1]) {
+            p += 2;
+        } else if (*p == '[') {  /* Skip the bracket expression; ']' first is literal */
+            p++;
+            if (*p == '^') p++;
+            if (*p == ']') p++;
+            while (*p && *p != ']') p++;
+            if (*p) p++;
+        } else if (*p) {
+            if (*p == '(') depth++;
+            if (*p == ')' && depth) depth--;
+            p++;
+        }
+    }
+    if (best_len < PREFILTER_MIN) return NULL;
+    *len = best_len;
+    return strndup(best, best_len);
+}
+
+static bool matcher_init(Matcher *m, const char *pattern, bool regex, bool icase,
+                         char *err, size_t errlen) {
+    memset(m, 0, sizeof(*m));
+    m->regex = regex;
+    m->icase = icase;
+    if (regex) {
+        int rc = regcomp(&m->re, pattern, REG_EXTENDED | REG_NEWLINE | REG_NOSUB | (icase ? REG_ICASE : 0));
+        if (rc) {
+            char msg[256];
+            regerror(rc, &m->re, msg, sizeof(msg));
+            snprintf(err, errlen, "Error: bad regex: %s", msg);
+            return false;
+        }
+        m->lit = required_literal(pattern, &m->lit_len);
+    } else {
+        m->lit = strdup(pattern);
+        m->lit_len = strlen(pattern);
+    }
+    if (m->lit && icase)
+        for (size_t i = 0; i < m->lit_len; i++) m->lit[i] = (char)tolower((unsigned char)m->lit[i]);
+    return true;
+}
+
+static void matcher_free(Matcher *m) {
+    if (m->regex) regfree(&m->re);
+    free(m->lit);
+}
+
+/* Find the next matching line at or after `p`. Sets [*ls, *le) to it. */
+static bool next_match(const Matcher *m, const char *p, const char *end,
+                       const char **ls, const char **le) {
+    while (p < end) {
+        const char *s, *e;
+        if (m->lit) {
+            const char *hit = find_literal(m, p, end);
+            if (!hit) return false;
+            s = hit;
+            while (s > p && s[-1] != '\n') s--;
+        } else {
+            s = p;
+        }
+        e = memchr(s, '\n', (size_t)(end - s));
+        if (!e) e = end;
+        if (!m->regex || regex_line(m, s, e)) {
+            *ls = s;
+            *le = e;
+            return true;
+        }
+        p = e + 1;
+    }
+    return false;
+}
+
+static bool name_matches(const Matcher *m, const char *name) {
+    size_t n = strlen(name);
+    if (m->regex) return regex_line(m, name, name + n);
+    return find_literal(m, name, name + n) != NULL;
+}
+
+/* ── Walk ───────────────────────────────────────────────────── */
+
+typedef struct {
+    char      *rel;   /* Relative to the search root; "" for the root */
+    IgnoreSet *ign;
+} DirItem;
+
+/* Formatted matches of one file. */
+typedef struct {
+    char  *rel;
+    char  *text;
+    size_t count;     /* Matching lines */
+    size_t shown;     /* Of which formatted in `text` */
+    bool   name_hit;
+} FileHits;
+
+typedef struct {
+    const char *root;        /* Absolute directory searched */
+    const char *shown_root;  /* Prefix for printed paths ("" = none) */
+    Matcher     m;
+    const char *glob;
+    int         context;
+    size_t      max_results;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    DirItem        *stack;
+    size_t          nstack, cap_stack;
+    int             active;    /* Workers busy with a directory */
+    atomic_bool     stop;      /* Hard cap reached */
+
+    FileHits  *files;
+    size_t     nfiles, cap_files;
+    size_t     hits, searched, skipped_big, skipped_bin;
+    IgnoreSet *all_ign;
+} Search;
+
+/* "path:12:text" for matches, "path-12-text" for context, like grep. */
+static void add_line(Buf *b, const Search *s, const char *rel, size_t no, char sep,
+                     const char *ls, const char *le) {
+    char head[64];
+    int n = snprintf(head, sizeof(head), "%c%zu%c", sep, no, sep);
+    if (s->shown_root[0]) {
+        buf_add(b, s->shown_root, strlen(s->shown_root));
+        buf_add(b, "/", 1);
+    }
+    buf_add(b, rel, strlen(rel));
+    buf_add(b, head, (size_t)n);
+    size_t len = (size_t)(le - ls);
+    if (len && ls[len - 1] == '\r') len--;
+    if (len > SHOW_LINE_MAX) {
+        buf_add(b, ls, SHOW_LINE_MAX);
+        buf_add(b, "...", 3);
+    } else {
+        buf_add(b, ls, len);
+    }
+    buf_add(b, "\n", 1);
+}
+
+static void search_file(Search *s, int dirfd, const char *name, const char *rel, char *scratch) {
+    int fd = openat(dirfd, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) { close(fd); return; }
+    if (st.st_size > SEARCH_MAX_FILE) {
+        close(fd);
+        pthread_mutex_lock(&s->lock);
+        s->skipped_big++;
+        pthread_mutex_unlock(&s->lock);
+        return;
+    }
+    /* Small files are cheaper to read() into the worker's buffer than to
+     * map: a mapping costs a page fault per 4KB touched. */
+    size_t size = (size_t)st.st_size;
+    const char *data;
+    bool mapped = size > SEARCH_READ_MAX;
+    if (mapped) {
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) madvise((void *)data, size, MADV_SEQUENTIAL);
+    } else {
+        size_t got = 0;
+        while (got < size) {
+            ssize_t n = read(fd, scratch + got, size - got);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            got += (size_t)n;
+        }
+        data = scratch;
+        size = got;
+    }
+    close(fd);
+    if (data == MAP_FAILED || size == 0) return;
+    if (mapped) map_guard_arm(data, size);
+
+    bool binary = memchr(data, '\0', size < BINARY_PROBE ? size : BINARY_PROBE) != NULL;
+    Buf out = {0};
+    size_t count = 0;
+    if (!binary) {
+        const char *end = data + size;
+        const char *pos = data;          /* Scan position */
+        const char *cur = data;          /* Start of line number `line` */
+        size_t line = 1;
+        size_t printed = 0;              /* Last line emitted */
+        const char *printed_end = data;  /* Start of the line after it */
+        size_t after_until = 0;          /* Trailing context owed up to this line */
+        const char *ls, *le;
+
+        while (next_match(&s->m, pos, end, &ls, &le)) {
+            if (count >= s->max_results) {  /* Past the cap: count only */
+                count++;
+                pos = le + 1;
+                if (pos >= end || count >= SEARCH_HARD_CAP) break;
+                continue;
+            }
+            while (cur < ls) {
+                const char *nl = memchr(cur, '\n', (size_t)(ls - cur));
+                if (!nl) break;
+                cur = nl + 1;
+                line++;
+            }
+
+            /* Trailing context of the previous match, up to this one */
+            while (printed && printed < after_until && printed + 1 < line) {
+                const char *e = memchr(printed_end, '\n', (size_t)(end - printed_end));
+                if (!e) e = end;
+                add_line(&out, s, rel, ++printed, '-', printed_end, e);
+                printed_end = e < end ? e + 1 : end;
+            }
+
+            /* Leading context, walking back from the match */
+            size_t first = line > (size_t)s->context ? line - (size_t)s->context : 1;
+            if (first <= printed) first = printed + 1;
+            if (printed && first > printed + 1) buf_add(&out, "--\n", 3);
+            const char *cs = ls;
+            for (size_t k = first; k < line; k++) {
+                cs--;
+                while (cs > data && cs[-1] != '\n') cs--;
+            }
+            for (size_t k = first; k < line; k++) {
+                const char *e = memchr(cs, '\n', (size_t)(ls - cs));
+                add_line(&out, s, rel, k, '-', cs, e);
+                cs = e + 1;
+            }
+
+            add_line(&out, s, rel, line, ':', ls, le);
+            printed = line;
+            printed_end = le < end ? le + 1 : end;
+            after_until = line + (size_t)s->context;
+            count++;
+            pos = printed_end;
+            if (pos >= end) break;
+        }
+        while (printed && printed < after_until && printed_end < end) {
+            const char *e = memchr(printed_end, '\n', (size_t)(end - printed_end));
+            if (!e) e = end;
+            add_line(&out, s, rel, ++printed, '-', printed_end, e);
+            printed_end = e < end ? e + 1 : end;
+        }
+    }
+    if (mapped) {
+        if (map_guard_disarm()) count = 0;  /* Truncated while we read it: drop its matches */
+        munmap((void *)data, size);
+    }
+
+    pthread_mutex_lock(&s->lock);
+    s->searched++;
+    if (binary) s->skipped_bin++;
+    if (count) {
+        if (s->nfiles == s->cap_files) {
+            s->cap_files = s->cap_files ? s->cap_files * 2 : 64;
+            s->files = realloc(s->files, s->cap_files * sizeof(FileHits));
+        }
+        size_t shown = count < s->max_results ? count : s->max_results;
+        s->files[s->nfiles++] = (FileHits){ strdup(rel), out.data, count, shown, name_matches(&s->m, name) };
+        s->hits += count;
+        if (s->hits >= SEARCH_HARD_CAP) s->stop = true;
+        out.data = NULL;
+    }
+    pthread_mutex_unlock(&s->lock);
+    free(out.data);
+}
+
+/* Caller holds s->lock. */
+static void push_dir(Search *s, char *rel, IgnoreSet *ign) {
+    if (s->nstack == s->cap_stack) {
+        s->cap_stack = s->cap_stack ? s->cap_stack * 2 : 64;
+        s->stack = realloc(s->stack, s->cap_stack * sizeof(DirItem));
+    }
+    s->stack[s->nstack++] = (DirItem){ rel, ign };
+    pthread_cond_signal(&s->cond);
+}
+
+static void walk_dir(Search *s, DirItem item, char *scratch) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s%s%s", s->root, item.rel[0] ? "/" : "", item.rel);
+    int dfd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dfd < 0) return;
+    DIR *d = fdopendir(dfd);
+    if (!d) { close(dfd); return; }
+
+    pthread_mutex_lock(&s->lock);
+    IgnoreSet *ign = ignore_load(path, strlen(item.rel), item.ign, &s->all_ign);
+    pthread_mutex_unlock(&s->lock);
+    if (!ign) ign = item.ign;
+
+    struct dirent *ent;
+    while ((ent = readdir(d)) && !s->stop) {
+        const char *name = ent->d_name;
+        if (ignore_always(name)) continue;
+
+        int type = ent->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            if (fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) < 0) continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_LNK;
+        }
+        if (type != DT_DIR && type != DT_REG) continue;  /* Symlinks aren't followed */
+
+        char rel[4096];
+        snprintf(rel, sizeof(rel), "%s%s%s", item.rel, item.rel[0] ? "/" : "", name);
+        if (ignore_match(ign, rel, name, type == DT_DIR)) continue;
+
+        if (type == DT_DIR) {
+            pthread_mutex_lock(&s->lock);
+            push_dir(s, strdup(rel), ign);
+            pthread_mutex_unlock(&s->lock);
+        } else if (!s->glob || fnmatch(s->glob, name, 0) == 0) {
+            search_file(s, dfd, name, rel, scratch);
+        }
+    }
+    closedir(d);
+}
+
+static void *search_worker(void *arg) {
+    Search *s = arg;
+    char *scratch = malloc(SEARCH_READ_MAX);
+    pthread_mutex_lock(&s->lock);
+    for (;;) {
+        while (!s->nstack && s->active && !s->stop) pthread_cond_wait(&s->cond, &s->lock);
+        if (!s->nstack || s->stop) break;
+        DirItem item = s->stack[--s->nstack];
+        s->active++;
+        pthread_mutex_unlock(&s->lock);
+
+        walk_dir(s, item, scratch);
+        free(item.rel);
+
+        pthread_mutex_lock(&s->lock);
+        s->active--;
+    }
+    pthread_cond_broadcast(&s->cond);  /* Wake the others to notice we're done */
+    pthread_mutex_unlock(&s->lock);
+    free(scratch);
+    return NULL;
+}
+
+/* Name hits first, then by path, so results are stable run to run. */
+static int file_cmp(const void *a, const void *b) {
+    const FileHits *x = a, *y = b;
+    if (x->name_hit != y->name_hit) return x->name_hit ? -1 : 1;
+    return strcmp(x->rel, y->rel);
+}
+
+/* ── Tool ───────────────────────────────────────────────────── */
+
+ToolExecResult tool_search_exec(const char *input_json, const char *workspace) {
+    ToolExecResult r = {0, NULL};
+
+    cJSON *args = cJSON_Parse(input_json);
+    if (!args) { r.output = strdup("Error: invalid JSON"); return r; }
+
+    cJSON *pattern = cJSON_GetObjectItem(args, "pattern");
+    if (!cJSON_IsString(pattern) || !pattern->valuestring[0]) {
+        r.output = strdup("Error: missing 'pattern'");
+        cJSON_Delete(args);
+        return r;
+    }
+    cJSON *path = cJSON_GetObjectItem(args, "path");
+    cJSON *glob = cJSON_GetObjectItem(args, "glob");
+    cJSON *ctx = cJSON_GetObjectItem(args, "context");
+    cJSON *max = cJSON_GetObjectItem(args, "max_results");
+    const char *sub = cJSON_IsString(path) && path->valuestring[0] ? path->valuestring : ".";
+
+    Search s = {
+        .glob = cJSON_IsString(glob) && glob->valuestring[0] ? glob->valuestring : NULL,
+        .context = cJSON_IsNumber(ctx) ? (int)ctx->valuedouble : 2,
+        .max_results = cJSON_IsNumber(max) && max->valuedouble >= 1 ? (size_t)max->valuedouble
+                                                                   : DEFAULT_RESULTS,
+    };
+    if (s.context < 0) s.context = 0;
+    if (s.context > MAX_CONTEXT) s.context = MAX_CONTEXT;
+    if (s.max_results > MAX_RESULTS) s.max_results = MAX_RESULTS;
+
+    char err[300];
+    if (!matcher_init(&s.m, pattern->valuestring, cJSON_IsTrue(cJSON_GetObjectItem(args, "regex")),
+                      cJSON_IsTrue(cJSON_GetObjectItem(args, "ignore_case")), err, sizeof(err))) {
+        r.output = strdup(err);
+        cJSON_Delete(args);
+        return r;
+    }
+
+    char root[4096];
+    const char *rel = ws_path_rel(workspace, sub, err, sizeof(err));
+    struct stat st;
+    if (rel) snprintf(root, sizeof(root), "%s%s%s", workspace, rel[0] ? "/" : "", rel);
+    if (!rel || stat(root, &st) < 0 || !S_ISDIR(st.st_mode)) {
+        if (rel) snprintf(err, sizeof(err), "Error: %s is not a directory", sub);
+        r.output = strdup(err);
+        matcher_free(&s.m);
+        cJSON_Delete(args);
+        return r;
+    }
+    s.root = root;
+    s.shown_root = strcmp(sub, ".") ? sub : "";
+
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.cond, NULL);
+    push_dir(&s, strdup(""), NULL);
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nthreads = ncpu < 2 ? 2 : ncpu > SEARCH_THREADS ? SEARCH_THREADS : (int)ncpu;
+    pthread_t threads[SEARCH_THREADS];
+    int started = 0;
+    for (int i = 0; i < nthreads; i++)
+        if (pthread_create(&threads[started], NULL, search_worker, &s) == 0) started++;
+    if (!started) search_worker(&s);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+    qsort(s.files, s.nfiles, sizeof(FileHits), file_cmp);
+
+    Buf out = {0};
+    char line[512];
+    int n = snprintf(line, sizeof(line), "[%zu matches in %zu files; %zu files searched",
+                     s.hits, s.nfiles, s.searched);
+    buf_add(&out, line, (size_t)n);
+    if (s.stop) {
+        n = snprintf(line, sizeof(line), "; stopped after %d matches, narrow the search", SEARCH_HARD_CAP);
+        buf_add(&out, line, (size_t)n);
+    }
+    if (s.skipped_big) {
+        n = snprintf(line, sizeof(line), "; %zu files over %ld MB skipped", s.skipped_big, SEARCH_MAX_FILE >> 20);
+        buf_add(&out, line, (size_t)n);
+    }
+    buf_add(&out, "]\n", 2);
+
+    size_t shown = 0, i = 0;
+    for (; i < s.nfiles && shown < s.max_results && out.len < OUTPUT_MAX; i++) {
+        if (i) buf_add(&out, "--\n", 3);
+        buf_add(&out, s.files[i].text, strlen(s.files[i].text));
+        if (s.files[i].count > s.files[i].shown) {
+            n = snprintf(line, sizeof(line), "[%zu more matches in this file not shown]\n",
+                         s.files[i].count - s.files[i].shown);
+            buf_add(&out, line, (size_t)n);
+        }
+        shown += s.files[i].shown;
+    }
+    if (i < s.nfiles) {
+        n = snprintf(line, sizeof(line), "[%zu more files with matches not shown:", s.nfiles - i);
+        buf_add(&out, line, (size_t)n);
+        for (size_t k = i; k < s.nfiles && k < i + 20; k++) {
+            buf_add(&out, " ", 1);
+            if (s.shown_root[0]) {
+                buf_add(&out, s.shown_root, strlen(s.shown_root));
+                buf_add(&out, "/", 1);
+            }
+            buf_add(&out, s.files[k].rel, strlen(s.files[k].rel));
+        }
+        buf_add(&out, s.nfiles - i > 20 ? " ...]\n" : "]\n", s.nfiles - i > 20 ? 6 : 2);
+    }
+
+    r.output = out.data;
+    r.success = 1;
+    LOG_INFO("search: '%s' in %s: %zu matches in %zu/%zu files",
+             pattern->valuestring, sub, s.hits, s.nfiles, s.searched);
+
+    for (size_t k = 0; k < s.nfiles; k++) {
+        free(s.files[k].rel);
+        free(s.files[k].text);
+    }
+    free(s.files);
+    for (size_t k = 0; k < s.nstack; k++) free(s.stack[k].rel);
+    free(s.stack);
+    ignore_free_all(s.all_ign);
+    pthread_cond_destroy(&s.cond);
+    pthread_mutex_destroy(&s.lock);
+    matcher_free(&s.m);
+    cJSON_Delete(args);
+    return r;
+}
+
+void tool_search_register(void) {
+    static const ToolDef def = {
+        .name = "search",
+        .description = "Search file contents under a workspace directory, like grep -rn with "
+                       "context. Honours .gitignore, skips binary files and doesn't follow "
+                       "symlinks. Prefer this to running grep through the shell.",
+        .input_schema =
+            "{"
+                "\"type\":\"object\","
+                "\"properties\":{"
+                    "\"pattern\":{\"type\":\"string\",\"description\":\"Text to find (a POSIX extended regex if regex is true)\"},"
+                    "\"path\":{\"type\":\"string\",\"description\":\"Directory to search (default: workspace root)\"},"
+                    "\"regex\":{\"type\":\"boolean\",\"description\":\"Treat pattern as a regex\"},"
+                    "\"ignore_case\":{\"type\":\"boolean\"},"
+                    "\"glob\":{\"type\":\"string\",\"description\":\"Only files whose name matches, e.g. *.c\"},"
+                    "\"context\":{\"type\":\"integer\",\"description\":\"Lines of context around matches (default 2, max 10)\"},"
+                    "\"max_results\":{\"type\":\"integer\",\"description\":\"Matches to show (default 50, max 500)\"}"
+                "},"
+                "\"required\":[\"pattern\"]"
+            "}",
+        .fn = tool_search_exec,
+        .flags = TOOL_READ_ONLY | TOOL_CONCURRENT | TOOL_IDEMPOTENT,
+    };
+    tools_register(&def);
+}
@@ -0,0 +1,11 @@
+#ifndef CCLAW_TOOL_SEARCH_H
+#define CCLAW_TOOL_SEARCH_H
+
+#include "tools.h"
+
+ToolExecResult tool_search_exec(const char *input_json, const char *workspace);
+
+/* Register the search tool. */
+void tool_search_register(void);
+
+#endif
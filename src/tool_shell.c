@@ -1,88 +1,907 @@
 #include "tool_shell.h"
 #include "log.h"
+#include "sandbox.h"
+#include "util.h"
 #include <cJSON.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/random.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 
-#define MAX_OUTPUT (128 * 1024)  /* 128KB max output */
+#define MEM_TAG MEM_TOOLS
+#include "mem.h"
+
+#define OUTPUT_HEAD  (64 * 1024)  /* Start of the output kept for the model */
+#define OUTPUT_TAIL  (64 * 1024)  /* End of the output kept for the model */
+#define MAX_OUTPUT   (OUTPUT_HEAD + OUTPUT_TAIL)
+#define LINE_SNAP    1024         /* Max bytes trimmed to cut at a line break */
+#define SPILL_MAX    (64L * 1024 * 1024)  /* Largest spill file */
+#define SPILL_KEEP   16           /* Spill files kept before the oldest is removed */
 #define TIMEOUT_SECS 30
+#define REAP_POLL_MS 100         /* Exit polling interval without pidfd */
+#define READ_CHUNK   4096
+#define SCAN_KEEP    128         /* Bytes kept between reads to find a split sentinel */
 
-ToolExecResult tool_shell_exec(const char *input_json, const char *workspace) {
-    ToolExecResult r = {0, NULL};
+extern char **environ;
 
-    cJSON *args = cJSON_Parse(input_json);
-    if (!args) {
-        r.output = strdup("Error: invalid JSON input");
-        return r;
+static ShellLimits g_limits = { .timeout = TIMEOUT_SECS };
+
+/* `sh -c` stub that applies g_limits and then execs the real shell, so the
+ * command is confined before it runs (see spawn_sh). Only builtins run
+ * ahead of the exec, so nothing escapes the limits. ulimit can only fail
+ * when the agent's own hard limit is already lower, so that's ignored; a
+ * cgroup that can't be joined fails the command. "" = no limits. */
+static char g_confine[8 * sizeof(g_limits.cgroup) + 512];
+
+/* Append `s` to `buf` in single quotes. */
+static size_t append_quoted(char *buf, size_t len, size_t size, const char *s) {
+    len += (size_t)snprintf(buf + len, size - len, "'");
+    for (; *s && len < size; s++)
+        len += (size_t)snprintf(buf + len, size - len, *s == '\'' ? "'\\''" : "%c", *s);
+    return len + (size_t)snprintf(buf + len, size - len, "'");
+}
+
+void tool_shell_set_limits(const ShellLimits *limits) {
+    g_limits = *limits;
+
+    char *b = g_confine;
+    size_t n = 0, size = sizeof(g_confine);
+    b[0] = '\0';
+    if (g_limits.cgroup[0]) {
+        char procs[sizeof(g_limits.cgroup) + 16];
+        snprintf(procs, sizeof(procs), "%s/cgroup.procs", g_limits.cgroup);
+        n += (size_t)snprintf(b + n, size - n, "{ echo $$ >");
+        n = append_quoted(b, n, size, procs);
+        n += (size_t)snprintf(b + n, size - n, "; } 2>/dev/null || { echo shell: cannot join ");
+        n = append_quoted(b, n, size, g_limits.cgroup);
+        n += (size_t)snprintf(b + n, size - n, " >&2; exit 126; }; ");
     }
+    if (g_limits.cpu_secs > 0)
+        n += (size_t)snprintf(b + n, size - n, "ulimit -t %d 2>/dev/null; ", g_limits.cpu_secs);
+    if (g_limits.mem_mb > 0)    /* KB */
+        n += (size_t)snprintf(b + n, size - n, "ulimit -v %ld 2>/dev/null; ", g_limits.mem_mb << 10);
+    if (g_limits.fsize_mb > 0)  /* 512-byte blocks */
+        n += (size_t)snprintf(b + n, size - n, "ulimit -f %ld 2>/dev/null; ", g_limits.fsize_mb << 11);
+    if (n) snprintf(b + n, size - n, "exec /bin/sh \"$@\"");
+}
 
-    cJSON *cmd = cJSON_GetObjectItem(args, "command");
-    if (!cmd || !cmd->valuestring) {
-        r.output = strdup("Error: missing 'command' parameter");
-        cJSON_Delete(args);
-        return r;
+/* Deadline for the running call, from the registry's timeout for it
+ * (ToolDef.timeout, which is shell_timeout). 0 = none. */
+static long long call_deadline(void) {
+    long left = tool_remaining_ms();
+    return left < 0 ? 0 : now_ms() + left;
+}
+
+/* Milliseconds to wait before `deadline` (0 = none), or 0 if it passed. */
+static int wait_budget(long long deadline) {
+    if (!deadline) return -1;
+    long long left = deadline - now_ms();
+    if (left <= 0) return 0;
+    return (int)(left > 60000 ? 60000 : left);
+}
+
+/* A pidfd becomes readable when the child exits (Linux 5.3+). Returns -1
+ * where unsupported; the caller then polls waitpid() instead. */
+static int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static void set_limit(pid_t pid, int resource, rlim_t value) {
+    struct rlimit rl = { value, value };
+    if (prlimit(pid, resource, &rl, NULL) < 0)
+        LOG_WARN("shell: prlimit(%d) failed: %s", resource, strerror(errno));
+}
+
+/* Apply rlimits and cgroup placement to a shell the sandbox is holding
+ * before it runs (sandbox_spawn waits for sandbox_resume). */
+static bool confine(pid_t pid) {
+    if (g_limits.cgroup[0]) {
+        char procs[600], num[32];
+        snprintf(procs, sizeof(procs), "%s/cgroup.procs", g_limits.cgroup);
+        int n = snprintf(num, sizeof(num), "%d", (int)pid);
+        int fd = open(procs, O_WRONLY | O_CLOEXEC);
+        if (fd < 0 || write(fd, num, (size_t)n) < 0) {
+            LOG_ERROR("shell: cannot move %d into %s: %s", (int)pid, procs, strerror(errno));
+            if (fd >= 0) close(fd);
+            return false;
+        }
+        close(fd);
     }
+    if (g_limits.cpu_secs > 0) set_limit(pid, RLIMIT_CPU, (rlim_t)g_limits.cpu_secs);
+    if (g_limits.mem_mb > 0)   set_limit(pid, RLIMIT_AS, (rlim_t)g_limits.mem_mb << 20);
+    if (g_limits.fsize_mb > 0) set_limit(pid, RLIMIT_FSIZE, (rlim_t)g_limits.fsize_mb << 20);
+    return true;
+}
 
-    LOG_INFO("shell: %s", cmd->valuestring);
+/* A spawned shell: a child of ours, or a command in the sandbox (where
+ * `pid` is the sandbox's init and `fd` its control socket). */
+typedef struct {
+    pid_t pid;
+    int   fd;         /* Readable once it exited: pidfd or control socket; -1 = poll */
+    bool  sandboxed;
+} Proc;
+
+/* Collect the exit status; false if it hasn't exited (and !block). */
+static bool proc_reap(Proc *p, int *status, bool block) {
+    if (p->sandboxed) {
+        SandboxProc sp = { p->pid, p->fd };
+        return sandbox_wait(&sp, status, block);
+    }
+    return waitpid(p->pid, status, block ? 0 : WNOHANG) == p->pid;
+}
+
+/* Kill the shell and everything it started. */
+static void proc_kill(Proc *p) {
+    if (p->sandboxed) {
+        SandboxProc sp = { p->pid, p->fd };
+        sandbox_kill(&sp);
+    } else {
+        kill(-p->pid, SIGKILL);
+    }
+}
+
+static void proc_close(Proc *p) {
+    if (p->fd >= 0) close(p->fd);
+    p->fd = -1;
+}
+
+/* Start /bin/sh in the sandbox; it only runs once confined. */
+static int spawn_sandboxed(char *const argv[], const char *workspace, int in_fd, int out_fd,
+                           int err_fd, Proc *p) {
+    SandboxProc sp;
+    int err = sandbox_spawn(argv, workspace, in_fd, out_fd, err_fd, &sp);
+    if (err) return err;
+    if (!confine(sp.pid) || !sandbox_resume(&sp)) {
+        sandbox_release(&sp);  /* Init kills the namespace */
+        return EPERM;
+    }
+    *p = (Proc){ sp.pid, sp.ctl, true };
+    return 0;
+}
+
+/* Spawn /bin/sh with stdin from `in_fd` (-1 = /dev/null), stdout on
+ * `out_fd` and stderr on `err_fd`, in the workspace, confined — in the
+ * sandbox when one is running. Returns 0 or an errno value.
+ *
+ * posix_spawn instead of fork(): no page-table copy of the agent, so spawn
+ * cost stays flat as RSS grows. Callers pass O_CLOEXEC pipes so only the
+ * dup'ed ends survive exec. The shell gets its own process group (so a
+ * timeout kills everything it started) and default signal dispositions.
+ * posix_spawn runs no code of ours in the child, so with limits set it
+ * starts the g_confine stub, which applies them and execs `argv`. */
+static int spawn_sh(char *const argv[], const char *workspace, int in_fd, int out_fd,
+                    int err_fd, Proc *p) {
+    if (sandbox_active()) return spawn_sandboxed(argv, workspace, in_fd, out_fd, err_fd, p);
+
+    char *confined[8] = { "sh", "-c", g_confine };
+    if (g_confine[0]) {
+        for (int i = 0; i < 4 && argv[i]; i++) confined[3 + i] = argv[i];
+        argv = confined;
+    }
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    if (in_fd >= 0) posix_spawn_file_actions_adddup2(&fa, in_fd, STDIN_FILENO);
+    else posix_spawn_file_actions_addopen(&fa, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fa, out_fd, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&fa, err_fd, STDERR_FILENO);
+    if (workspace && workspace[0]) posix_spawn_file_actions_addchdir_np(&fa, workspace);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t none, all;
+    sigemptyset(&none);
+    sigfillset(&all);
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawnattr_setsigdefault(&attr, &all);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK |
+                                    POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pid;
+    int err = posix_spawn(&pid, "/bin/sh", &fa, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(&attr);
+    if (err) return err;
+
+    *p = (Proc){ pid, open_pidfd(pid), false };
+    return 0;
+}
+
+/* How a supervised command ended, if we ended it. */
+typedef enum { RUN_DONE, RUN_TIMEOUT, RUN_CANCELLED } RunEnd;
+
+/* Result text: a status header, the output, and an optional note. */
+static char *format_result(RunEnd end, int signo, int exit_code,
+                           const char *out, const char *note) {
+    size_t size = strlen(out) + strlen(note) + 96;
+    char *res = malloc(size);
+    if (end == RUN_TIMEOUT) {
+        snprintf(res, size, "[timeout after %ds, killed]\n%s%s", g_limits.timeout, out, note);
+    } else if (end == RUN_CANCELLED) {
+        snprintf(res, size, "[cancelled, killed]\n%s%s", out, note);
+    } else if (signo) {
+        snprintf(res, size, "[signal %d]\n%s%s", signo, out, note);
+    } else {
+        snprintf(res, size, "[exit %d]\n%s%s", exit_code, out, note);
+    }
+    return res;
+}
+
+static int status_code(int status) {
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static int status_signal(int status) {
+    return WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+}
+
+/* ── Output capture ─────────────────────────────────────────── */
+
+/* Output of one command: stdout and stderr interleaved in arrival order
+ * and forwarded live per stream. Memory is bounded: the model gets the
+ * first OUTPUT_HEAD bytes and a ring of the last OUTPUT_TAIL, which is
+ * where errors usually are. Once output outgrows both, everything is
+ * also written to a spill file the model can page through. */
+typedef struct {
+    char  *buf;             /* OUTPUT_HEAD bytes of head, then the tail ring */
+    size_t total;           /* Bytes produced so far */
+    int    spill_fd;        /* -1 until output overflows */
+    bool   spill_failed;
+    char   spill[128];      /* Spill file, host path */
+    char   spill_shown[32]; /* ... and as the command sees it */
+    bool   cancelled;       /* The live-output consumer asked us to stop */
+} Output;
+
+static char            g_spills[SPILL_KEEP][128];
+static int             g_spill_next;
+static pthread_mutex_t g_spill_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void output_init(Output *o) {
+    memset(o, 0, sizeof(*o));
+    o->buf = malloc(MAX_OUTPUT);
+    o->spill_fd = -1;
+}
+
+static void output_free(Output *o) {
+    if (o->spill_fd >= 0) close(o->spill_fd);
+    free(o->buf);
+}
+
+/* Bytes held in the tail ring, and where its oldest byte is. */
+static size_t tail_len(const Output *o) {
+    size_t n = o->total > OUTPUT_HEAD ? o->total - OUTPUT_HEAD : 0;
+    return n < OUTPUT_TAIL ? n : OUTPUT_TAIL;
+}
+
+static size_t tail_start(const Output *o) {
+    return o->total > MAX_OUTPUT ? (o->total - OUTPUT_HEAD) % OUTPUT_TAIL : 0;
+}
+
+static void spill_write(Output *o, const char *data, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(o->spill_fd, data, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) {
+            LOG_WARN("shell: spill to %s failed: %s", o->spill, strerror(errno));
+            close(o->spill_fd);
+            o->spill_fd = -1;
+            o->spill_failed = true;
+            return;
+        }
+        data += w;
+        n -= (size_t)w;
+    }
+}
+
+/* Output is about to overflow the buffers: move it to a spill file,
+ * starting with everything captured so far (nothing has been dropped
+ * yet). Only the last SPILL_KEEP files are kept. Sandboxed commands have
+ * their own /tmp, so the file goes there for them to page through. */
+static void spill_open(Output *o) {
+    snprintf(o->spill, sizeof(o->spill), "%s/cclaw-out-XXXXXX",
+             sandbox_active() ? sandbox_tmp() : "/tmp");
+    o->spill_fd = mkostemp(o->spill, O_CLOEXEC);
+    if (o->spill_fd < 0) {
+        LOG_WARN("shell: cannot create spill file: %s", strerror(errno));
+        o->spill_failed = true;
+        return;
+    }
+    snprintf(o->spill_shown, sizeof(o->spill_shown), "/tmp/%s", strrchr(o->spill, '/') + 1);
+
+    pthread_mutex_lock(&g_spill_lock);
+    char *slot = g_spills[g_spill_next];
+    if (slot[0]) unlink(slot);
+    snprintf(slot, sizeof(g_spills[0]), "%s", o->spill);
+    g_spill_next = (g_spill_next + 1) % SPILL_KEEP;
+    pthread_mutex_unlock(&g_spill_lock);
+
+    spill_write(o, o->buf, o->total);
+}
+
+static void output_add(Output *o, ToolStream stream, const char *data, size_t n) {
+    if (!tool_emit(stream, data, n)) o->cancelled = true;
+
+    if (o->total + n > MAX_OUTPUT && o->spill_fd < 0 && !o->spill_failed)
+        spill_open(o);
+    if (o->spill_fd >= 0) {
+        size_t room = o->total < SPILL_MAX ? (size_t)(SPILL_MAX - o->total) : 0;
+        spill_write(o, data, n < room ? n : room);
+    }
+
+    if (o->total < OUTPUT_HEAD) {
+        size_t take = OUTPUT_HEAD - o->total;
+        if (take > n) take = n;
+        memcpy(o->buf + o->total, data, take);
+        o->total += take;
+        data += take;
+        n -= take;
+    }
+    if (n > OUTPUT_TAIL) {  /* Only the last OUTPUT_TAIL bytes can survive */
+        o->total += n - OUTPUT_TAIL;
+        data += n - OUTPUT_TAIL;
+        n = OUTPUT_TAIL;
+    }
+    char *ring = o->buf + OUTPUT_HEAD;
+    while (n > 0) {
+        size_t at = (o->total - OUTPUT_HEAD) % OUTPUT_TAIL;
+        size_t take = OUTPUT_TAIL - at;
+        if (take > n) take = n;
+        memcpy(ring + at, data, take);
+        o->total += take;
+        data += take;
+        n -= take;
+    }
+}
+
+/* The captured output as one string. Output that didn't fit is shown as
+ * head + marker + tail, each side trimmed to a line break when one is
+ * close, with a pointer to the spill file. Caller frees. */
+static char *output_text(const Output *o) {
+    size_t tlen = tail_len(o);
+    size_t head = o->total < OUTPUT_HEAD ? o->total : OUTPUT_HEAD;
+    char *res = malloc(head + tlen + 256);
+    memcpy(res, o->buf, head);
+
+    /* Unwrap the ring after the head */
+    size_t start = tail_start(o);
+    char *tail = res + head;
+    memcpy(tail, o->buf + OUTPUT_HEAD + start, tlen - start);
+    memcpy(tail + tlen - start, o->buf + OUTPUT_HEAD, start);
+
+    if (o->total <= MAX_OUTPUT) {
+        res[head + tlen] = '\0';
+        return res;
+    }
+
+    size_t cut_head = head, skip_tail = 0;
+    for (size_t i = head; i > head - LINE_SNAP; i--)
+        if (res[i - 1] == '\n') { cut_head = i; break; }
+    for (size_t i = 0; i < LINE_SNAP; i++)
+        if (tail[i] == '\n') { skip_tail = i + 1; break; }
+    size_t omitted = o->total - cut_head - (tlen - skip_tail);
+
+    char note[200];
+    if (o->spill_fd >= 0) {
+        char kept[32] = "";
+        if (o->total > SPILL_MAX) snprintf(kept, sizeof(kept), ", first %ld MB kept", SPILL_MAX >> 20);
+        snprintf(note, sizeof(note),
+                 "\n[... %zu bytes omitted; full output (%zu bytes%s) in %s ...]\n",
+                 omitted, o->total, kept, o->spill_shown);
+    } else {
+        snprintf(note, sizeof(note), "\n[... %zu bytes omitted ...]\n", omitted);
+    }
+
+    size_t nlen = strlen(note), keep = tlen - skip_tail;
+    memmove(res + cut_head + nlen, tail + skip_tail, keep);
+    memcpy(res + cut_head, note, nlen);
+    res[cut_head + nlen + keep] = '\0';
+    return res;
+}
+
+/* Read one chunk from `*fd` into the output. Closes the fd and sets it to
+ * -1 at EOF. Pipes are always drained, so a chatty command never blocks
+ * on a full pipe however much it writes. */
+static void output_read(Output *o, int *fd, ToolStream stream) {
+    char chunk[READ_CHUNK];
+    ssize_t n = read(*fd, chunk, sizeof(chunk));
+    if (n > 0) {
+        output_add(o, stream, chunk, (size_t)n);
+    } else if (n == 0 || errno != EINTR) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+/* Take whatever is already buffered in `*fd`, then close it. */
+static void output_drain(Output *o, int *fd, ToolStream stream) {
+    struct pollfd p = { *fd, POLLIN, 0 };
+    while (*fd >= 0 && poll(&p, 1, 0) > 0) output_read(o, fd, stream);
+    if (*fd >= 0) { close(*fd); *fd = -1; }
+}
+
+/* ── One-shot commands ──────────────────────────────────────── */
+
+static ToolExecResult run_oneshot(const char *cmd, const char *workspace) {
+    ToolExecResult r = {0, NULL};
 
-    /* Fork and exec with pipe */
-    int pipefd[2];
-    if (pipe(pipefd) < 0) {
+    int out[2], err[2];
+    if (pipe2(out, O_CLOEXEC) < 0) {
+        r.output = strdup("Error: pipe() failed");
+        return r;
+    }
+    if (pipe2(err, O_CLOEXEC) < 0) {
+        close(out[0]);
+        close(out[1]);
         r.output = strdup("Error: pipe() failed");
-        cJSON_Delete(args);
         return r;
     }
 
-    pid_t pid = fork();
-    if (pid < 0) {
-        r.output = strdup("Error: fork() failed");
-        close(pipefd[0]);
-        close(pipefd[1]);
-        cJSON_Delete(args);
+    char *argv[] = { "sh", "-c", (char *)cmd, NULL };
+    Proc p;
+    int rc = spawn_sh(argv, workspace, -1, out[1], err[1], &p);
+    close(out[1]);
+    close(err[1]);
+    if (rc) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "Error: cannot spawn shell: %s", strerror(rc));
+        r.output = strdup(msg);
+        close(out[0]);
+        close(err[0]);
         return r;
     }
 
-    if (pid == 0) {
-        /* Child */
-        close(pipefd[0]);
-        dup2(pipefd[1], STDOUT_FILENO);
-        dup2(pipefd[1], STDERR_FILENO);
-        close(pipefd[1]);
+    long long deadline = call_deadline();
+
+    Output o;
+    output_init(&o);
+    int fds[2] = { out[0], err[0] };
+    int status = 0;
+    bool reaped = false;
+    RunEnd end = RUN_DONE;
+
+    /* Read until both pipes close and the child has exited. */
+    while (fds[0] >= 0 || fds[1] >= 0 || !reaped) {
+        int wait_ms = wait_budget(deadline);
+        if (wait_ms == 0) { end = RUN_TIMEOUT; break; }
+        if (p.fd < 0 && !reaped && (wait_ms < 0 || wait_ms > REAP_POLL_MS))
+            wait_ms = REAP_POLL_MS;
+
+        struct pollfd pfd[3];
+        int nfds = 0, idx[2] = { -1, -1 }, pid_idx = -1;
+        for (int k = 0; k < 2; k++)
+            if (fds[k] >= 0) { pfd[nfds] = (struct pollfd){ fds[k], POLLIN, 0 }; idx[k] = nfds++; }
+        if (p.fd >= 0 && !reaped) { pfd[nfds] = (struct pollfd){ p.fd, POLLIN, 0 }; pid_idx = nfds++; }
+
+        int pr = poll(pfd, (nfds_t)nfds, wait_ms);
+        if (pr < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("shell: poll failed: %s", strerror(errno));
+            end = RUN_TIMEOUT;  /* Can't supervise it any more — kill it */
+            break;
+        }
+
+        for (int k = 0; k < 2; k++)
+            if (idx[k] >= 0 && pfd[idx[k]].revents)
+                output_read(&o, &fds[k], k ? TOOL_STDERR : TOOL_STDOUT);
+        if (o.cancelled) { end = wait_budget(deadline) == 0 ? RUN_TIMEOUT : RUN_CANCELLED; break; }
+
+        if (!reaped && (p.fd < 0 || (pid_idx >= 0 && pfd[pid_idx].revents))) {
+            if (proc_reap(&p, &status, false)) reaped = true;
+        }
+
+        /* The shell is gone but a background job still holds a pipe:
+         * take what's buffered and stop waiting for it. */
+        if (reaped) {
+            for (int k = 0; k < 2; k++)
+                if (fds[k] >= 0) output_drain(&o, &fds[k], k ? TOOL_STDERR : TOOL_STDOUT);
+        }
+    }
+
+    if (end != RUN_DONE) {
+        LOG_WARN("shell: %s, killing process group %d",
+                 end == RUN_TIMEOUT ? "timed out" : "cancelled", (int)p.pid);
+        proc_kill(&p);
+        if (!reaped) proc_reap(&p, &status, true);
+    }
+    for (int k = 0; k < 2; k++) if (fds[k] >= 0) close(fds[k]);
+    proc_close(&p);
+
+    char *text = output_text(&o);
+    r.output = format_result(end, status_signal(status), status_code(status), text, "");
+    r.success = end == RUN_DONE && status_code(status) == 0;
+    free(text);
+    output_free(&o);
+    return r;
+}
+
+/* ── Persistent shells ──────────────────────────────────────────
+ *
+ * With a pool configured, each session keeps a long-lived /bin/sh so cwd,
+ * variables and activated environments carry over between calls. A
+ * command is written to a per-shell script file and sourced with `.`, so
+ * the shell never parses it from the pipe (an unbalanced quote can't make
+ * it swallow what follows), with stdin from /dev/null. Each command is
+ * followed by a sentinel line carrying its status:
+ *
+ *   { . '/tmp/cclaw-sh-XXXXXX'; } </dev/null; printf '%s %d\n' '__CCLAW_<rand>__' "$?"
+ *
+ * Stdout is read up to that line; stderr was written before it, so it is
+ * collected from its pipe once the line arrives. A shell that exits or
+ * times out is dropped from the pool and the next call starts a fresh one. */
+
+typedef struct {
+    char   key[512];      /* Session key; "" = free slot */
+    Proc   proc;          /* pid 0 = not started */
+    int    in_fd;         /* Shell's stdin */
+    int    out_fd;        /* Shell's stdout */
+    int    err_fd;        /* Shell's stderr */
+    int    script_fd;
+    char   script[128];   /* Command file, as the agent sees it */
+    char   source[32];    /* ... and as the shell does */
+    char   marker[48];    /* "__CCLAW_<rand>__ " */
+    time_t last_used;
+    bool   busy;
+    bool   reaped;        /* Shell exited and was waited for */
+} PoolShell;
+
+static PoolShell      *g_pool;
+static int             g_pool_size;
+static int             g_pool_idle;
+static pthread_mutex_t g_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void tool_shell_set_pool(int size, int idle_secs) {
+    tool_shell_cleanup();
+    if (size <= 0) return;
+    g_pool = calloc((size_t)size, sizeof(*g_pool));
+    g_pool_size = g_pool ? size : 0;
+    g_pool_idle = idle_secs;
+}
+
+/* Caller holds g_pool_lock (or is the only user of the slot). */
+static void pool_close(PoolShell *sh) {
+    if (sh->proc.pid > 0) {
+        int status;
+        proc_kill(&sh->proc);  /* The shell and any jobs it left behind */
+        if (!sh->reaped) proc_reap(&sh->proc, &status, true);
+        proc_close(&sh->proc);
+        close(sh->in_fd);
+        close(sh->out_fd);
+        if (sh->err_fd >= 0) close(sh->err_fd);
+        close(sh->script_fd);
+        unlink(sh->script);
+    }
+    memset(sh, 0, sizeof(*sh));
+}
+
+void tool_shell_cleanup(void) {
+    pthread_mutex_lock(&g_pool_lock);
+    for (int i = 0; i < g_pool_size; i++) pool_close(&g_pool[i]);
+    free(g_pool);
+    g_pool = NULL;
+    g_pool_size = 0;
+    pthread_mutex_unlock(&g_pool_lock);
+
+    pthread_mutex_lock(&g_spill_lock);
+    for (int i = 0; i < SPILL_KEEP; i++)
+        if (g_spills[i][0]) unlink(g_spills[i]);
+    memset(g_spills, 0, sizeof(g_spills));
+    pthread_mutex_unlock(&g_spill_lock);
+}
+
+/* Claim the session's shell (or a slot for a new one). Returns NULL when
+ * the session's shell is busy or every slot is — run one-shot instead. */
+static PoolShell *pool_acquire(const char *key) {
+    pthread_mutex_lock(&g_pool_lock);
+    time_t now = time(NULL);
+    PoolShell *mine = NULL, *free_slot = NULL, *lru = NULL;
+
+    for (int i = 0; i < g_pool_size; i++) {
+        PoolShell *sh = &g_pool[i];
+        if (sh->key[0] && !sh->busy && g_pool_idle > 0 && now - sh->last_used > g_pool_idle) {
+            LOG_DEBUG("shell: closing idle shell for %s", sh->key);
+            pool_close(sh);
+        }
+        if (!sh->key[0]) {
+            if (!free_slot) free_slot = sh;
+        } else if (!strcmp(sh->key, key)) {
+            mine = sh;
+        } else if (!sh->busy && (!lru || sh->last_used < lru->last_used)) {
+            lru = sh;
+        }
+    }
+
+    PoolShell *sh = NULL;
+    if (mine) {
+        if (!mine->busy) sh = mine;
+    } else if (free_slot || lru) {
+        sh = free_slot ? free_slot : lru;
+        if (sh == lru) pool_close(sh);
+        snprintf(sh->key, sizeof(sh->key), "%s", key);
+    }
+    if (sh) sh->busy = true;
 
-        if (workspace && workspace[0]) chdir(workspace);
+    pthread_mutex_unlock(&g_pool_lock);
+    return sh;
+}
 
-        execl("/bin/sh", "sh", "-c", cmd->valuestring, (char *)NULL);
-        _exit(127);
+static void pool_release(PoolShell *sh, bool alive) {
+    pthread_mutex_lock(&g_pool_lock);
+    if (alive) {
+        sh->busy = false;
+        sh->last_used = time(NULL);
+    } else {
+        pool_close(sh);
     }
+    pthread_mutex_unlock(&g_pool_lock);
+}
 
-    /* Parent */
-    close(pipefd[1]);
+static bool pool_spawn(PoolShell *sh, const char *workspace) {
+    int in[2], out[2], err[2];
+    if (pipe2(in, O_CLOEXEC) < 0) return false;
+    if (pipe2(out, O_CLOEXEC) < 0) {
+        close(in[0]);
+        close(in[1]);
+        return false;
+    }
+    if (pipe2(err, O_CLOEXEC) < 0) {
+        close(in[0]);
+        close(in[1]);
+        close(out[0]);
+        close(out[1]);
+        return false;
+    }
 
-    char *buf = malloc(MAX_OUTPUT);
-    size_t total = 0;
-    ssize_t n;
+    /* A sandboxed shell sees the sandbox's /tmp at /tmp. */
+    snprintf(sh->script, sizeof(sh->script), "%s/cclaw-sh-XXXXXX",
+             sandbox_active() ? sandbox_tmp() : "/tmp");
+    int script_fd = mkostemp(sh->script, O_CLOEXEC);
+    snprintf(sh->source, sizeof(sh->source), "/tmp/%s", strrchr(sh->script, '/') + 1);
 
-    while ((n = read(pipefd[0], buf + total, MAX_OUTPUT - total - 1)) > 0) {
-        total += (size_t)n;
-        if (total >= MAX_OUTPUT - 1) break;
+    char *argv[] = { "sh", NULL };
+    Proc p = { 0, -1, false };
+    int rc = script_fd < 0 ? errno : spawn_sh(argv, workspace, in[0], out[1], err[1], &p);
+    close(in[0]);
+    close(out[1]);
+    close(err[1]);
+    if (rc) {
+        LOG_ERROR("shell: cannot start persistent shell: %s", strerror(rc));
+        close(in[1]);
+        close(out[0]);
+        close(err[0]);
+        if (script_fd >= 0) { close(script_fd); unlink(sh->script); }
+        return false;
     }
-    close(pipefd[0]);
-    buf[total] = '\0';
 
-    int status;
-    waitpid(pid, &status, 0);
-    int exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    unsigned long long nonce;
+    if (getrandom(&nonce, sizeof(nonce), 0) != sizeof(nonce))
+        nonce = (unsigned long long)now_ms() ^ ((unsigned long long)p.pid << 32);
+    snprintf(sh->marker, sizeof(sh->marker), "__CCLAW_%016llx__ ", nonce);
 
-    /* Build result */
-    size_t result_size = total + 64;
-    r.output = malloc(result_size);
-    snprintf(r.output, result_size, "[exit %d]\n%s", exit_code, buf);
-    r.success = (exit_code == 0);
+    sh->proc = p;
+    sh->in_fd = in[1];
+    sh->out_fd = out[0];
+    sh->err_fd = err[0];
+    sh->script_fd = script_fd;
+    LOG_DEBUG("shell: started persistent shell %d for %s", (int)p.pid, sh->key);
+    return true;
+}
+
+/* Write to the shell's stdin without taking SIGPIPE if it has died. */
+static bool write_all(int fd, const char *data, size_t len) {
+    sigset_t pipe_set, old;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, &old);
+
+    bool ok = true;
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EPIPE) {
+                struct timespec zero = {0, 0};
+                sigtimedwait(&pipe_set, NULL, &zero);
+            }
+            ok = false;
+            break;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return ok;
+}
+
+/* Length of the longest tail of `p` that is a proper prefix of `marker` —
+ * bytes that might be the start of a sentinel split across reads. */
+static size_t marker_overlap(const char *p, size_t plen, const char *marker, size_t mlen) {
+    size_t k = plen < mlen - 1 ? plen : mlen - 1;
+    for (; k > 0; k--)
+        if (!memcmp(p + plen - k, marker, k)) return k;
+    return 0;
+}
+
+/* Run `cmd` in a pooled shell. Returns whether the shell is still usable. */
+static bool pool_exec(PoolShell *sh, const char *cmd, ToolExecResult *r) {
+    /* Discard anything background jobs printed since the last command. */
+    char pending[SCAN_KEEP + READ_CHUNK];
+    int fds[2] = { sh->out_fd, sh->err_fd };
+    for (int k = 0; k < 2; k++) {
+        struct pollfd p = { fds[k], POLLIN, 0 };
+        while (poll(&p, 1, 0) > 0 && read(fds[k], pending, sizeof(pending)) > 0) {}
+    }
+
+    size_t clen = strlen(cmd);
+    if (ftruncate(sh->script_fd, 0) < 0 ||
+        pwrite(sh->script_fd, cmd, clen, 0) != (ssize_t)clen ||
+        pwrite(sh->script_fd, "\n", 1, (off_t)clen) != 1) {
+        r->output = strdup("Error: cannot write command script");
+        return false;
+    }
+
+    char line[256];
+    int ln = snprintf(line, sizeof(line),
+        "{ . '%s'; } </dev/null; printf '%%s %%d\\n' '%.*s' \"$?\"\n",
+        sh->source, (int)strlen(sh->marker) - 1, sh->marker);
+
+    const char *marker = sh->marker;
+    size_t mlen = strlen(marker);
+    long long deadline = call_deadline();
+    Output o;
+    output_init(&o);
+    size_t plen = 0;     /* Stdout bytes not yet known to precede the sentinel */
+    int status = 0, code = -1;
+    bool alive = true, done = false;
+    RunEnd end = RUN_DONE;
+
+    if (!write_all(sh->in_fd, line, (size_t)ln)) alive = false;
+
+    while (alive && !done) {
+        int wait_ms = wait_budget(deadline);
+        if (wait_ms == 0) { end = RUN_TIMEOUT; break; }
+
+        struct pollfd pfd[2] = { { sh->out_fd, POLLIN, 0 }, { fds[1], POLLIN, 0 } };
+        int pr = poll(pfd, fds[1] >= 0 ? 2 : 1, wait_ms);
+        if (pr < 0 && errno == EINTR) continue;
+        if (pr < 0) { end = RUN_TIMEOUT; break; }
+
+        if (fds[1] >= 0 && pfd[1].revents) output_read(&o, &fds[1], TOOL_STDERR);
+
+        if (pfd[0].revents) {
+            ssize_t n = read(sh->out_fd, pending + plen, sizeof(pending) - plen);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) { alive = false; break; }  /* Shell exited (e.g. `exit`) */
+            plen += (size_t)n;
+
+            /* Pass on everything that can't be the start of the sentinel. */
+            char *m = memmem(pending, plen, marker, mlen);
+            size_t safe;
+            if (m) {
+                safe = (size_t)(m - pending);
+                if (memchr(m + mlen, '\n', plen - safe - mlen)) {
+                    code = atoi(m + mlen);
+                    done = true;
+                }
+            } else {
+                safe = plen - marker_overlap(pending, plen, marker, mlen);
+            }
+            if (safe) output_add(&o, TOOL_STDOUT, pending, safe);
+            memmove(pending, pending + safe, plen - safe);
+            plen -= safe;
+        }
+        if (o.cancelled && !done) {
+            end = wait_budget(deadline) == 0 ? RUN_TIMEOUT : RUN_CANCELLED;
+            break;
+        }
+    }
+
+    /* Stderr written before the sentinel (or before the shell died) is
+     * already in its pipe. */
+    if (!done && plen) output_add(&o, TOOL_STDOUT, pending, plen);
+    if (end == RUN_DONE && fds[1] >= 0) {
+        struct pollfd p = { fds[1], POLLIN, 0 };
+        while (fds[1] >= 0 && poll(&p, 1, 0) > 0) output_read(&o, &fds[1], TOOL_STDERR);
+    }
+    if (fds[1] < 0) {  /* Stderr closed under us: the shell is going away */
+        sh->err_fd = -1;
+        alive = false;
+    }
+
+    const char *note = "";
+    if (end != RUN_DONE) {
+        LOG_WARN("shell: %s, killing persistent shell %d",
+                 end == RUN_TIMEOUT ? "timed out" : "cancelled", (int)sh->proc.pid);
+        alive = false;
+        note = "\n[persistent shell restarted; cwd and environment were reset]";
+    } else if (!alive) {
+        proc_reap(&sh->proc, &status, true);
+        sh->reaped = true;
+        code = status_code(status);
+        note = "\n[persistent shell exited; cwd and environment were reset]";
+    }
+
+    char *text = output_text(&o);
+    r->output = format_result(end, status_signal(status), code, text, note);
+    r->success = end == RUN_DONE && code == 0;
+    free(text);
+    output_free(&o);
+    return alive;
+}
+
+ToolExecResult tool_shell_exec(const char *input_json, const char *workspace) {
+    ToolExecResult r = {0, NULL};
+
+    cJSON *args = cJSON_Parse(input_json);
+    if (!args) {
+        r.output = strdup("Error: invalid JSON input");
+        return r;
+    }
+
+    cJSON *cmd = cJSON_GetObjectItem(args, "command");
+    if (!cmd || !cmd->valuestring) {
+        r.output = strdup("Error: missing 'command' parameter");
+        cJSON_Delete(args);
+        return r;
+    }
+
+    LOG_INFO("shell: %s", cmd->valuestring);
+
+    const char *session = tool_ctx()->session;
+    PoolShell *sh = g_pool_size > 0 && session ? pool_acquire(session) : NULL;
+    if (sh && !sh->proc.pid && !pool_spawn(sh, workspace)) {
+        pool_release(sh, false);
+        sh = NULL;
+    }
+
+    if (sh) {
+        pool_release(sh, pool_exec(sh, cmd->valuestring, &r));
+    } else {
+        r = run_oneshot(cmd->valuestring, workspace);
+    }
 
-    free(buf);
     cJSON_Delete(args);
     return r;
 }
+
+void tool_shell_register(void) {
+    static ToolDef def = {
+        .name = "shell",
+        .description = "Execute a shell command and return stdout/stderr.",
+        .input_schema =
+            "{"
+                "\"type\":\"object\","
+                "\"properties\":{"
+                    "\"command\":{\"type\":\"string\",\"description\":\"Shell command to execute\"}"
+                "},"
+                "\"required\":[\"command\"]"
+            "}",
+        .fn = tool_shell_exec,
+        .flags = TOOL_CONCURRENT,
+    };
+    def.timeout = g_limits.timeout;
+    if (g_pool_size > 0) {
+        def.description = "Execute a shell command and return stdout/stderr. "
+                          "Runs in a persistent shell: cd, exported variables and "
+                          "activated environments carry over between calls.";
+    }
+    tools_register(&def);
+}
@@ -3,6 +3,30 @@
 
 #include "tools.h"
 
+/* Limits applied to every shell command. Zero means unlimited. */
+typedef struct {
+    int  timeout;        /* Wall-clock seconds before the process group is killed */
+    int  cpu_secs;       /* RLIMIT_CPU */
+    long mem_mb;         /* RLIMIT_AS */
+    long fsize_mb;       /* RLIMIT_FSIZE */
+    char cgroup[512];    /* cgroup v2 directory to place commands in; "" = none */
+} ShellLimits;
+
+/* Set the limits for subsequent commands. Call before tools_init(). */
+void tool_shell_set_limits(const ShellLimits *limits);
+
+/* Keep up to `size` long-lived shells, one per session, so cwd and
+ * environment persist between calls. Shells idle longer than `idle_secs`
+ * (0 = forever) are closed. size 0 disables the pool. Call before
+ * tools_init(). */
+void tool_shell_set_pool(int size, int idle_secs);
+
+/* Close pooled shells. */
+void tool_shell_cleanup(void);
+
 ToolExecResult tool_shell_exec(const char *input_json, const char *workspace);
 
+/* Register the shell tool. */
+void tool_shell_register(void);
+
 #endif
@@ -0,0 +1,96 @@
+/*
+ * The remind tool.
+ *
+ * Schedules a one-shot "agent" timer for the calling session. When it
+ * fires, the reminder runs as a new turn in that session, so the model
+ * sees the conversation it was set in, and the reply goes back to the
+ * chat (see timer_agent_job in main.c). Timers are persisted, so a
+ * reminder survives a restart.
+ */
+
+#include "tool_timer.h"
+#include "log.h"
+#include <cJSON.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MEM_TAG MEM_TOOLS
+#include "mem.h"
+
+#define REMIND_MAX_MINUTES (366.0 * 24 * 60)
+
+static TimerWheel *g_wheel;
+
+ToolExecResult tool_remind_exec(const char *input_json, const char *workspace) {
+    ToolExecResult r = {0, NULL};
+    (void)workspace;
+
+    const char *session = tool_ctx()->session;
+    if (!g_wheel) { r.output = strdup("Error: reminders are not available"); return r; }
+    if (!session || !session[0]) {
+        r.output = strdup("Error: reminders need a saved conversation");
+        return r;
+    }
+
+    cJSON *args = cJSON_Parse(input_json);
+    if (!args) { r.output = strdup("Error: invalid JSON"); return r; }
+    cJSON *msg = cJSON_GetObjectItem(args, "message");
+    cJSON *delay = cJSON_GetObjectItem(args, "delay_minutes");
+    if (!cJSON_IsString(msg) || !msg->valuestring[0]) {
+        r.output = strdup("Error: missing 'message'");
+        cJSON_Delete(args);
+        return r;
+    }
+    if (!cJSON_IsNumber(delay) || delay->valuedouble < 0 || delay->valuedouble > REMIND_MAX_MINUTES) {
+        r.output = strdup("Error: 'delay_minutes' must be between 0 and 527040 (a year)");
+        cJSON_Delete(args);
+        return r;
+    }
+
+    time_t when = time(NULL) + (time_t)(delay->valuedouble * 60 + 0.5);
+    struct tm tm;
+    gmtime_r(&when, &tm);
+    char at[32];
+    strftime(at, sizeof(at), "%Y-%m-%d %H:%M UTC", &tm);
+
+    /* The turn it starts needs to know it's a reminder, not a new request */
+    size_t len = strlen(session) + strlen(msg->valuestring) + 64;
+    char *payload = malloc(len);
+    snprintf(payload, len, "%s\n[Reminder you set for %s] %s", session, at, msg->valuestring);
+    uint64_t id = timer_add(g_wheel, TIMER_KIND_AGENT, when, payload);
+    free(payload);
+    cJSON_Delete(args);
+
+    if (!id) { r.output = strdup("Error: could not schedule the reminder"); return r; }
+    LOG_INFO("remind: timer %llu for %s at %s", (unsigned long long)id, session, at);
+
+    char out[96];
+    snprintf(out, sizeof(out), "Reminder %llu set for %s.", (unsigned long long)id, at);
+    r.output = strdup(out);
+    r.success = 1;
+    return r;
+}
+
+void tool_timer_register(TimerWheel *tw) {
+    static const ToolDef def = {
+        .name = "remind",
+        .description = "Set a reminder for this conversation. After the delay, the message comes "
+                       "back to you as a new turn here and your reply is sent to the user. Use it "
+                       "for \"remind me in 3 hours\" and for follow-ups you want to do later.",
+        .input_schema =
+            "{"
+                "\"type\":\"object\","
+                "\"properties\":{"
+                    "\"message\":{\"type\":\"string\",\"description\":\"What to remind about, with enough context to act on it later\"},"
+                    "\"delay_minutes\":{\"type\":\"number\",\"description\":\"Minutes from now\"}"
+                "},"
+                "\"required\":[\"message\",\"delay_minutes\"]"
+            "}",
+        .fn = tool_remind_exec,
+        .flags = TOOL_CONCURRENT,
+    };
+    g_wheel = tw;
+    tools_register(&def);
+}
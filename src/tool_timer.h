@@ -0,0 +1,17 @@
+#ifndef CCLAW_TOOL_TIMER_H
+#define CCLAW_TOOL_TIMER_H
+
+#include "timer.h"
+#include "tools.h"
+
+/* Timer kind the remind tool schedules. Its payload is
+ * "<session>\n<prompt>"; the handler runs the prompt as a turn in that
+ * session. */
+#define TIMER_KIND_AGENT "agent"
+
+ToolExecResult tool_remind_exec(const char *input_json, const char *workspace);
+
+/* Register the remind tool, scheduling on `tw`. */
+void tool_timer_register(TimerWheel *tw);
+
+#endif
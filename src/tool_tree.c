@@ -0,0 +1,626 @@
+/*
+ * Workspace tree index for the list and glob tools.
+ *
+ * The first call walks the workspace into an in-memory tree of names and
+ * parent links; sizes are only stat'ed for entries actually shown. Each
+ * directory gets an inotify watch, and every later call drains pending
+ * events before answering, so the tree stays current without re-walking
+ * and without a background thread. .gitignore'd paths are left out, as
+ * in search. If the watch limit runs out, the index is instead rebuilt
+ * once it is TREE_TTL seconds old.
+ */
+
+#include "tool_tree.h"
+#include "gitignore.h"
+#include "workspace.h"
+#include "util.h"
+#include "log.h"
+#include <cJSON.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#define MEM_TAG MEM_TOOLS
+#include "mem.h"
+
+#define TREE_MAX_NODES 500000
+#define TREE_TTL       30      /* Seconds an unwatched index is trusted */
+#define PAGE_DEFAULT   200
+#define PAGE_MAX       1000
+#define LIST_MAX_DEPTH 20
+#define WATCH_MASK     (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | \
+                        IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK)
+
+typedef struct {
+    char      *name;     /* NULL = free slot */
+    uint32_t   parent;
+    uint32_t  *kids;
+    uint32_t   nkids, cap;
+    int        wd;       /* inotify watch, -1 = none */
+    bool       dir;
+    bool       sorted;   /* kids in name order */
+    IgnoreSet *ign;      /* Rules for this directory's entries */
+} Node;
+
+static struct {
+    pthread_mutex_t lock;
+    char            root[1024];
+    Node           *nodes;       /* nodes[0] is the workspace root */
+    uint32_t        count, cap, live;
+    uint32_t       *free;        /* Reusable slots */
+    uint32_t        nfree, free_cap;
+    uint32_t       *by_wd;       /* wd -> node + 1 */
+    size_t          wd_cap;
+    int             ifd;
+    bool            built, stale, truncated, unwatched;
+    time_t          built_at;
+    IgnoreSet      *ign_all;
+} g_tree = { .lock = PTHREAD_MUTEX_INITIALIZER, .ifd = -1 };
+
+/* Bumped by every rebuild and applied event; survives tree_free(). */
+static uint64_t g_changes;
+
+/* ── Index ──────────────────────────────────────────────────── */
+
+/* Path of node `i` relative to the root ("" for the root). */
+static void node_path(uint32_t i, char *buf, size_t len) {
+    uint32_t chain[512];
+    int depth = 0;
+    for (; i && depth < 512; i = g_tree.nodes[i].parent) chain[depth++] = i;
+    size_t pos = 0;
+    buf[0] = '\0';
+    while (depth-- > 0 && pos < len) {
+        pos += (size_t)snprintf(buf + pos, len - pos, "%s%s", pos ? "/" : "",
+                                g_tree.nodes[chain[depth]].name);
+    }
+}
+
+static uint32_t node_new(const char *name, uint32_t parent, bool dir) {
+    uint32_t i;
+    if (g_tree.nfree) {
+        i = g_tree.free[--g_tree.nfree];
+    } else {
+        if (g_tree.count == g_tree.cap) {
+            g_tree.cap = g_tree.cap ? g_tree.cap * 2 : 1024;
+            g_tree.nodes = realloc(g_tree.nodes, g_tree.cap * sizeof(Node));
+        }
+        i = g_tree.count++;
+    }
+    g_tree.nodes[i] = (Node){ .name = strdup(name), .parent = parent, .wd = -1, .dir = dir,
+                              .sorted = true };
+    g_tree.live++;
+
+    if (i) {
+        Node *p = &g_tree.nodes[parent];
+        if (p->nkids == p->cap) {
+            p->cap = p->cap ? p->cap * 2 : 8;
+            p->kids = realloc(p->kids, p->cap * sizeof(uint32_t));
+        }
+        p->kids[p->nkids++] = i;
+        p->sorted = false;
+    }
+    return i;
+}
+
+static void watch_forget(uint32_t i) {
+    Node *n = &g_tree.nodes[i];
+    if (n->wd < 0) return;
+    inotify_rm_watch(g_tree.ifd, n->wd);
+    if ((size_t)n->wd < g_tree.wd_cap) g_tree.by_wd[n->wd] = 0;
+    n->wd = -1;
+}
+
+static void node_free_subtree(uint32_t i) {
+    Node *n = &g_tree.nodes[i];
+    for (uint32_t k = 0; k < n->nkids; k++) node_free_subtree(n->kids[k]);
+    watch_forget(i);
+    free(n->name);
+    free(n->kids);
+    memset(n, 0, sizeof(*n));
+    g_tree.live--;
+    if (g_tree.nfree == g_tree.free_cap) {
+        g_tree.free_cap = g_tree.free_cap ? g_tree.free_cap * 2 : 256;
+        g_tree.free = realloc(g_tree.free, g_tree.free_cap * sizeof(uint32_t));
+    }
+    g_tree.free[g_tree.nfree++] = i;
+}
+
+static void node_remove(uint32_t i) {
+    Node *p = &g_tree.nodes[g_tree.nodes[i].parent];
+    for (uint32_t k = 0; k < p->nkids; k++) {
+        if (p->kids[k] == i) {  /* Keep the remaining order */
+            memmove(&p->kids[k], &p->kids[k + 1], (p->nkids - k - 1) * sizeof(uint32_t));
+            p->nkids--;
+            break;
+        }
+    }
+    node_free_subtree(i);
+}
+
+static long node_child(uint32_t dir, const char *name) {
+    const Node *d = &g_tree.nodes[dir];
+    for (uint32_t k = 0; k < d->nkids; k++)
+        if (!strcmp(g_tree.nodes[d->kids[k]].name, name)) return d->kids[k];
+    return -1;
+}
+
+static int kid_cmp(const void *a, const void *b) {
+    return strcmp(g_tree.nodes[*(const uint32_t *)a].name, g_tree.nodes[*(const uint32_t *)b].name);
+}
+
+static void node_sort(uint32_t i) {
+    Node *n = &g_tree.nodes[i];
+    if (!n->sorted) {
+        qsort(n->kids, n->nkids, sizeof(uint32_t), kid_cmp);
+        n->sorted = true;
+    }
+}
+
+static void watch_add(uint32_t i, const char *path) {
+    if (g_tree.unwatched) return;
+    int wd = inotify_add_watch(g_tree.ifd, path, WATCH_MASK);
+    if (wd < 0) {
+        LOG_WARN("tree: cannot watch %s (%s); index will be refreshed every %ds instead",
+                 path, strerror(errno), TREE_TTL);
+        g_tree.unwatched = true;
+        return;
+    }
+    if ((size_t)wd >= g_tree.wd_cap) {
+        size_t cap = g_tree.wd_cap ? g_tree.wd_cap : 1024;
+        while ((size_t)wd >= cap) cap *= 2;
+        g_tree.by_wd = realloc(g_tree.by_wd, cap * sizeof(uint32_t));
+        memset(g_tree.by_wd + g_tree.wd_cap, 0, (cap - g_tree.wd_cap) * sizeof(uint32_t));
+        g_tree.wd_cap = cap;
+    }
+    g_tree.by_wd[wd] = i + 1;
+    g_tree.nodes[i].wd = wd;
+}
+
+/* Add directory `i`'s entries, recursively. The watch goes on first so
+ * nothing created during the scan is missed; duplicates are skipped. */
+static void scan_dir(uint32_t i) {
+    char rel[4096], path[5200];
+    node_path(i, rel, sizeof(rel));
+    snprintf(path, sizeof(path), "%s%s%s", g_tree.root, rel[0] ? "/" : "", rel);
+
+    watch_add(i, path);
+    IgnoreSet *parent_ign = i ? g_tree.nodes[g_tree.nodes[i].parent].ign : NULL;
+    IgnoreSet *ign = ignore_load(path, strlen(rel), parent_ign, &g_tree.ign_all);
+    g_tree.nodes[i].ign = ign ? ign : parent_ign;
+
+    int dfd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dfd < 0) return;
+    DIR *d = fdopendir(dfd);
+    if (!d) { close(dfd); return; }
+
+    struct dirent *ent;
+    while ((ent = readdir(d))) {
+        const char *name = ent->d_name;
+        if (ignore_always(name)) continue;
+        if (g_tree.live >= TREE_MAX_NODES) { g_tree.truncated = true; break; }
+
+        bool dir = ent->d_type == DT_DIR;
+        if (ent->d_type == DT_UNKNOWN) {
+            struct stat st;
+            if (fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) < 0) continue;
+            dir = S_ISDIR(st.st_mode);
+        }
+        char sub[4400];
+        snprintf(sub, sizeof(sub), "%s%s%s", rel, rel[0] ? "/" : "", name);
+        if (ignore_match(g_tree.nodes[i].ign, sub, name, dir)) continue;
+        if (node_child(i, name) >= 0) continue;
+
+        uint32_t k = node_new(name, i, dir);
+        if (dir) scan_dir(k);
+    }
+    closedir(d);
+}
+
+static void tree_free(void) {
+    if (g_tree.ifd >= 0) close(g_tree.ifd);  /* Drops every watch */
+    for (uint32_t i = 0; i < g_tree.count; i++) {
+        free(g_tree.nodes[i].name);
+        free(g_tree.nodes[i].kids);
+    }
+    free(g_tree.nodes);
+    free(g_tree.free);
+    free(g_tree.by_wd);
+    ignore_free_all(g_tree.ign_all);
+
+    pthread_mutex_t lock = g_tree.lock;
+    memset(&g_tree, 0, sizeof(g_tree));
+    g_tree.lock = lock;
+    g_tree.ifd = -1;
+}
+
+static void tree_build(const char *workspace) {
+    tree_free();
+    snprintf(g_tree.root, sizeof(g_tree.root), "%s", workspace);
+    g_tree.ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (g_tree.ifd < 0) {
+        LOG_WARN("tree: inotify unavailable (%s)", strerror(errno));
+        g_tree.unwatched = true;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    node_new("", 0, true);
+    scan_dir(0);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    g_tree.built = true;
+    g_changes++;
+    g_tree.built_at = time(NULL);
+    LOG_INFO("tree: indexed %u entries under %s in %ld ms%s", g_tree.live, workspace,
+             (t1.tv_sec - t0.tv_sec) * 1000 + (t1.tv_nsec - t0.tv_nsec) / 1000000,
+             g_tree.truncated ? " (truncated)" : "");
+}
+
+/* Apply one event. g_changes moves only for entries the index holds
+ * (or now adds): writes to ignored files don't count. */
+static void apply_event(const struct inotify_event *ev) {
+    if (ev->mask & IN_Q_OVERFLOW) { g_tree.stale = true; return; }
+    if (ev->wd < 0 || (size_t)ev->wd >= g_tree.wd_cap || !g_tree.by_wd[ev->wd]) return;
+    uint32_t dir = g_tree.by_wd[ev->wd] - 1;
+
+    if (ev->mask & IN_IGNORED) {  /* Watch gone (directory deleted) */
+        g_tree.by_wd[ev->wd] = 0;
+        if (g_tree.nodes[dir].wd == ev->wd) g_tree.nodes[dir].wd = -1;
+        return;
+    }
+    if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        if (dir == 0) g_tree.stale = true;
+        return;
+    }
+    if (!ev->len || ignore_always(ev->name)) return;
+    if (!strcmp(ev->name, ".gitignore")) { g_tree.stale = true; return; }
+
+    long existing = node_child(dir, ev->name);
+    if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        if (existing >= 0) {
+            node_remove((uint32_t)existing);
+            g_changes++;
+        }
+        return;
+    }
+    if (ev->mask & IN_CLOSE_WRITE) {  /* Content change; the tree itself is unchanged */
+        if (existing >= 0) g_changes++;
+        return;
+    }
+    if (existing >= 0) {
+        if (!(ev->mask & IN_MOVED_TO)) return;
+        node_remove((uint32_t)existing);  /* Replaced by a rename */
+        g_changes++;
+    }
+
+    bool is_dir = ev->mask & IN_ISDIR;
+    char rel[4096], sub[4400];
+    node_path(dir, rel, sizeof(rel));
+    snprintf(sub, sizeof(sub), "%s%s%s", rel, rel[0] ? "/" : "", ev->name);
+    if (ignore_match(g_tree.nodes[dir].ign, sub, ev->name, is_dir)) return;
+    if (g_tree.live >= TREE_MAX_NODES) { g_tree.truncated = true; return; }
+    uint32_t k = node_new(ev->name, dir, is_dir);
+    if (is_dir) scan_dir(k);
+    g_changes++;
+}
+
+/* Bring the index up to date for `workspace`. Caller holds the lock. */
+static void tree_sync(const char *workspace) {
+    if (!g_tree.built || strcmp(g_tree.root, workspace) ||
+        (g_tree.unwatched && time(NULL) - g_tree.built_at >= TREE_TTL)) {
+        tree_build(workspace);
+        return;
+    }
+
+    char buf[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t n = read(g_tree.ifd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        for (char *p = buf; p < buf + n;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            apply_event(ev);
+            p += sizeof(*ev) + ev->len;
+        }
+    }
+    if (g_tree.stale) {
+        LOG_INFO("tree: rebuilding index (%s)", "overflow, root moved or .gitignore changed");
+        tree_build(workspace);
+    }
+}
+
+bool tool_tree_changes(const char *workspace, uint64_t *changes) {
+    pthread_mutex_lock(&g_tree.lock);
+    tree_sync(workspace);
+    *changes = g_changes;
+    bool complete = !g_tree.unwatched && !g_tree.truncated;
+    pthread_mutex_unlock(&g_tree.lock);
+    return complete;
+}
+
+void tool_tree_cleanup(void) {
+    pthread_mutex_lock(&g_tree.lock);
+    tree_free();
+    pthread_mutex_unlock(&g_tree.lock);
+}
+
+/* ── Lookup ─────────────────────────────────────────────────── */
+
+/* Resolve a workspace path ("." / "src/lib" / absolute inside the
+ * workspace) to a node. Returns -1 with `err` set. */
+static long resolve(const char *path, char *err, size_t errlen) {
+    const char *p = ws_path_rel(g_tree.root, path, err, errlen);
+    if (!p) return -1;
+
+    uint32_t cur = 0;
+    char seg[256];
+    while (*p) {
+        while (*p == '/') p++;
+        size_t n = strcspn(p, "/");
+        if (!n) break;
+        if (n >= sizeof(seg)) n = sizeof(seg) - 1;
+        memcpy(seg, p, n);
+        seg[n] = '\0';
+        p += strcspn(p, "/");
+        if (!strcmp(seg, ".")) continue;
+        long k = g_tree.nodes[cur].dir ? node_child(cur, seg) : -1;
+        if (k < 0) {
+            snprintf(err, errlen, "Error: %s not found (or ignored by .gitignore)", path);
+            return -1;
+        }
+        cur = (uint32_t)k;
+    }
+    return cur;
+}
+
+typedef struct {
+    size_t offset, limit, total;
+    Buf    out;
+} Page;
+
+static void page_args(const cJSON *args, Page *pg) {
+    const cJSON *off = cJSON_GetObjectItem(args, "offset");
+    const cJSON *lim = cJSON_GetObjectItem(args, "limit");
+    pg->offset = cJSON_IsNumber(off) && off->valuedouble > 0 ? (size_t)off->valuedouble : 0;
+    pg->limit = cJSON_IsNumber(lim) && lim->valuedouble >= 1 ? (size_t)lim->valuedouble : PAGE_DEFAULT;
+    if (pg->limit > PAGE_MAX) pg->limit = PAGE_MAX;
+}
+
+/* One entry: "path/  [N entries]" for directories, "path  SIZE" for files. */
+static void page_add(Page *pg, uint32_t i) {
+    size_t idx = pg->total++;
+    if (idx < pg->offset || idx >= pg->offset + pg->limit) return;
+
+    const Node *n = &g_tree.nodes[i];
+    char rel[4096];
+    node_path(i, rel, sizeof(rel));
+    if (n->dir) {
+        buf_printf(&pg->out, "%s/  [%u %s]\n", rel, n->nkids, n->nkids == 1 ? "entry" : "entries");
+    } else {
+        char path[5200];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", g_tree.root, rel);
+        if (lstat(path, &st) == 0) buf_printf(&pg->out, "%s  %lld\n", rel, (long long)st.st_size);
+        else buf_printf(&pg->out, "%s\n", rel);
+    }
+}
+
+static void page_footer(Page *pg) {
+    if (pg->offset + pg->limit < pg->total)
+        buf_printf(&pg->out, "[more: pass offset=%zu]\n", pg->offset + pg->limit);
+    if (g_tree.truncated)
+        buf_printf(&pg->out, "[index stopped at %d entries; results may be incomplete]\n", TREE_MAX_NODES);
+}
+
+/* Header goes first but needs the total, so the page is built separately. */
+static char *page_finish(Page *pg, const char *head) {
+    Buf res = {0};
+    size_t first = pg->total ? pg->offset + 1 : 0;
+    size_t last = pg->offset + pg->limit < pg->total ? pg->offset + pg->limit : pg->total;
+    if (first > pg->total) first = last = 0;
+    buf_printf(&res, "[%s: %zu %s", head, pg->total, pg->total == 1 ? "entry" : "entries");
+    if (pg->total) buf_printf(&res, "; showing %zu-%zu", first, last);
+    buf_printf(&res, "]\n%s", pg->out.data ? pg->out.data : "");
+    free(pg->out.data);
+    return res.data;
+}
+
+/* ── list ───────────────────────────────────────────────────── */
+
+static void list_walk(Page *pg, uint32_t dir, int depth) {
+    node_sort(dir);
+    const Node *d = &g_tree.nodes[dir];
+    for (uint32_t k = 0; k < d->nkids; k++) {
+        uint32_t i = d->kids[k];
+        page_add(pg, i);
+        if (g_tree.nodes[i].dir && depth > 1) list_walk(pg, i, depth - 1);
+    }
+}
+
+ToolExecResult tool_list_exec(const char *input_json, const char *workspace) {
+    ToolExecResult r = {0, NULL};
+
+    cJSON *args = cJSON_Parse(input_json);
+    if (!args) { r.output = strdup("Error: invalid JSON"); return r; }
+    cJSON *path = cJSON_GetObjectItem(args, "path");
+    cJSON *depth = cJSON_GetObjectItem(args, "depth");
+    const char *p = cJSON_IsString(path) && path->valuestring[0] ? path->valuestring : ".";
+    int d = cJSON_IsNumber(depth) ? (int)depth->valuedouble : 1;
+    if (d < 1) d = 1;
+    if (d > LIST_MAX_DEPTH) d = LIST_MAX_DEPTH;
+
+    Page pg = {0};
+    page_args(args, &pg);
+
+    pthread_mutex_lock(&g_tree.lock);
+    tree_sync(workspace);
+    char err[1200];
+    long node = resolve(p, err, sizeof(err));
+    if (node < 0) {
+        r.output = strdup(err);
+    } else {
+        if (g_tree.nodes[node].dir) list_walk(&pg, (uint32_t)node, d);
+        else page_add(&pg, (uint32_t)node);
+        page_footer(&pg);
+        r.output = page_finish(&pg, p);
+        r.success = 1;
+    }
+    pthread_mutex_unlock(&g_tree.lock);
+
+    cJSON_Delete(args);
+    return r;
+}
+
+/* ── glob ───────────────────────────────────────────────────── */
+
+/* Match a relative path against a glob where "**" spans any number of
+ * directories and other wildcards stay within one path component. */
+static bool glob_match(const char *pat, const char *path) {
+    if (!strncmp(pat, "**", 2) && (pat[2] == '/' || !pat[2])) {
+        const char *rest = pat[2] ? pat + 3 : pat + 2;
+        if (!*rest) return true;
+        for (const char *s = path;;) {
+            if (glob_match(rest, s)) return true;
+            if (*s == '.') return false;  /* Like '*', '**' skips dot-directories */
+            s = strchr(s, '/');
+            if (!s) return false;
+            s++;
+        }
+    }
+
+    char pseg[256], sseg[256];
+    size_t pn = strcspn(pat, "/"), sn = strcspn(path, "/");
+    if (pn >= sizeof(pseg) || sn >= sizeof(sseg)) return false;
+    memcpy(pseg, pat, pn);
+    pseg[pn] = '\0';
+    memcpy(sseg, path, sn);
+    sseg[sn] = '\0';
+    if (fnmatch(pseg, sseg, FNM_PERIOD) != 0) return false;
+
+    if (!pat[pn]) return !path[sn];
+    if (!path[sn]) return false;
+    return glob_match(pat + pn + 1, path + sn + 1);
+}
+
+/* Path components a match can have, or -1 if unbounded ("**"). */
+static int glob_depth(const char *pat) {
+    if (strstr(pat, "**")) return -1;
+    int n = 1;
+    for (; *pat; pat++) n += *pat == '/';
+    return n;
+}
+
+/* `sub` holds the path below the base directory, extended in place. */
+static void glob_walk(Page *pg, uint32_t dir, char *sub, size_t len, const char *pat,
+                      int max_depth, int depth) {
+    node_sort(dir);
+    const Node *d = &g_tree.nodes[dir];
+    for (uint32_t k = 0; k < d->nkids; k++) {
+        uint32_t i = d->kids[k];
+        const char *name = g_tree.nodes[i].name;
+        size_t nlen = strlen(name);
+        if (len + nlen + 2 > 4096) continue;
+        if (len) sub[len] = '/';
+        memcpy(sub + len + (len ? 1 : 0), name, nlen + 1);
+
+        if (glob_match(pat, sub)) page_add(pg, i);
+        if (g_tree.nodes[i].dir && (max_depth < 0 || depth < max_depth))
+            glob_walk(pg, i, sub, len + (len ? 1 : 0) + nlen, pat, max_depth, depth + 1);
+    }
+    sub[len] = '\0';
+}
+
+ToolExecResult tool_glob_exec(const char *input_json, const char *workspace) {
+    ToolExecResult r = {0, NULL};
+
+    cJSON *args = cJSON_Parse(input_json);
+    if (!args) { r.output = strdup("Error: invalid JSON"); return r; }
+    cJSON *pattern = cJSON_GetObjectItem(args, "pattern");
+    if (!cJSON_IsString(pattern) || !pattern->valuestring[0]) {
+        r.output = strdup("Error: missing 'pattern'");
+        cJSON_Delete(args);
+        return r;
+    }
+    cJSON *path = cJSON_GetObjectItem(args, "path");
+    const char *p = cJSON_IsString(path) && path->valuestring[0] ? path->valuestring : ".";
+    const char *pat = pattern->valuestring;
+    while (!strncmp(pat, "./", 2)) pat += 2;
+
+    Page pg = {0};
+    page_args(args, &pg);
+
+    pthread_mutex_lock(&g_tree.lock);
+    tree_sync(workspace);
+    char err[1200];
+    long node = resolve(p, err, sizeof(err));
+    if (node < 0) {
+        r.output = strdup(err);
+    } else if (!g_tree.nodes[node].dir) {
+        snprintf(err, sizeof(err), "Error: %s is not a directory", p);
+        r.output = strdup(err);
+    } else {
+        char sub[4096] = "";
+        glob_walk(&pg, (uint32_t)node, sub, 0, pat, glob_depth(pat), 1);
+        page_footer(&pg);
+        char head[600];
+        snprintf(head, sizeof(head), "glob %s in %s", pattern->valuestring, p);
+        r.output = page_finish(&pg, head);
+        r.success = 1;
+    }
+    pthread_mutex_unlock(&g_tree.lock);
+
+    cJSON_Delete(args);
+    return r;
+}
+
+void tool_tree_register(void) {
+    static const ToolDef list_def = {
+        .name = "list",
+        .description = "List a workspace directory from a cached, always-current index. "
+                       "Directories end in '/' with their entry count; files show their size. "
+                       "Honours .gitignore. Paginate with offset/limit.",
+        .input_schema =
+            "{"
+                "\"type\":\"object\","
+                "\"properties\":{"
+                    "\"path\":{\"type\":\"string\",\"description\":\"Directory (default: workspace root)\"},"
+                    "\"depth\":{\"type\":\"integer\",\"description\":\"Levels to descend (default 1, max 20)\"},"
+                    "\"offset\":{\"type\":\"integer\",\"description\":\"Entries to skip\"},"
+                    "\"limit\":{\"type\":\"integer\",\"description\":\"Entries to return (default 200, max 1000)\"}"
+                "}"
+            "}",
+        .fn = tool_list_exec,
+        .flags = TOOL_READ_ONLY | TOOL_CONCURRENT | TOOL_IDEMPOTENT,
+    };
+    static const ToolDef glob_def = {
+        .name = "glob",
+        .description = "Find workspace paths matching a glob such as src/**/*.c ('**' spans "
+                       "directories). Served from the same index as list; paginate with "
+                       "offset/limit.",
+        .input_schema =
+            "{"
+                "\"type\":\"object\","
+                "\"properties\":{"
+                    "\"pattern\":{\"type\":\"string\",\"description\":\"Glob relative to path\"},"
+                    "\"path\":{\"type\":\"string\",\"description\":\"Base directory (default: workspace root)\"},"
+                    "\"offset\":{\"type\":\"integer\"},"
+                    "\"limit\":{\"type\":\"integer\"}"
+                "},"
+                "\"required\":[\"pattern\"]"
+            "}",
+        .fn = tool_glob_exec,
+        .flags = TOOL_READ_ONLY | TOOL_CONCURRENT | TOOL_IDEMPOTENT,
+    };
+    tools_register(&list_def);
+    tools_register(&glob_def);
+}
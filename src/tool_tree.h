@@ -0,0 +1,22 @@
+#ifndef CCLAW_TOOL_TREE_H
+#define CCLAW_TOOL_TREE_H
+
+#include "tools.h"
+#include <stdint.h>
+
+ToolExecResult tool_list_exec(const char *input_json, const char *workspace);
+ToolExecResult tool_glob_exec(const char *input_json, const char *workspace);
+
+/* Register the list and glob tools. */
+void tool_tree_register(void);
+
+/* A counter that moves whenever a file or directory in the workspace
+ * (outside .gitignore) is created, written, renamed or removed, as seen
+ * by the index's inotify watches. Returns false if the index can't see
+ * every change (watch limit reached or index truncated). */
+bool tool_tree_changes(const char *workspace, uint64_t *changes);
+
+/* Drop the workspace index and its inotify watches. */
+void tool_tree_cleanup(void);
+
+#endif
@@ -1,19 +1,471 @@
+/*
+ * Tool registry.
+ *
+ * Tools live in an array in registration order (so the definitions sent to
+ * the model are stable and prompt-cache friendly) with an open-addressing
+ * FNV-1a index from name to array slot for dispatch. The registry is built
+ * at startup — built-ins first, then plugins — and is read-only afterwards,
+ * so lookups from agent and cron threads take no lock.
+ *
+ * Calls run under g_exclusive: TOOL_CONCURRENT tools hold it shared, any
+ * other tool exclusively, so a plugin without the flag never runs next to
+ * another tool call. The timeout is a deadline the handler sees through
+ * tool_remaining_ms() and tool_emit(); a handler can't be stopped safely
+ * from outside, so it has to notice and return.
+ */
+
 #include "tools.h"
 #include "tool_shell.h"
 #include "tool_file.h"
+#include "tool_search.h"
+#include "tool_tree.h"
+#include "tool_context.h"
+#include "workspace.h"
+#include "util.h"
 #include "log.h"
+#include <dirent.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
-ToolExecResult tool_execute(const char *name, const char *input_json, const char *workspace) {
+#define MEM_TAG MEM_TOOLS
+#include "mem.h"
+
+#define MAX_PLUGINS 64
+
+typedef int (*ToolPluginInit)(bool (*reg)(const ToolDef *def));
+
+static ToolDef  *g_tools;
+static size_t    g_count, g_cap;
+static uint32_t *g_index;       /* slot+1, 0 = empty */
+static size_t    g_index_cap;   /* power of two */
+static char     *g_defs;        /* cached tools_get_definitions() JSON */
+static void     *g_plugins[MAX_PLUGINS];
+static int       g_num_plugins;
+static pthread_rwlock_t g_exclusive;
+
+/* ── Name index ─────────────────────────────────────────────── */
+
+static long index_find(const char *name) {
+    if (!g_index_cap) return -1;
+    size_t mask = g_index_cap - 1;
+    for (size_t i = fnv1a(name) & mask;; i = (i + 1) & mask) {
+        uint32_t e = g_index[i];
+        if (!e) return -1;
+        if (!strcmp(g_tools[e - 1].name, name)) return (long)(e - 1);
+    }
+}
+
+static void index_put(size_t slot) {
+    size_t mask = g_index_cap - 1;
+    size_t i = fnv1a(g_tools[slot].name) & mask;
+    while (g_index[i]) i = (i + 1) & mask;
+    g_index[i] = (uint32_t)slot + 1;
+}
+
+/* Keep the index at most half full. */
+static bool index_reserve(size_t count) {
+    if (count * 2 <= g_index_cap) return true;
+    size_t cap = g_index_cap ? g_index_cap : 16;
+    while (count * 2 > cap) cap *= 2;
+
+    uint32_t *idx = calloc(cap, sizeof(*idx));
+    if (!idx) return false;
+    free(g_index);
+    g_index = idx;
+    g_index_cap = cap;
+    for (size_t i = 0; i < g_count; i++) index_put(i);
+    return true;
+}
+
+/* ── Registry ───────────────────────────────────────────────── */
+
+static void tooldef_free(ToolDef *t) {
+    free((char *)t->name);
+    free((char *)t->description);
+    free((char *)t->input_schema);
+}
+
+bool tools_register(const ToolDef *def) {
+    if (!def || !def->name || !def->name[0] || !def->fn || !def->input_schema) {
+        LOG_ERROR("tools_register: incomplete tool definition");
+        return false;
+    }
+
+    /* Validate the schema now rather than shipping broken JSON to the API. */
+    cJSON *schema = cJSON_Parse(def->input_schema);
+    if (!cJSON_IsObject(schema)) {
+        LOG_ERROR("tools_register: %s: input_schema is not a JSON object", def->name);
+        cJSON_Delete(schema);
+        return false;
+    }
+    char *compact = cJSON_PrintUnformatted(schema);
+    cJSON_Delete(schema);
+
+    ToolDef t = *def;
+    t.name = strdup(def->name);
+    t.description = strdup(def->description ? def->description : "");
+    t.input_schema = compact;
+
+    long slot = index_find(def->name);
+    if (slot >= 0) {
+        LOG_INFO("Tool %s replaced", def->name);
+        tooldef_free(&g_tools[slot]);
+        g_tools[slot] = t;
+    } else {
+        if (g_count == g_cap) {
+            size_t cap = g_cap ? g_cap * 2 : 16;
+            ToolDef *tools = realloc(g_tools, cap * sizeof(*tools));
+            if (!tools) { tooldef_free(&t); return false; }
+            g_tools = tools;
+            g_cap = cap;
+        }
+        g_tools[g_count++] = t;
+        if (!index_reserve(g_count)) {
+            tooldef_free(&g_tools[--g_count]);
+            return false;
+        }
+        index_put(g_count - 1);
+    }
+
+    free(g_defs);
+    g_defs = NULL;
+    LOG_DEBUG("Tool registered: %s (flags=0x%x, timeout=%d)", t.name, t.flags, t.timeout);
+    return true;
+}
+
+void tools_init(void) {
+    /* Prefer writers, or a steady stream of concurrent calls from cron
+     * workers could hold an exclusive tool off indefinitely */
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&g_exclusive, &attr);
+    pthread_rwlockattr_destroy(&attr);
+
+    tool_shell_register();
+    tool_file_register();
+    tool_search_register();
+    tool_tree_register();
+    tool_context_register();
+}
+
+static void cache_clear(void);
+
+void tools_cleanup(void) {
+    tool_shell_cleanup();
+    tool_file_cleanup();
+    tool_tree_cleanup();
+    cache_clear();
+    for (size_t i = 0; i < g_count; i++) tooldef_free(&g_tools[i]);
+    free(g_tools);
+    free(g_index);
+    free(g_defs);
+    g_tools = NULL;
+    g_index = NULL;
+    g_defs = NULL;
+    g_count = g_cap = g_index_cap = 0;
+
+    /* Handlers point into the plugins, so unload them last. */
+    for (int i = 0; i < g_num_plugins; i++) dlclose(g_plugins[i]);
+    g_num_plugins = 0;
+    pthread_rwlock_destroy(&g_exclusive);
+}
+
+int tools_load_plugins(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        LOG_WARN("Cannot open tool plugin dir %s", dir);
+        return -1;
+    }
+
+    int loaded = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d))) {
+        size_t len = strlen(ent->d_name);
+        if (len < 4 || strcmp(ent->d_name + len - 3, ".so")) continue;
+        if (g_num_plugins >= MAX_PLUGINS) {
+            LOG_WARN("Tool plugin limit (%d) reached, skipping %s", MAX_PLUGINS, ent->d_name);
+            continue;
+        }
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+
+        void *h = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+        if (!h) {
+            LOG_ERROR("Tool plugin %s: %s", path, dlerror());
+            continue;
+        }
+
+        ToolPluginInit init;
+        *(void **)&init = dlsym(h, "cclaw_tool_init");
+        if (!init) {
+            LOG_ERROR("Tool plugin %s: no cclaw_tool_init symbol", path);
+            dlclose(h);
+            continue;
+        }
+
+        size_t before = g_count;
+        if (init(tools_register) != 0) {
+            LOG_ERROR("Tool plugin %s: init failed", path);
+            /* Tools it already registered still reference the library. */
+            if (g_count == before) { dlclose(h); continue; }
+        }
+
+        g_plugins[g_num_plugins++] = h;
+        loaded++;
+        LOG_INFO("Tool plugin loaded: %s", ent->d_name);
+    }
+
+    closedir(d);
+    return loaded;
+}
+
+const ToolDef *tools_lookup(const char *name) {
+    long slot = index_find(name);
+    return slot >= 0 ? &g_tools[slot] : NULL;
+}
+
+const ToolDef *tools_at(size_t i) {
+    return i < g_count ? &g_tools[i] : NULL;
+}
+
+static const ToolCtx empty_ctx;
+static _Thread_local const ToolCtx *t_ctx;
+static _Thread_local const char    *t_tool;
+static _Thread_local long long      t_deadline;  /* CLOCK_MONOTONIC ms, 0 = none */
+
+const ToolCtx *tool_ctx(void) {
+    return t_ctx ? t_ctx : &empty_ctx;
+}
+
+long tool_remaining_ms(void) {
+    if (!t_deadline) return -1;
+    long long left = t_deadline - now_ms();
+    return left > 0 ? (long)left : 0;
+}
+
+bool tool_emit(ToolStream stream, const char *data, size_t len) {
+    if (t_deadline && tool_remaining_ms() == 0) return false;
+    if (!t_ctx || !t_ctx->on_chunk || !len) return true;
+    return t_ctx->on_chunk(t_tool, stream, data, len, t_ctx->userdata);
+}
+
+/* ── Result cache ───────────────────────────────────────────── */
+
+/* Successful results of TOOL_IDEMPOTENT calls, keyed by tool, workspace
+ * and the input with object keys sorted, so {"a":1,"b":2} and
+ * {"b":2,"a":1} share an entry. Each entry records two counters from
+ * before the call ran: mutating tool calls (anything not TOOL_READ_ONLY,
+ * counted as they start and finish) and the tree index's inotify change
+ * counter. A hit needs both unchanged, so a file_write, a shell command
+ * or an editor saving a file invalidates everything. */
+#define RESULT_CACHE       64
+#define RESULT_CACHE_BYTES (4 * 1024 * 1024)
+
+typedef struct {
+    char          *key;      /* NULL = empty slot */
+    uint32_t       hash;
+    uint64_t       writes, changes;
+    ToolExecResult r;
+    size_t         size;
+    unsigned long  used;     /* LRU clock */
+} CachedResult;
+
+static CachedResult    g_results[RESULT_CACHE];
+static size_t          g_results_bytes;
+static unsigned long   g_results_clock;
+static uint64_t        g_writes;
+static ToolCacheStats  g_cache_stats;
+static bool            g_cache_on = true;
+static pthread_mutex_t g_results_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void tools_set_result_cache(bool on) {
+    g_cache_on = on;
+}
+
+void tools_cache_stats(ToolCacheStats *out) {
+    pthread_mutex_lock(&g_results_lock);
+    *out = g_cache_stats;
+    pthread_mutex_unlock(&g_results_lock);
+}
+
+static int member_cmp(const void *a, const void *b) {
+    return strcmp((*(cJSON *const *)a)->string, (*(cJSON *const *)b)->string);
+}
+
+/* Sort object members by key, recursively. */
+static void json_canonicalize(cJSON *item) {
+    if (cJSON_IsObject(item) && item->child) {
+        size_t n = 0;
+        for (cJSON *c = item->child; c; c = c->next) n++;
+        cJSON **v = malloc(n * sizeof(*v));
+        n = 0;
+        for (cJSON *c = item->child; c; c = c->next) v[n++] = c;
+        qsort(v, n, sizeof(*v), member_cmp);
+        for (size_t i = 0; i < n; i++) {
+            v[i]->prev = i ? v[i - 1] : v[n - 1];  /* cJSON keeps the tail in child->prev */
+            v[i]->next = i + 1 < n ? v[i + 1] : NULL;
+        }
+        item->child = v[0];
+        free(v);
+    }
+    for (cJSON *c = item->child; c; c = c->next) json_canonicalize(c);
+}
+
+/* A "path" argument that leaves the workspace reads files the tree index
+ * doesn't watch, so such calls aren't cached. */
+static bool path_in_workspace(const cJSON *args, const char *workspace) {
+    const cJSON *path = cJSON_GetObjectItem(args, "path");
+    return !cJSON_IsString(path) || ws_path_rel(workspace, path->valuestring, NULL, 0);
+}
+
+/* Cache key for a call, with the counters it must match. NULL if the
+ * call can't be cached. The arguments are parsed in `a`, if given. */
+static char *cache_key(const ToolDef *t, const char *input_json, const char *workspace,
+                       Arena *a, uint64_t *writes, uint64_t *changes) {
+    Arena *prev = arena_json_use(a);
+    cJSON *args = cJSON_Parse(input_json);
+    if (!args) {
+        arena_json_use(prev);
+        return NULL;
+    }
+    char *key = NULL;
+    if (path_in_workspace(args, workspace) && tool_tree_changes(workspace, changes)) {
+        json_canonicalize(args);
+        char *canon = cJSON_PrintUnformatted(args);
+        size_t len = strlen(t->name) + strlen(workspace) + strlen(canon) + 3;
+        key = malloc(len);
+        snprintf(key, len, "%s\n%s\n%s", t->name, workspace, canon);
+        cJSON_free(canon);
+    }
+    cJSON_Delete(args);
+    arena_json_use(prev);
+
+    pthread_mutex_lock(&g_results_lock);
+    if (key) *writes = g_writes;
+    else g_cache_stats.bypassed++;
+    pthread_mutex_unlock(&g_results_lock);
+    return key;
+}
+
+static void result_free(CachedResult *e) {
+    g_results_bytes -= e->size;
+    free(e->key);
+    free(e->r.output);
+    memset(e, 0, sizeof(*e));
+}
+
+static bool cache_get(const char *key, uint64_t writes, uint64_t changes, ToolExecResult *r) {
+    uint32_t hash = fnv1a(key);
+    bool hit = false;
+    pthread_mutex_lock(&g_results_lock);
+    for (int i = 0; i < RESULT_CACHE; i++) {
+        CachedResult *e = &g_results[i];
+        if (!e->key || e->hash != hash || strcmp(e->key, key)) continue;
+        if (e->writes == writes && e->changes == changes) {
+            e->used = ++g_results_clock;
+            r->success = e->r.success;
+            r->output = strdup(e->r.output);
+            hit = true;
+        } else {
+            g_cache_stats.stale++;
+            result_free(e);
+        }
+        break;
+    }
+    if (hit) g_cache_stats.hits++;
+    else g_cache_stats.misses++;
+    pthread_mutex_unlock(&g_results_lock);
+    return hit;
+}
+
+/* Store a result; takes ownership of `key`. */
+static void cache_put(char *key, uint64_t writes, uint64_t changes, const ToolExecResult *r) {
+    size_t size = strlen(key) + strlen(r->output);
+    if (size > RESULT_CACHE_BYTES / 8) { free(key); return; }
+    uint32_t hash = fnv1a(key);
+
+    pthread_mutex_lock(&g_results_lock);
+    for (int i = 0; i < RESULT_CACHE; i++) {  /* A concurrent call stored it first */
+        CachedResult *e = &g_results[i];
+        if (e->key && e->hash == hash && !strcmp(e->key, key)) result_free(e);
+    }
+    int slot;
+    for (;;) {
+        slot = -1;
+        int oldest = -1;
+        for (int i = 0; i < RESULT_CACHE; i++) {
+            if (!g_results[i].key) { if (slot < 0) slot = i; continue; }
+            if (oldest < 0 || g_results[i].used < g_results[oldest].used) oldest = i;
+        }
+        if (slot >= 0 && g_results_bytes + size <= RESULT_CACHE_BYTES) break;
+        result_free(&g_results[oldest]);
+    }
+    g_results[slot] = (CachedResult){
+        .key = key, .hash = hash, .writes = writes, .changes = changes,
+        .r = { r->success, strdup(r->output) }, .size = size, .used = ++g_results_clock,
+    };
+    g_results_bytes += size;
+    pthread_mutex_unlock(&g_results_lock);
+}
+
+static void cache_clear(void) {
+    pthread_mutex_lock(&g_results_lock);
+    if (g_cache_stats.hits + g_cache_stats.misses)
+        LOG_INFO("Tool result cache: %lu hits, %lu misses (%lu stale), %lu uncacheable",
+                 g_cache_stats.hits, g_cache_stats.misses, g_cache_stats.stale, g_cache_stats.bypassed);
+    for (int i = 0; i < RESULT_CACHE; i++) if (g_results[i].key) result_free(&g_results[i]);
+    memset(&g_cache_stats, 0, sizeof(g_cache_stats));
+    pthread_mutex_unlock(&g_results_lock);
+}
+
+static void writes_bump(void) {
+    pthread_mutex_lock(&g_results_lock);
+    g_writes++;
+    pthread_mutex_unlock(&g_results_lock);
+}
+
+ToolExecResult tool_execute(const char *name, const char *input_json, const char *workspace,
+                            const ToolCtx *ctx) {
     ToolExecResult r = {0, NULL};
 
-    if (!strcmp(name, "shell")) {
-        r = tool_shell_exec(input_json, workspace);
-    } else if (!strcmp(name, "file_read")) {
-        r = tool_file_read(input_json, workspace);
-    } else if (!strcmp(name, "file_write")) {
-        r = tool_file_write(input_json, workspace);
+    const ToolDef *t = tools_lookup(name);
+    if (t) {
+        uint64_t writes = 0, changes = 0;
+        char *key = g_cache_on && (t->flags & TOOL_IDEMPOTENT)
+            ? cache_key(t, input_json, workspace, ctx ? ctx->arena : NULL, &writes, &changes)
+            : NULL;
+        if (key && cache_get(key, writes, changes, &r)) {
+            LOG_DEBUG("Tool %s: cached result", t->name);
+            free(key);
+            if (ctx && ctx->on_chunk) ctx->on_chunk(t->name, TOOL_DONE, NULL, 0, ctx->userdata);
+            return r;
+        }
+
+        bool mutating = !(t->flags & TOOL_READ_ONLY);
+        if (t->flags & TOOL_CONCURRENT) pthread_rwlock_rdlock(&g_exclusive);
+        else pthread_rwlock_wrlock(&g_exclusive);
+        if (mutating) writes_bump();
+        t_ctx = ctx;
+        t_tool = t->name;
+        t_deadline = t->timeout > 0 ? now_ms() + (long long)t->timeout * 1000 : 0;
+        r = t->fn(input_json, workspace);
+        if (t_deadline && tool_remaining_ms() == 0)
+            LOG_WARN("Tool %s: reached its %ds timeout", t->name, t->timeout);
+        t_ctx = NULL;
+        t_tool = NULL;
+        t_deadline = 0;
+        if (mutating) writes_bump();  /* Again: a cached call may have overlapped this one */
+        pthread_rwlock_unlock(&g_exclusive);
+        if (ctx && ctx->on_chunk) ctx->on_chunk(t->name, TOOL_DONE, NULL, 0, ctx->userdata);
+
+        if (key && r.success && r.output) cache_put(key, writes, changes, &r);
+        else free(key);
     } else {
         LOG_WARN("Unknown tool: %s", name);
         r.success = 0;
@@ -26,42 +478,17 @@ ToolExecResult tool_execute(const char *name, const char *input_json, const char
 }
 
 char *tools_get_definitions(void) {
-    return strdup(
-        "["
-        "{"
-            "\"name\":\"shell\","
-            "\"description\":\"Execute a shell command and return stdout/stderr.\","
-            "\"input_schema\":{"
-                "\"type\":\"object\","
-                "\"properties\":{"
-                    "\"command\":{\"type\":\"string\",\"description\":\"Shell command to execute\"}"
-                "},"
-                "\"required\":[\"command\"]"
-            "}"
-        "},"
-        "{"
-            "\"name\":\"file_read\","
-            "\"description\":\"Read the contents of a file.\","
-            "\"input_schema\":{"
-                "\"type\":\"object\","
-                "\"properties\":{"
-                    "\"path\":{\"type\":\"string\",\"description\":\"File path (relative to workspace)\"}"
-                "},"
-                "\"required\":[\"path\"]"
-            "}"
-        "},"
-        "{"
-            "\"name\":\"file_write\","
-            "\"description\":\"Write content to a file. Creates parent directories.\","
-            "\"input_schema\":{"
-                "\"type\":\"object\","
-                "\"properties\":{"
-                    "\"path\":{\"type\":\"string\",\"description\":\"File path\"},"
-                    "\"content\":{\"type\":\"string\",\"description\":\"Content to write\"}"
-                "},"
-                "\"required\":[\"path\",\"content\"]"
-            "}"
-        "}"
-        "]"
-    );
+    if (!g_defs) {
+        cJSON *arr = cJSON_CreateArray();
+        for (size_t i = 0; i < g_count; i++) {
+            cJSON *tool = cJSON_CreateObject();
+            cJSON_AddStringToObject(tool, "name", g_tools[i].name);
+            cJSON_AddStringToObject(tool, "description", g_tools[i].description);
+            cJSON_AddItemToObject(tool, "input_schema", cJSON_Parse(g_tools[i].input_schema));
+            cJSON_AddItemToArray(arr, tool);
+        }
+        g_defs = cJSON_PrintUnformatted(arr);
+        cJSON_Delete(arr);
+    }
+    return g_defs ? strdup(g_defs) : NULL;
 }
@@ -1,7 +1,10 @@
 #ifndef CCLAW_TOOLS_H
 #define CCLAW_TOOLS_H
 
+#include "arena.h"
 #include <cJSON.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 /* Tool result */
 typedef struct {
@@ -9,10 +12,96 @@ typedef struct {
     char *output;
 } ToolExecResult;
 
-/* Execute a tool by name. Caller frees result.output. */
-ToolExecResult tool_execute(const char *name, const char *input_json, const char *workspace);
+/* Live output streams. TOOL_DONE (no data) follows a tool's last chunk. */
+typedef enum { TOOL_STDOUT, TOOL_STDERR, TOOL_DONE } ToolStream;
 
-/* Get tool definitions as JSON array string (for Anthropic API). */
+/* Receives tool output while the tool runs. Return false to cancel it. */
+typedef bool (*ToolChunkFn)(const char *tool, ToolStream stream,
+                            const char *data, size_t len, void *userdata);
+
+/* Per-call context, available to handlers through tool_ctx(). */
+typedef struct {
+    const char  *session;   /* Id of the calling session ("" if unsaved), or NULL */
+    ToolChunkFn  on_chunk;  /* Live output sink, or NULL */
+    void        *userdata;  /* Passed to on_chunk */
+    Arena       *arena;     /* Scratch released after the turn, or NULL */
+} ToolCtx;
+
+/* Tool handler. `input_json` is the raw tool_use input object. */
+typedef ToolExecResult (*ToolFn)(const char *input_json, const char *workspace);
+
+/* Tool flags */
+#define TOOL_READ_ONLY   0x1   /* No side effects on the workspace */
+#define TOOL_CONCURRENT  0x2   /* Safe to run alongside other tool calls; without it
+                                  tool_execute() runs the tool alone */
+#define TOOL_IDEMPOTENT  0x4   /* Result depends only on the input and the workspace's
+                                  non-ignored files; may be served from the result cache */
+
+/* Tool descriptor. Strings are copied on registration. */
+typedef struct {
+    const char *name;
+    const char *description;
+    const char *input_schema;  /* JSON schema object (Anthropic input_schema) */
+    ToolFn      fn;
+    int         flags;         /* TOOL_* */
+    int         timeout;       /* Seconds; 0 = none. See tool_remaining_ms() */
+} ToolDef;
+
+/* Register the built-in tools. Call once at startup, before any threads. */
+void tools_init(void);
+
+/* Release the registry and unload plugins. */
+void tools_cleanup(void);
+
+/* Add a tool to the registry. A tool with the same name is replaced.
+ * Returns false if the descriptor is incomplete or the schema is not JSON. */
+bool tools_register(const ToolDef *def);
+
+/* Load plugin tools from every *.so in `dir`. Each plugin exports
+ *   int cclaw_tool_init(bool (*reg)(const ToolDef *def));
+ * and registers its tools through `reg`, returning 0 on success.
+ * Returns the number of plugins loaded, or -1 if `dir` can't be read. */
+int tools_load_plugins(const char *dir);
+
+/* Look up a tool by name. NULL if unknown. */
+const ToolDef *tools_lookup(const char *name);
+
+/* The i-th registered tool in registration order, or NULL past the end. */
+const ToolDef *tools_at(size_t i);
+
+/* Execute a tool by name. `ctx` may be NULL. Caller frees result.output. */
+ToolExecResult tool_execute(const char *name, const char *input_json, const char *workspace,
+                            const ToolCtx *ctx);
+
+/* Context of the tool call running on this thread. Never NULL. */
+const ToolCtx *tool_ctx(void);
+
+/* Forward a chunk of output from the running tool to ctx->on_chunk, if any.
+ * Returns false if the consumer asked to cancel the tool or its timeout
+ * has passed. */
+bool tool_emit(ToolStream stream, const char *data, size_t len);
+
+/* Milliseconds left before the running tool's timeout: 0 once it has
+ * passed, -1 if the tool has none. Long-running handlers poll this (or
+ * tool_emit()) and stop when it reaches 0. */
+long tool_remaining_ms(void);
+
+/* Result cache for TOOL_IDEMPOTENT tools. */
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long stale;     /* Entries found invalidated by a change */
+    unsigned long bypassed;  /* Calls that couldn't be cached (paths outside the workspace, ...) */
+} ToolCacheStats;
+
+/* Enable or disable the result cache (on by default). Call before tools run. */
+void tools_set_result_cache(bool on);
+
+void tools_cache_stats(ToolCacheStats *out);
+
+/* Get tool definitions as JSON array string (for Anthropic API).
+ * Built from the registry and cached until the next registration.
+ * Caller frees. */
 char *tools_get_definitions(void);
 
 #endif
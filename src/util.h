@@ -0,0 +1,23 @@
+#ifndef CCLAW_UTIL_H
+#define CCLAW_UTIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* FNV-1a hash of a string, for the open-addressing name indexes. */
+uint32_t fnv1a(const char *s);
+
+/* CLOCK_MONOTONIC time in milliseconds, for deadlines. */
+long long now_ms(void);
+
+/* Growable output buffer, always NUL-terminated once written to.
+ * Zero-initialise; `data` is malloc'd and owned by the caller. */
+typedef struct {
+    char  *data;
+    size_t len, cap;
+} Buf;
+
+void buf_add(Buf *b, const char *data, size_t n);
+void buf_printf(Buf *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#endif
@@ -1,133 +1,422 @@
 #include "workspace.h"
+#include "file_cache.h"
 #include "log.h"
+#include "rope.h"
+#include "tool_context.h"
+#include "tools.h"
+#include <cJSON.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
 #include <sys/utsname.h>
 #include <unistd.h>
 #include <time.h>
 
+#define MEM_TAG MEM_OTHER
+#include "mem.h"
+
 #define MAX_FILE_SIZE (64 * 1024)  /* 64KB max per workspace file */
+#define DIR_MASK (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                  IN_DELETE_SELF | IN_MOVE_SELF)
+#define SKILLS_MASK (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+
+/* Identity files, in prompt order. MEMORY.md changes most, so it's last. */
+static const char *g_files[] = {
+    "AGENTS.md", "SOUL.md", "TOOLS.md", "IDENTITY.md",
+    "USER.md", "HEARTBEAT.md", "MEMORY.md",
+};
+#define NFILES (sizeof(g_files) / sizeof(g_files[0]))
+
+const char *ws_path_rel(const char *workspace, const char *path, char *err, size_t errlen) {
+    const char *p = path;
+    if (p[0] == '/') {
+        size_t wlen = strlen(workspace);
+        while (wlen > 1 && workspace[wlen - 1] == '/') wlen--;
+        if (strncmp(p, workspace, wlen) || (wlen > 1 && p[wlen] && p[wlen] != '/')) {
+            if (err) snprintf(err, errlen, "Error: %s is outside the workspace", path);
+            return NULL;
+        }
+        p += wlen;
+    }
+    for (const char *s = p; (s = strstr(s, "..")); s += 2) {
+        if ((s == p || s[-1] == '/') && (!s[2] || s[2] == '/')) {
+            if (err) snprintf(err, errlen, "Error: '..' is not allowed in paths");
+            return NULL;
+        }
+    }
+    while (*p == '/' || (p[0] == '.' && (p[1] == '/' || !p[1]))) p++;
+    return p;
+}
 
 char *ws_read_file(Arena *a, const char *workspace, const char *filename) {
     char path[1024];
     snprintf(path, sizeof(path), "%s/%s", workspace, filename);
 
-    FILE *fp = fopen(path, "r");
-    if (!fp) return NULL;
-
-    fseek(fp, 0, SEEK_END);
-    long size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-
-    if (size <= 0 || size > MAX_FILE_SIZE) {
-        fclose(fp);
+    /* Identity files are re-read for every prompt; the cache makes that
+     * a lookup unless they changed. */
+    const CachedFile *f = fcache_get(path);
+    if (!f) return NULL;
+    if (f->size > MAX_FILE_SIZE) {
+        fcache_release(f);
         return NULL;
     }
 
-    char *buf = arena_alloc(a, (size_t)size + 1);
-    size_t n = fread(buf, 1, (size_t)size, fp);
-    buf[n] = '\0';
-    fclose(fp);
+    char *buf = arena_alloc(a, f->size + 1);
+    memcpy(buf, f->data, f->size + 1);
+    fcache_release(f);
     return buf;
 }
 
-/* Append a workspace file section to the prompt buffer. */
-static void inject_file(Arena *a, char **out, size_t *out_len, size_t *out_cap,
-                         const char *workspace, const char *filename) {
-    char *content = ws_read_file(a, workspace, filename);
-    int n;
-    char header[256];
-
-    if (content && content[0]) {
-        n = snprintf(header, sizeof(header), "### %s\n\n", filename);
-        /* Grow output if needed */
-        size_t needed = *out_len + (size_t)n + strlen(content) + 4;
-        while (needed > *out_cap) {
-            *out_cap *= 2;
-            /* Can't realloc arena — this is fine, we over-allocate */
-        }
-        memcpy(*out + *out_len, header, (size_t)n);
-        *out_len += (size_t)n;
-        size_t clen = strlen(content);
-        memcpy(*out + *out_len, content, clen);
-        *out_len += clen;
-        memcpy(*out + *out_len, "\n\n", 2);
-        *out_len += 2;
-    } else {
-        n = snprintf(header, sizeof(header), "### %s\n\n[File not found: %s]\n\n", filename, filename);
-        memcpy(*out + *out_len, header, (size_t)n);
-        *out_len += (size_t)n;
-    }
-}
+/* ── Sections ───────────────────────────────────────────────── */
 
-char *ws_build_system_prompt(Arena *a, const char *workspace, const char *model) {
-    size_t cap = 128 * 1024; /* 128KB prompt buffer */
-    char *out = arena_alloc(a, cap);
-    size_t len = 0;
+/* A prompt section: malloc'd text and its length. */
+typedef struct {
+    char  *text;
+    size_t len;
+} Section;
 
-    /* Safety */
-    const char *safety =
+static Section section_printf(const char *fmt, ...) {
+    va_list ap, ap2;
+    va_start(ap, fmt);
+    va_copy(ap2, ap);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    Section s = { malloc((size_t)n + 1), (size_t)n };
+    vsnprintf(s.text, (size_t)n + 1, fmt, ap2);
+    va_end(ap2);
+    return s;
+}
+
+static Section safety_section(void) {
+    return section_printf("%s",
         "## Safety\n\n"
         "- Do not exfiltrate private data.\n"
         "- Do not run destructive commands without asking.\n"
         "- Prefer recoverable operations over destructive ones.\n"
-        "- When in doubt, ask before acting externally.\n\n";
-    size_t slen = strlen(safety);
-    memcpy(out + len, safety, slen);
-    len += slen;
-
-    /* Tools */
-    const char *tools =
-        "## Tools\n\n"
-        "You have access to the following tools:\n\n"
-        "- **shell**: Execute terminal commands\n"
-        "- **file_read**: Read file contents\n"
-        "- **file_write**: Write file contents\n"
-        "- **memory_store**: Save to memory\n"
-        "- **memory_recall**: Search memory\n\n";
-    size_t tlen = strlen(tools);
-    memcpy(out + len, tools, tlen);
-    len += tlen;
-
-    /* Workspace path */
-    int n = snprintf(out + len, cap - len, "## Workspace\n\nWorking directory: `%s`\n\n", workspace);
-    len += (size_t)n;
-
-    /* Project context */
-    const char *ctx = "## Project Context\n\n";
-    size_t clen = strlen(ctx);
-    memcpy(out + len, ctx, clen);
-    len += clen;
-
-    /* Identity files */
-    const char *files[] = {
-        "AGENTS.md", "SOUL.md", "TOOLS.md", "IDENTITY.md",
-        "USER.md", "HEARTBEAT.md", "MEMORY.md", NULL
-    };
-    for (int i = 0; files[i]; i++) {
-        inject_file(a, &out, &len, &cap, workspace, files[i]);
-    }
-
-    /* Date/time */
-    time_t now = time(NULL);
-    struct tm tm;
-    gmtime_r(&now, &tm);
-    n = snprintf(out + len, cap - len,
-        "## Current Date & Time\n\nTimezone: UTC\nDate: %04d-%02d-%02d %02d:%02d:%02d\n\n",
-        tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
-        tm.tm_hour, tm.tm_min, tm.tm_sec);
-    len += (size_t)n;
+        "- When in doubt, ask before acting externally.\n\n");
+}
+
+/* Listed from the registry so the prompt matches what's callable */
+static Section tools_section(void) {
+    size_t cap = 4096, len = 0;
+    char *out = malloc(cap);
+    len += (size_t)snprintf(out, cap, "## Tools\n\nYou have access to the following tools:\n\n");
+    const ToolDef *t;
+    for (size_t i = 0; (t = tools_at(i)); i++) {
+        size_t need = strlen(t->name) + strlen(t->description) + 16;
+        while (len + need + 2 > cap) out = realloc(out, cap *= 2);
+        len += (size_t)snprintf(out + len, cap - len, "- **%s**: %s\n", t->name, t->description);
+    }
+    out[len++] = '\n';
+    out[len] = '\0';
+    return (Section){ out, len };
+}
+
+/* Index of the context files load_context can fetch; empty if none. */
+static Section skills_section(const char *workspace) {
+    Section s;
+    s.text = tool_context_index(workspace, &s.len);
+    return s;
+}
 
-    /* Runtime */
+static Section runtime_section(const char *workspace, const char *model) {
     char hostname[256] = "unknown";
     gethostname(hostname, sizeof(hostname));
     struct utsname uts;
     uname(&uts);
-    n = snprintf(out + len, cap - len,
-        "## Runtime\n\nHost: %s | OS: %s %s | Model: %s | Engine: CClaw (C)\n\n",
-        hostname, uts.sysname, uts.machine, model);
-    len += (size_t)n;
+    return section_printf(
+        "## Workspace\n\nWorking directory: `%s`\n\n"
+        "## Runtime\n\nHost: %s | OS: %s %s | Model: %s | Engine: CClaw (C)\n\n"
+        "## Project Context\n\n",
+        workspace, hostname, uts.sysname, uts.machine, model);
+}
 
-    out[len] = '\0';
+/* One identity file; `st` gets its stat (zeroed if missing). */
+static Section file_section(const char *workspace, const char *name, struct stat *st) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", workspace, name);
+    memset(st, 0, sizeof(*st));
+    const CachedFile *f = fcache_get(path);
+    Section s;
+    if (f && f->size <= MAX_FILE_SIZE && f->data[0]) {
+        *st = f->st;
+        s = section_printf("### %s\n\n%s\n\n", name, f->data);
+    } else {
+        if (f) *st = f->st;
+        s = section_printf("### %s\n\n[File not found: %s]\n\n", name, name);
+    }
+    fcache_release(f);
+    return s;
+}
+
+/* Minute resolution, so the prompt changes at most once a minute. */
+static Section date_section(time_t now) {
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    return section_printf(
+        "## Current Date & Time\n\nTimezone: UTC\nDate: %04d-%02d-%02d %02d:%02d\n\n",
+        tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min);
+}
+
+/* Section order: most stable first, so the prompt's prefix stays
+ * byte-identical (and provider-cacheable) across file edits and time. */
+enum { SEC_SAFETY, SEC_TOOLS, SEC_SKILLS, SEC_RUNTIME, SEC_FILES, SEC_DATE = SEC_FILES + NFILES, NSECTIONS };
+
+static Rope rope_of(const Section *sec) {
+    Rope r = { 0 };
+    for (int i = 0; i < NSECTIONS; i++) rope_add(&r, sec[i].text, sec[i].len);
+    return r;
+}
+
+static void build_all(Section *sec, struct stat *st, const char *workspace, const char *model) {
+    sec[SEC_SAFETY] = safety_section();
+    sec[SEC_TOOLS] = tools_section();
+    sec[SEC_SKILLS] = skills_section(workspace);
+    sec[SEC_RUNTIME] = runtime_section(workspace, model);
+    for (size_t i = 0; i < NFILES; i++) sec[SEC_FILES + i] = file_section(workspace, g_files[i], &st[i]);
+    sec[SEC_DATE] = date_section(time(NULL));
+}
+
+char *ws_build_system_prompt(Arena *a, const char *workspace, const char *model) {
+    Section sec[NSECTIONS];
+    struct stat st[NFILES];
+    build_all(sec, st, workspace, model);
+    Rope r = rope_of(sec);
+    char *out = rope_join(&r, a);  /* Exact size */
+    rope_free(&r);
+    for (int i = 0; i < NSECTIONS; i++) free(sec[i].text);
     return out;
 }
+
+/* ── Prompt manager ─────────────────────────────────────────────
+ *
+ * Keeps every section and the joined prompt. An inotify watch on the
+ * workspace directory reports identity files being written, created,
+ * renamed or removed, and one on its skills/ directory any change to the
+ * context files; events are drained when the prompt is acquired, and
+ * only the sections they name are rebuilt. Without inotify each
+ * file is checked with stat() instead. The joined prompt is a
+ * refcounted snapshot, so a turn keeps the prompt it started with while
+ * a new one is swapped in. Each snapshot also carries the prompt as a
+ * JSON string, escaped once here rather than in every request. */
+
+typedef struct {
+    WsPrompt p;        /* Handed out; must be first */
+    int      refs;
+    bool     current;
+} Snapshot;
+
+static struct {
+    pthread_mutex_t lock;
+    char        workspace[512];
+    Section     sec[NSECTIONS];
+    struct stat st[NFILES];
+    long        minute;    /* Of the date section */
+    int         ifd;
+    int         ws_wd;     /* Watch on the workspace directory */
+    int         skills_wd; /* Watch on CONTEXT_DIR, -1 while it doesn't exist */
+    Snapshot   *cur;
+    unsigned long version;
+} g_pm = { .lock = PTHREAD_MUTEX_INITIALIZER, .ifd = -1, .ws_wd = -1, .skills_wd = -1 };
+
+static void snapshot_free(Snapshot *s) {
+    free((char *)s->p.text);
+    free((char *)s->p.json);
+    free(s);
+}
+
+static void snapshot_drop(Snapshot *s) {
+    if (!s) return;
+    s->current = false;
+    if (s->refs == 0) {
+        snapshot_free(s);
+    }
+}
+
+/* Lock held. */
+static void publish(void) {
+    Snapshot *s = calloc(1, sizeof(*s));
+    Rope r = rope_of(g_pm.sec);
+    s->p.text = rope_join(&r, NULL);
+    s->p.len = r.len;
+    rope_free(&r);
+    cJSON *str = cJSON_CreateStringReference(s->p.text);
+    s->p.json = cJSON_PrintUnformatted(str);
+    s->p.json_len = strlen(s->p.json);
+    cJSON_Delete(str);
+    s->p.version = ++g_pm.version;
+    s->current = true;
+    snapshot_drop(g_pm.cur);
+    g_pm.cur = s;
+}
+
+/* (Re)watch the context directory, which may come and go. Lock held. */
+static void watch_skills(void) {
+    char dir[1024];
+    snprintf(dir, sizeof(dir), "%s/%s", g_pm.workspace, CONTEXT_DIR);
+    g_pm.skills_wd = inotify_add_watch(g_pm.ifd, dir, SKILLS_MASK);
+}
+
+void ws_prompt_init(const char *workspace, const char *model) {
+    pthread_mutex_lock(&g_pm.lock);
+    snprintf(g_pm.workspace, sizeof(g_pm.workspace), "%s", workspace);
+
+    /* Watch first, so an edit made while building is seen next time. */
+    g_pm.ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (g_pm.ifd >= 0 && (g_pm.ws_wd = inotify_add_watch(g_pm.ifd, workspace, DIR_MASK)) < 0) {
+        close(g_pm.ifd);
+        g_pm.ifd = -1;
+    }
+    if (g_pm.ifd < 0)
+        LOG_WARN("prompt: cannot watch %s (%s); checking identity files with stat()",
+                 workspace, strerror(errno));
+    else
+        watch_skills();
+
+    build_all(g_pm.sec, g_pm.st, workspace, model);
+    g_pm.minute = (long)(time(NULL) / 60);
+    publish();
+    pthread_mutex_unlock(&g_pm.lock);
+}
+
+/* Mark identity files named by pending events, and the skills index if
+ * the context directory changed. If the workspace directory itself went
+ * away, fall back to stat(). Lock held. */
+static void drain(bool *dirty, bool *skills) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool lost = false;
+    for (;;) {
+        ssize_t n = read(g_pm.ifd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        for (char *p = buf; p < buf + n;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            p += sizeof(*ev) + ev->len;
+            if (!(ev->mask & IN_Q_OVERFLOW) && ev->wd != g_pm.ws_wd) {
+                *skills = true;  /* Anything in (or of) the context directory */
+                continue;
+            }
+            if (ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) lost = true;
+            if (ev->mask & (IN_Q_OVERFLOW | IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                for (size_t i = 0; i < NFILES; i++) dirty[i] = true;
+                *skills = true;
+                continue;
+            }
+            if (ev->len && !strcmp(ev->name, CONTEXT_DIR)) {
+                *skills = true;
+                watch_skills();
+            }
+            for (size_t i = 0; ev->len && i < NFILES; i++)
+                if (!strcmp(ev->name, g_files[i])) dirty[i] = true;
+        }
+    }
+    if (lost) {
+        LOG_WARN("prompt: lost the watch on %s; checking identity files with stat()", g_pm.workspace);
+        close(g_pm.ifd);
+        g_pm.ifd = -1;
+    }
+}
+
+static bool same_stat(const struct stat *a, const struct stat *b) {
+    return a->st_ino == b->st_ino && a->st_size == b->st_size &&
+           a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec &&
+           a->st_ctim.tv_sec == b->st_ctim.tv_sec && a->st_ctim.tv_nsec == b->st_ctim.tv_nsec;
+}
+
+/* Swap in a rebuilt section unless it came out the same. Lock held. */
+static bool replace_section(Section *old, Section s) {
+    if (s.len == old->len && !memcmp(s.text, old->text, s.len)) {
+        free(s.text);  /* Touched but unchanged */
+        return false;
+    }
+    free(old->text);
+    *old = s;
+    return true;
+}
+
+const WsPrompt *ws_prompt_acquire(void) {
+    pthread_mutex_lock(&g_pm.lock);
+    if (!g_pm.cur) {
+        pthread_mutex_unlock(&g_pm.lock);
+        return NULL;
+    }
+
+    bool dirty[NFILES] = { false };
+    bool skills = false;
+    if (g_pm.ifd >= 0) {
+        drain(dirty, &skills);
+    } else {
+        skills = true;  /* Re-indexed each time; unchanged output is dropped below */
+        for (size_t i = 0; i < NFILES; i++) {
+            char path[1024];
+            struct stat st;
+            snprintf(path, sizeof(path), "%s/%s", g_pm.workspace, g_files[i]);
+            if (stat(path, &st) < 0) memset(&st, 0, sizeof(st));
+            dirty[i] = !same_stat(&st, &g_pm.st[i]);
+        }
+    }
+
+    bool changed = false;
+    for (size_t i = 0; i < NFILES; i++) {
+        if (!dirty[i]) continue;
+        Section s = file_section(g_pm.workspace, g_files[i], &g_pm.st[i]);
+        if (replace_section(&g_pm.sec[SEC_FILES + i], s)) {
+            LOG_DEBUG("prompt: %s changed", g_files[i]);
+            changed = true;
+        }
+    }
+    if (skills && replace_section(&g_pm.sec[SEC_SKILLS], skills_section(g_pm.workspace))) {
+        LOG_DEBUG("prompt: %s/ changed", CONTEXT_DIR);
+        changed = true;
+    }
+
+    time_t now = time(NULL);
+    if ((long)(now / 60) != g_pm.minute) {
+        free(g_pm.sec[SEC_DATE].text);
+        g_pm.sec[SEC_DATE] = date_section(now);
+        g_pm.minute = (long)(now / 60);
+        changed = true;
+    }
+    if (changed) publish();
+
+    Snapshot *s = g_pm.cur;
+    s->refs++;
+    pthread_mutex_unlock(&g_pm.lock);
+    return &s->p;
+}
+
+void ws_prompt_release(const WsPrompt *p) {
+    if (!p) return;
+    Snapshot *s = (Snapshot *)p;
+    pthread_mutex_lock(&g_pm.lock);
+    bool last = --s->refs == 0 && !s->current;
+    pthread_mutex_unlock(&g_pm.lock);
+    if (last) {
+        snapshot_free(s);
+    }
+}
+
+void ws_prompt_set_model(const char *model) {
+    pthread_mutex_lock(&g_pm.lock);
+    if (g_pm.cur && replace_section(&g_pm.sec[SEC_RUNTIME], runtime_section(g_pm.workspace, model)))
+        publish();
+    pthread_mutex_unlock(&g_pm.lock);
+}
+
+void ws_prompt_cleanup(void) {
+    pthread_mutex_lock(&g_pm.lock);
+    snapshot_drop(g_pm.cur);
+    g_pm.cur = NULL;
+    for (int i = 0; i < NSECTIONS; i++) {
+        free(g_pm.sec[i].text);
+        g_pm.sec[i] = (Section){ NULL, 0 };
+    }
+    if (g_pm.ifd >= 0) close(g_pm.ifd);
+    g_pm.ifd = g_pm.ws_wd = g_pm.skills_wd = -1;
+    pthread_mutex_unlock(&g_pm.lock);
+}
@@ -2,6 +2,15 @@
 #define CCLAW_WORKSPACE_H
 
 #include "arena.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* The part of `path` below `workspace`: "" for the workspace itself, and
+ * "src/lib" for "src/lib", "./src/lib" or "<workspace>/src/lib". A path
+ * with a ".." segment, or an absolute path outside the workspace, gives
+ * NULL with a message in `err` (if not NULL). This is the path policy of
+ * search, list and glob. */
+const char *ws_path_rel(const char *workspace, const char *path, char *err, size_t errlen);
 
 /* Read a workspace file into arena memory. Returns NULL if not found. */
 char *ws_read_file(Arena *a, const char *workspace, const char *filename);
@@ -10,4 +19,31 @@ char *ws_read_file(Arena *a, const char *workspace, const char *filename);
  * Caller must arena_free the arena when done. */
 char *ws_build_system_prompt(Arena *a, const char *workspace, const char *model);
 
+/* A system prompt snapshot. Immutable until released. */
+typedef struct {
+    const char   *text;
+    size_t        len;
+    const char   *json;      /* text as a quoted, escaped JSON string */
+    size_t        json_len;
+    unsigned long version;  /* Increases with every rebuild */
+} WsPrompt;
+
+/* Build the prompt and start watching the workspace's identity files.
+ * Call once, after tools are registered (the prompt lists them). */
+void ws_prompt_init(const char *workspace, const char *model);
+
+/* The current prompt. Identity files that changed since the last call are
+ * re-read first, and the date is refreshed each minute; everything else
+ * is reused. Release with ws_prompt_release(). NULL before init. */
+const WsPrompt *ws_prompt_acquire(void);
+
+void ws_prompt_release(const WsPrompt *p);
+
+/* Name `model` in the prompt from now on (after a config reload). Turns
+ * holding the old prompt keep it. */
+void ws_prompt_set_model(const char *model);
+
+/* Free the prompt and stop watching. */
+void ws_prompt_cleanup(void);
+
 #endif
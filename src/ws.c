@@ -7,6 +7,7 @@
 
 #include "ws.h"
 #include "log.h"
+#include "pool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,9 +21,13 @@
 /* mbedtls for SHA-1 (WebSocket handshake requires it) */
 #include "mbedtls/sha1.h"
 
+#define MEM_TAG MEM_WS
+#include "mem.h"
+
 #define WS_MAGIC "258EAFA5-E914-47DA-95CA-5AB9DC085B7"
 #define MAX_CLIENTS 64
 #define READ_BUF_SIZE 65536
+#define MAX_PAYLOAD (16 * 1024 * 1024)  /* Larger frames close the connection */
 
 /* Base64 encode (minimal, for handshake only) */
 static const char b64_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -173,13 +178,18 @@ int ws_read_frame(int fd, WsFrame *frame) {
         if (read(fd, mask, 4) != 4) return -1;
     }
 
+    if (payload_len > MAX_PAYLOAD) {
+        LOG_WARN("WS: %llu-byte frame over the limit", (unsigned long long)payload_len);
+        return -1;
+    }
     frame->payload_len = (size_t)payload_len;
-    frame->payload = malloc(frame->payload_len + 1);
+    frame->payload = pool_get(frame->payload_len + 1, &frame->payload_cap);
+    if (!frame->payload) return -1;
 
     size_t total = 0;
     while (total < frame->payload_len) {
         n = read(fd, frame->payload + total, frame->payload_len - total);
-        if (n <= 0) { free(frame->payload); frame->payload = NULL; return -1; }
+        if (n <= 0) { ws_frame_free(frame); return -1; }
         total += (size_t)n;
     }
 
@@ -193,6 +203,11 @@ int ws_read_frame(int fd, WsFrame *frame) {
     return 0;
 }
 
+void ws_frame_free(WsFrame *frame) {
+    pool_put(frame->payload, frame->payload_cap);
+    frame->payload = NULL;
+}
+
 int ws_write_frame(int fd, WsOpcode opcode, const char *data, size_t len) {
     unsigned char hdr[10];
     size_t hdr_len = 2;
@@ -307,7 +322,7 @@ int ws_server_start(const WsServerConfig *cfg) {
             case WS_OP_TEXT:
                 if (cfg->on_message) {
                     if (!cfg->on_message(fds[i].fd, frame.payload, frame.payload_len, cfg->userdata)) {
-                        free(frame.payload);
+                        ws_frame_free(&frame);
                         ws_send_close(fds[i].fd);
                         goto remove_client;
                     }
@@ -318,13 +333,13 @@ int ws_server_start(const WsServerConfig *cfg) {
                 break;
             case WS_OP_CLOSE:
                 ws_send_close(fds[i].fd);
-                free(frame.payload);
+                ws_frame_free(&frame);
                 goto remove_client;
             default:
                 break;
             }
 
-            free(frame.payload);
+            ws_frame_free(&frame);
             continue;
 
         remove_client:
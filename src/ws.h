@@ -18,6 +18,7 @@ typedef struct {
     WsOpcode opcode;
     char    *payload;
     size_t   payload_len;
+    size_t   payload_cap;  /* Size of payload's pool buffer */
     bool     fin;
 } WsFrame;
 
@@ -53,8 +54,9 @@ int ws_send_close(int client_fd);
  * Returns 0 on success, -1 on failure. */
 int ws_handshake(int client_fd, const char *auth_token);
 
-/* Read one WebSocket frame. Caller frees frame.payload. */
+/* Read one WebSocket frame. Release it with ws_frame_free(). */
 int ws_read_frame(int fd, WsFrame *frame);
+void ws_frame_free(WsFrame *frame);
 
 /* Write a WebSocket frame. */
 int ws_write_frame(int fd, WsOpcode opcode, const char *data, size_t len);